@@ -28,6 +28,7 @@ R_SW_OBJS = d_edge.o \
 	   d_part.o \
 	   d_polyse.o \
 	   d_scan.o \
+	   d_simd.o \
 	   d_sky.o \
 	   d_sprite.o \
 	   d_surf.o \
@@ -39,6 +40,7 @@ R_SW_OBJS = d_edge.o \
 	   nonintel.o \
 	   r_aclip.o \
 	   r_alias.o \
+	   r_band.o \
 	   r_bsp.o \
 	   r_draw.o \
 	   r_edge.o \
@@ -46,6 +48,8 @@ R_SW_OBJS = d_edge.o \
 	   r_light.o \
 	   r_main.o \
 	   r_misc.o \
+	   r_prebuild.o \
+	   r_occlude.o \
 	   r_sky.o \
 	   r_sprite.o \
 	   r_surf.o \
@@ -57,6 +61,7 @@ SHARED_OBJS = chase.o \
 	   cl_input.o \
 	   cl_main.o \
 	   cl_parse.o \
+	   cl_stream.o \
 	   cl_tent.o \
 	   cmd.o \
 	   common.o \
@@ -75,13 +80,17 @@ SHARED_OBJS = chase.o \
 	   pr_cmds.o \
 	   pr_edict.o \
 	   pr_exec.o \
+	   pr_threaded.o \
+	   pr_native.o \
 	   r_part.o \
 	   r_vars.o \
 	   sbar.o \
 	   sv_main.o \
 	   sv_move.o \
 	   sv_phys.o \
+	   sv_prof.o \
 	   sv_user.o \
+	   sv_vis.o \
 	   view.o \
 	   wad.o \
 	   world.o \
@@ -100,4 +109,9 @@ IMAGE_OBJS = scr_screenshot.o
 MAIN_OBJS = main_sdl.o
 
 # New additions
-SHARED_OBJS += sdl_common.o cvar_common.o softquake_version.o
+SHARED_OBJS += sdl_common.o cvar_common.o softquake_version.o jobs.o
+
+# Dedicated server
+# Null drivers for everything but the network, which gets UDP as well as the loopback
+# net_bsd.o takes the place of net_none.o, and sdl_common.o is left out
+DED_OBJS = vid_null.o in_null.o main_dedicated.o net_bsd.o net_dgrm.o net_udp.o
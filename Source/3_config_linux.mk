@@ -18,6 +18,7 @@ SYS_OBJS += sys_sdl_unix.o
 # Where the objects are compiled
 GL_OBJ_DIR := build/linux/glquake
 SW_OBJ_DIR := build/linux/softquake
+DED_OBJ_DIR := build/linux/dedicated
 
 EXE_SUFFIX =
 
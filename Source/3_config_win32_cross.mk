@@ -28,4 +28,9 @@ SW_OBJ_DIR := build/win32/softquake
 
 EXE_SUFFIX = .exe
 
+# main_dedicated.c only knows how to sleep on Linux
+ifeq ($(TARGET_DEDICATED),1)
+$(error The dedicated server can only be built for Linux)
+endif
+
 CC ?= i686-w64-mingw32-gcc
@@ -8,6 +8,16 @@ ENABLE_SOUND := 1
 # By default, softquake uses PCX, glquake uses TGA
 ENABLE_PNG := 0
 
+# QuakeC translated to C
+# Generate pr_progs.c first, see Makefile.progtool and softquake-notes.txt
+ENABLE_NATIVE_PROGS := 0
+
+# The dedicated server never plays anything
+ifeq ($(TARGET_DEDICATED),1)
+	ENABLE_SOUND := 0
+	ENABLE_CD_AUDIO := 0
+endif
+
 # -----------------------------------------
 # GLQuake fixes
 # Disable all of these to match the original GLQuake release
@@ -63,3 +73,9 @@ ifeq ($(ENABLE_PNG),1)
 	IMAGE_OBJS += stb_image_write.o
 	DEFINES += -DSOFTQUAKE_ENABLE_PNG
 endif
+
+# QuakeC
+ifeq ($(ENABLE_NATIVE_PROGS),1)
+	SHARED_OBJS += pr_progs.o
+	DEFINES += -DSOFTQUAKE_NATIVE_PROGS
+endif
@@ -1,5 +1,5 @@
 # This file compiles the final target binary
-# Specify either TARGET_SOFTQUAKE=1, or TARGET_GLQUAKE=1, but not both
+# Specify one of TARGET_SOFTQUAKE=1, TARGET_GLQUAKE=1 or TARGET_DEDICATED=1
 
 # The main Makefile should take care of this
 
@@ -36,9 +36,20 @@ SW_OBJS += $(R_SW_OBJS)
 SW_OBJS += vid_sdl2.o
 SW_OBJS += $(COMMON_OBJS)
 
+# The server still needs the software renderer's model loader,
+# and the client code it links against needs the rest of it
+DEDICATED_OBJS =
+DEDICATED_OBJS += $(R_SW_OBJS)
+DEDICATED_OBJS += $(filter-out net_none.o sdl_common.o, $(SHARED_OBJS))
+DEDICATED_OBJS += $(DED_OBJS)
+DEDICATED_OBJS += $(SND_OBJS)
+DEDICATED_OBJS += $(SYS_OBJS)
+DEDICATED_OBJS += $(IMAGE_OBJS)
+
 # Since this file should be recursively called, targets are defaulted to 0
 TARGET_SOFTQUAKE ?= 0
 TARGET_GLQUAKE ?= 0
+TARGET_DEDICATED ?= 0
 
 # Convoluted way to nest if-statements
 # Esentially, you can only compile a single target from this file
@@ -46,9 +57,17 @@ TARGET_GLQUAKE ?= 0
 
 ifeq ($(TARGET_GLQUAKE),0)
 ifeq ($(TARGET_SOFTQUAKE),0) 
+ifeq ($(TARGET_DEDICATED),0) 
 $(error No target specified)
 endif
 endif
+endif
+
+ifeq ($(TARGET_DEDICATED),1)
+ifneq ($(TARGET_GLQUAKE)$(TARGET_SOFTQUAKE),00) 
+$(error Only a single target can be specified)
+endif
+endif
 
 ifeq ($(TARGET_GLQUAKE),1)
 ifeq ($(TARGET_SOFTQUAKE),1) 
@@ -76,6 +95,12 @@ ifeq ($(TARGET_SOFTQUAKE),1)
 	TARGET=$(BIN_DIR)/softquake-sdl$(EXE_SUFFIX)
 endif
 
+ifeq ($(TARGET_DEDICATED),1)
+	OBJ_DIR := $(DED_OBJ_DIR)
+	OBJS := $(addprefix $(OBJ_DIR)/, $(DEDICATED_OBJS))
+	TARGET=$(BIN_DIR)/softquake-dedicated$(EXE_SUFFIX)
+endif
+
 CFLAGS += -Wformat
 CFLAGS += -Wno-dangling-else
 CFLAGS += -Wno-pointer-sign
@@ -93,7 +118,7 @@ BIN_DIR=bin
 
 $(TARGET): $(OBJS) $(BIN_DIR)
 	$(CC) -o $(TARGET) $(OBJS) $(CFLAGS) $(LDFLAGS) $(LIBDIR) $(LIBS)
-	cp $(SDL_DEPS) $(BIN_DIR)/
+	$(if $(SDL_DEPS),cp $(SDL_DEPS) $(BIN_DIR)/)
 	@echo "Built target: $(TARGET)"
 
 
@@ -12,6 +12,32 @@
 
 #define NORETURN_FUNCTION __attribute__((noreturn))
 
+// Each thread gets its own copy of a variable annotated with this
+#define THREAD_LOCAL __thread
+
+// Where the current function will return to, to tell its callers apart
+#define RETURN_ADDRESS() __builtin_return_address(0)
+
+// Lets a single function use instructions beyond what the whole program is built for
+// Only call these after checking the CPU supports them
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+#elif defined _MSC_VER
+
+#define PRINTF_FUNCTION
+#define SNPRINTF_FUNCTION
+
+#define NORETURN_FUNCTION
+
+#define THREAD_LOCAL __declspec(thread)
+
+#include <intrin.h>
+#define RETURN_ADDRESS() _ReturnAddress()
+
+#define TARGET_SSE2
+#define TARGET_AVX2
+
 #else
 
 #define PRINTF_FUNCTION
@@ -19,7 +45,24 @@
 
 #define NORETURN_FUNCTION
 
+#define THREAD_LOCAL
+
+#define RETURN_ADDRESS() ((void *)0)
+
 #endif /* __GNUC__, __clang__ */
 
 
+// x86 intrinsics are available, with TARGET_SSE2 and TARGET_AVX2 to enable them
+#if (defined __GNUC__ || defined __clang__ || defined _MSC_VER) && \
+	(defined __i386__ || defined __x86_64__ || defined _M_IX86 || defined _M_X64)
+#define SIMD_X86
+#endif
+
+// float math is done on the x87 FPU, which keeps extra precision in its registers
+// 32-bit gcc and clang builds do this unless -mfpmath=sse is given
+#if (defined __i386__ && !defined __SSE2_MATH__) || (defined _M_IX86 && _M_IX86_FP < 2)
+#define FLOAT_X87
+#endif
+
+
 #endif /* _CC_FEATURES_H_ */
@@ -722,6 +722,7 @@ void CL_Init (void)
 
 	CL_InitInput ();
 	CL_InitTEnts ();
+	CL_InitStream ();	// softquake
 	
 //
 // register our commands
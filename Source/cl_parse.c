@@ -285,24 +285,33 @@ void CL_ParseServerInfo (void)
 // now we try to load everything else until a cache allocation fails
 //
 
-	for (i=1 ; i<nummodels ; i++)
+	// softquake -- all at once on the worker threads, see cl_stream.c
+	if (cl_asyncload.value && Jobs_NumThreads () > 1)
 	{
-		cl.model_precache[i] = Mod_ForName (model_precache[i], false);
-		if (cl.model_precache[i] == NULL)
-		{
-			Con_Printf("Model %s not found\n", model_precache[i]);
+		if (!CL_StreamPrecache (model_precache, nummodels, sound_precache, numsounds))
 			return;
-		}
-		CL_KeepaliveMessage ();
 	}
-
-	S_BeginPrecaching ();
-	for (i=1 ; i<numsounds ; i++)
+	else
 	{
-		cl.sound_precache[i] = S_PrecacheSound (sound_precache[i]);
-		CL_KeepaliveMessage ();
+		for (i=1 ; i<nummodels ; i++)
+		{
+			cl.model_precache[i] = Mod_ForName (model_precache[i], false);
+			if (cl.model_precache[i] == NULL)
+			{
+				Con_Printf("Model %s not found\n", model_precache[i]);
+				return;
+			}
+			CL_KeepaliveMessage ();
+		}
+
+		S_BeginPrecaching ();
+		for (i=1 ; i<numsounds ; i++)
+		{
+			cl.sound_precache[i] = S_PrecacheSound (sound_precache[i]);
+			CL_KeepaliveMessage ();
+		}
+		S_EndPrecaching ();
 	}
-	S_EndPrecaching ();
 
 
 // local state
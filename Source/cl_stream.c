@@ -0,0 +1,378 @@
+/*
+Copyright (C) 2023-2023 softquake
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+// cl_stream.c -- loads the models and sounds of a new map on the worker threads
+
+// CL_ParseServerInfo used to load every model and sound the server sent one
+// at a time, reading each file and decoding it before starting on the next.
+//
+// Now the files are all found up front and read on the worker threads at the
+// same time. Sounds are then decoded into memory of their own, also on the
+// worker threads, while the main thread builds the models out of what was
+// read. The model loaders have to stay on the main thread, everything they
+// make goes on the hunk through loadmodel and the other globals of model.c.
+//
+// Only the main thread puts anything in the hunk or the cache, and it does it
+// in the same order as before.
+
+#include "quakedef.h"
+
+cvar_t	cl_asyncload = {"cl_asyncload", "1", CV_ARCHIVE};
+
+typedef enum
+{
+	stream_model,
+	stream_sound,
+	stream_numtypes
+} streamtype_t;
+
+typedef struct
+{
+	streamtype_t	type;
+	char		*name;
+	FILE		*file;			// read from this, unless it's mapped
+	byte		*mapped;		// in a mapped pak, see COM_LoadPackFile
+	byte		*data;			// the whole file, once it's been read
+	int			length;
+	qboolean	failed;			// didn't find it or couldn't read it
+	int			touched;		// adds up the mapped pages it touched
+
+	sfx_t		*sfx;
+	wavinfo_t	info;
+	sfxcache_t	*sound;			// decoded into this, then copied to the cache
+	int			soundsize;
+
+	double		readtime, decodetime;
+} streamitem_t;
+
+typedef struct
+{
+	int			count, bytes;
+	double		read, decode;	// added up over all the threads
+	double		commit;			// on the main thread
+} streamstats_t;
+
+static	streamitem_t	cl_streamitems[MAX_MODELS+MAX_SOUNDS];
+static	int				cl_numstreamitems;
+
+static	streamstats_t	cl_streamstats[stream_numtypes];
+static	double			cl_streamtime;
+static	char			*cl_streamtypenames[stream_numtypes] = {"models", "sounds"};
+
+// not on the stack, a Host_Error from CL_KeepaliveMessage can leave it running
+static	jobbatch_t		cl_streambatch;
+
+static void CL_LoadStats_f (void);
+
+
+/*
+===============
+CL_InitStream
+===============
+*/
+void CL_InitStream (void)
+{
+	Cvar_RegisterVariable (&cl_asyncload);
+	Cmd_AddCommand ("loadstats", CL_LoadStats_f);
+}
+
+
+/*
+===============
+CL_StreamOpen
+
+Finds the file on the main thread, since COM_FindFile isn't safe anywhere else
+===============
+*/
+static streamitem_t *CL_StreamOpen (streamtype_t type, char *name, char *path)
+{
+	streamitem_t	*item;
+
+	item = &cl_streamitems[cl_numstreamitems++];
+	memset (item, 0, sizeof(*item));
+	item->type = type;
+	item->name = name;
+
+	item->length = COM_FOpenFile (path, &item->file);
+	if (!item->file)
+	{
+		item->failed = true;
+		return item;
+	}
+
+	if (com_filemapped)
+	{
+		item->mapped = com_filemapped;
+		fclose (item->file);
+		item->file = NULL;
+	}
+	return item;
+}
+
+
+/*
+===============
+CL_StreamRead
+
+Runs on any thread
+===============
+*/
+static void CL_StreamRead (void *unused, int index)
+{
+	streamitem_t	*item;
+	double			start;
+	int				i, touched;
+
+	item = &cl_streamitems[index];
+	if (item->failed)
+		return;
+
+	start = Sys_PreciseTime ();
+
+	if (item->mapped)
+	{	// bring it in now, instead of a page at a time when it's used
+		touched = 0;
+		for (i=0 ; i<item->length ; i+=4096)
+			touched += item->mapped[i];
+		item->touched = touched;
+		item->data = item->mapped;
+	}
+	else
+	{
+		item->data = malloc (item->length);
+		if (!item->data || fread (item->data, 1, item->length, item->file) != item->length)
+			item->failed = true;
+		fclose (item->file);
+		item->file = NULL;
+	}
+
+	item->readtime = Sys_PreciseTime () - start;
+}
+
+
+/*
+===============
+CL_StreamDecode
+
+Runs on any thread
+===============
+*/
+static void CL_StreamDecode (void *unused, int index)
+{
+	streamitem_t	*item;
+	double			start;
+
+	item = &cl_streamitems[index];
+	if (!item->sound)
+		return;
+
+	start = Sys_PreciseTime ();
+	S_DecodeSound (item->sound, &item->info, item->data);
+	item->decodetime = Sys_PreciseTime () - start;
+}
+
+
+/*
+===============
+CL_StreamFree
+===============
+*/
+static void CL_StreamFree (void)
+{
+	streamitem_t	*item;
+	int				i;
+
+	for (i=0, item=cl_streamitems ; i<cl_numstreamitems ; i++, item++)
+	{
+		if (item->file)
+			fclose (item->file);
+		if (item->data && !item->mapped)
+			free (item->data);
+		if (item->sound)
+			free (item->sound);
+	}
+	cl_numstreamitems = 0;
+}
+
+
+/*
+===============
+CL_StreamPrecache
+
+Does what CL_ParseServerInfo did with the precache lists, filling in
+cl.model_precache and cl.sound_precache. Returns false if a model is missing.
+===============
+*/
+qboolean CL_StreamPrecache (char models[][MAX_QPATH], int nummodels, char sounds[][MAX_QPATH], int numsounds)
+{
+	streamitem_t	*item;
+	streamstats_t	*stats;
+	sfx_t			*sfx;
+	char			path[MAX_QPATH+8];
+	double			start, time;
+	int				i, firstsound;
+
+// clean up after the last one, if it never finished
+	Jobs_Wait (&cl_streambatch);
+	CL_StreamFree ();
+
+	start = Sys_PreciseTime ();
+	memset (cl_streamstats, 0, sizeof(cl_streamstats));
+
+//
+// find everything that isn't loaded already
+//
+	for (i=1 ; i<nummodels ; i++)
+	{
+		// the *n brush models aren't files, they're made when the world is loaded
+		if (models[i][0] != '*' && Mod_NeedsLoad (models[i]))
+			CL_StreamOpen (stream_model, models[i], models[i]);
+	}
+
+	firstsound = cl_numstreamitems;
+	for (i=1 ; i<numsounds ; i++)
+	{
+		sfx = S_NeedsLoad (sounds[i]);
+		if (!sfx)
+			continue;
+		q_snprintf (path, sizeof(path), "sound/%s", sounds[i]);
+		CL_StreamOpen (stream_sound, sounds[i], path)->sfx = sfx;
+	}
+
+//
+// read them all in
+//
+	Jobs_Run (CL_StreamRead, NULL, cl_numstreamitems);
+
+//
+// start decoding the sounds
+//
+	for (i=firstsound, item=&cl_streamitems[i] ; i<cl_numstreamitems ; i++, item++)
+	{
+		if (item->failed)
+		{
+			Con_Printf ("Couldn't load sound/%s\n", item->name);
+			continue;
+		}
+		item->soundsize = S_SoundInfo (item->sfx, item->data, item->length, &item->info);
+		if (item->soundsize)
+			item->sound = malloc (item->soundsize);
+	}
+	Jobs_Begin (&cl_streambatch, CL_StreamDecode, NULL, cl_numstreamitems);
+
+//
+// build the models while that's going
+//
+	item = cl_streamitems;
+	for (i=1 ; i<nummodels ; i++)
+	{
+		time = Sys_PreciseTime ();
+		if (item < &cl_streamitems[firstsound] && item->name == models[i])
+		{
+			if (item->failed)	// check again, the models loaded before this one may have made it
+				cl.model_precache[i] = Mod_ForName (models[i], false);
+			else
+				cl.model_precache[i] = Mod_ForNameData (models[i], item->data);
+			item++;
+		}
+		else
+			cl.model_precache[i] = Mod_ForName (models[i], false);
+		cl_streamstats[stream_model].commit += Sys_PreciseTime () - time;
+
+		if (cl.model_precache[i] == NULL)
+		{
+			Con_Printf("Model %s not found\n", models[i]);
+			Jobs_Wait (&cl_streambatch);
+			CL_StreamFree ();
+			return false;
+		}
+		CL_KeepaliveMessage ();
+	}
+
+//
+// and put the sounds in the cache once they're done
+//
+	Jobs_Wait (&cl_streambatch);
+
+	S_BeginPrecaching ();
+	for (i=1 ; i<numsounds ; i++)
+	{
+		time = Sys_PreciseTime ();
+		if (item < &cl_streamitems[cl_numstreamitems] && item->name == sounds[i])
+		{
+			cl.sound_precache[i] = S_PrecacheDecoded (sounds[i], item->sound, item->soundsize);
+			item++;
+		}
+		else
+			cl.sound_precache[i] = S_PrecacheSound (sounds[i]);
+		cl_streamstats[stream_sound].commit += Sys_PreciseTime () - time;
+		CL_KeepaliveMessage ();
+	}
+	S_EndPrecaching ();
+
+//
+// add up the times
+//
+	for (i=0, item=cl_streamitems ; i<cl_numstreamitems ; i++, item++)
+	{
+		stats = &cl_streamstats[item->type];
+		stats->count++;
+		if (!item->failed)
+			stats->bytes += item->length;
+		stats->read += item->readtime;
+		stats->decode += item->decodetime;
+	}
+	cl_streamtime = Sys_PreciseTime () - start;
+
+	CL_StreamFree ();
+
+	if (developer.value)
+		CL_LoadStats_f ();
+	return true;
+}
+
+
+/*
+===============
+CL_LoadStats_f
+
+How long the last map took to load, the read and decode times are added up
+over all the threads
+===============
+*/
+static void CL_LoadStats_f (void)
+{
+	streamstats_t	*stats;
+	int				i;
+
+	if (!cl_streamtime)
+	{
+		Con_Printf ("Nothing loaded with cl_asyncload yet\n");
+		return;
+	}
+
+	Con_Printf ("Loaded in %.1f ms on %i threads\n", cl_streamtime*1000, Jobs_NumThreads ());
+	Con_Printf ("ms       files     KB   read decode commit\n");
+	for (i=0, stats=cl_streamstats ; i<stream_numtypes ; i++, stats++)
+	{
+		Con_Printf ("%-8s%6i%7i%7.1f%7.1f%7.1f\n", cl_streamtypenames[i], stats->count,
+			stats->bytes / 1024, stats->read*1000, stats->decode*1000, stats->commit*1000);
+	}
+}
@@ -354,6 +354,15 @@ void CL_TimeDemo_f (void);
 //
 void CL_ParseServerMessage (void);
 void CL_NewTranslation (int slot);
+void CL_KeepaliveMessage (void);
+
+//
+// cl_stream.c
+//
+extern	cvar_t	cl_asyncload;
+
+void CL_InitStream (void);
+qboolean CL_StreamPrecache (char models[][MAX_QPATH], int nummodels, char sounds[][MAX_QPATH], int numsounds);
 
 //
 // view
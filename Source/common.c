@@ -1262,6 +1262,9 @@ typedef struct pack_s
 	int             handle;
 	int             numfiles;
 	packfile_t      *files;
+	byte		*mapped;	// softquake -- the whole pak, or NULL
+	int		*hash;		// softquake -- file number + 1, 0 when empty
+	int		hashmask;
 } pack_t;
 
 //
@@ -1294,6 +1297,10 @@ typedef struct searchpath_s
 
 searchpath_t    *com_searchpaths;
 
+// softquake -- where the file COM_FindFile just found is in a mapped pak,
+// or NULL if it has to be read
+byte	*com_filemapped;
+
 /*
 ============
 COM_Path_f
@@ -1399,6 +1406,43 @@ void COM_CopyFile (char *netpath, char *cachepath)
 	Sys_FileClose (out);    
 }
 
+/*
+===========
+COM_HashFileName
+===========
+*/
+static unsigned COM_HashFileName (char *name)
+{
+	unsigned	hash;
+
+	for (hash=2166136261u ; *name ; name++)
+		hash = (hash ^ (byte)*name) * 16777619u;
+	return hash;
+}
+
+/*
+===========
+COM_FindPackFile
+
+softquake -- Looks the name up in the pak's hash table instead of going
+through every file in it
+===========
+*/
+static packfile_t *COM_FindPackFile (pack_t *pak, char *filename)
+{
+	unsigned	i;
+	int			num;
+
+	for (i=COM_HashFileName (filename) ; ; i++)
+	{
+		num = pak->hash[i & pak->hashmask];
+		if (!num)
+			return NULL;
+		if (!strcmp (pak->files[num-1].name, filename))
+			return &pak->files[num-1];
+	}
+}
+
 /*
 ===========
 COM_FindFile
@@ -1413,9 +1457,12 @@ int COM_FindFile (char *filename, int *handle, FILE **file)
 	char            netpath[MAX_OSPATH];
 	char            cachepath[MAX_OSPATH];
 	pack_t          *pak;
+	packfile_t      *packfile;
 	int                     i;
 	int                     findtime, cachetime;
 
+	com_filemapped = NULL;	// softquake
+
 	if (file && handle)
 		Sys_Error ("COM_FindFile: both handle and file set");
 	if (!file && !handle)
@@ -1438,25 +1485,28 @@ int COM_FindFile (char *filename, int *handle, FILE **file)
 		{
 		// look through all the pak file elements
 			pak = search->pack;
-			for (i=0 ; i<pak->numfiles ; i++)
-				if (!strcmp (pak->files[i].name, filename))
-				{       // found it!
-					// softquake -- remove packfile printing
-					// Sys_Printf ("PackFile: %s : %s\n",pak->filename, filename);
-					if (handle)
-					{
-						*handle = pak->handle;
-						Sys_FileSeek (pak->handle, pak->files[i].filepos);
-					}
-					else
-					{       // open a new file on the pakfile
-						*file = fopen (pak->filename, "rb");
-						if (*file)
-							fseek (*file, pak->files[i].filepos, SEEK_SET);
-					}
-					com_filesize = pak->files[i].filelen;
-					return com_filesize;
+			packfile = COM_FindPackFile (pak, filename);	// softquake
+			if (packfile)
+			{       // found it!
+				// softquake -- remove packfile printing
+				// Sys_Printf ("PackFile: %s : %s\n",pak->filename, filename);
+				if (handle)
+				{
+					*handle = pak->handle;
+					Sys_FileSeek (pak->handle, packfile->filepos);
+				}
+				else
+				{       // open a new file on the pakfile
+					*file = fopen (pak->filename, "rb");
+					if (*file)
+						fseek (*file, packfile->filepos, SEEK_SET);
 				}
+				// softquake -- structures in it have to be aligned
+				if (pak->mapped && !(packfile->filepos & 3))
+					com_filemapped = pak->mapped + packfile->filepos;
+				com_filesize = packfile->filelen;
+				return com_filesize;
+			}
 		}
 		else
 		{               
@@ -1590,6 +1640,17 @@ byte *COM_LoadFile (char *path, int usehunk)
 	len = COM_OpenFile (path, &h);
 	if (h == -1)
 		return NULL;
+
+// softquake -- use it where it is in the mapped pak if we can
+	if (usehunk == 5)
+	{
+		if (com_filemapped)
+		{
+			COM_CloseFile (h);
+			return com_filemapped;
+		}
+		usehunk = 4;
+	}
 	
 // extract the filename base name for hunk tag
 	COM_FileBase (path, base);
@@ -1618,7 +1679,10 @@ byte *COM_LoadFile (char *path, int usehunk)
 	((byte *)buf)[len] = 0;
 
 	Draw_BeginDisc ();
-	Sys_FileRead (h, buf, len);                     
+	if (com_filemapped)		// softquake -- skip stdio
+		memcpy (buf, com_filemapped, len);
+	else
+		Sys_FileRead (h, buf, len);                     
 	COM_CloseFile (h);
 	Draw_EndDisc ();
 
@@ -1653,6 +1717,24 @@ byte *COM_LoadStackFile (char *path, void *buffer, int bufsize)
 	return buf;
 }
 
+/*
+============
+COM_LoadMappedFile
+
+softquake -- COM_LoadStackFile, but a file in a mapped pak isn't copied at
+all, it comes straight from the mapping. Meant for loaders that are done with
+the data once they've made their own copy of it. There's no 0 on the end, and
+anything written to it stays there, so only the byte swaps that don't change
+anything on a little endian machine are allowed.
+============
+*/
+byte *COM_LoadMappedFile (char *path, void *buffer, int bufsize)
+{
+	loadbuf = (byte *)buffer;
+	loadsize = bufsize;
+	return COM_LoadFile (path, 5);
+}
+
 /*
 =================
 COM_LoadPackFile
@@ -1670,11 +1752,13 @@ pack_t *COM_LoadPackFile (char *packfile)
 	packfile_t              *newfiles;
 	int                             numpackfiles;
 	pack_t                  *pack;
-	int                             packhandle;
+	int                             packhandle, packlen;
 	dpackfile_t             info[MAX_FILES_IN_PACK];
 	unsigned short          crc;
+	unsigned                h;
 
-	if (Sys_FileOpenRead (packfile, &packhandle) == -1)
+	packlen = Sys_FileOpenRead (packfile, &packhandle);
+	if (packlen == -1)
 	{
 //              Con_Printf ("Couldn't open %s\n", packfile);
 		return NULL;
@@ -1719,8 +1803,27 @@ pack_t *COM_LoadPackFile (char *packfile)
 	pack->handle = packhandle;
 	pack->numfiles = numpackfiles;
 	pack->files = newfiles;
+
+// softquake -- hash the names, the first of the same name stays like before
+	for (i=16 ; i < numpackfiles*2 ; i<<=1)
+		;
+	pack->hash = Hunk_AllocName (i*sizeof(int), "packhash");
+	pack->hashmask = i - 1;
+	for (i=0 ; i<numpackfiles ; i++)
+	{
+		if (COM_FindPackFile (pack, newfiles[i].name))
+			continue;
+		for (h=COM_HashFileName (newfiles[i].name) ; pack->hash[h & pack->hashmask] ; h++)
+			;
+		pack->hash[h & pack->hashmask] = i + 1;
+	}
+
+// softquake -- map the whole thing, the byte swaps done in place by the
+// loaders don't do anything unless it's big endian
+	if (!bigendien && !COM_CheckParm ("-nomappak"))
+		pack->mapped = Sys_FileMap (packhandle, packlen);
 	
-	Con_Printf ("Added packfile %s (%i files)\n", packfile, numpackfiles);
+	Con_Printf ("Added packfile %s (%i files%s)\n", packfile, numpackfiles, pack->mapped ? ", mapped" : "");
 	return pack;
 }
 
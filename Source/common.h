@@ -174,6 +174,7 @@ PRINTF_FUNCTION char *va(char *format, ...);
 //============================================================================
 
 extern int com_filesize;
+extern byte *com_filemapped;	// softquake
 struct cache_user_s;
 
 extern	char	com_gamedir[MAX_OSPATH];
@@ -184,6 +185,7 @@ int COM_FOpenFile (char *filename, FILE **file);
 void COM_CloseFile (int h);
 
 byte *COM_LoadStackFile (char *path, void *buffer, int bufsize);
+byte *COM_LoadMappedFile (char *path, void *buffer, int bufsize); // softquake
 byte *COM_LoadTempFile (char *path);
 byte *COM_LoadHunkFile (char *path);
 void COM_LoadCacheFile (char *path, struct cache_user_s *cu);
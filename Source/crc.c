@@ -78,4 +78,15 @@ void CRC_ProcessByte(unsigned short *crcvalue, byte data)
 unsigned short CRC_Value(unsigned short crcvalue)
 {
 	return crcvalue ^ CRC_XOR_VALUE;
-}
\ No newline at end of file
+}
+
+// softquake -- The whole of a block at once
+unsigned short CRC_Block(byte *start, int count)
+{
+	unsigned short	crc;
+
+	CRC_Init (&crc);
+	while (count--)
+		crc = (crc << 8) ^ crctable[(crc >> 8) ^ *start++];
+	return CRC_Value (crc);
+}
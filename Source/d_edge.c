@@ -168,164 +168,249 @@ void D_CalcGradients (msurface_t *pface)
 
 /*
 ==============
-D_DrawSurfaces
+D_BeginSurfaces
+
+softquake -- Split out of D_DrawSurfaces, along with D_SetupSurface and
+D_DrawSurface. Setting up a surface touches the surface cache and the view
+transform, so that part has to stay on the main thread. Drawing the spans
+afterwards only reads from the surfsetup_t, so any thread can do it.
 ==============
 */
-void D_DrawSurfaces (void)
+static vec3_t	world_transformed_modelorg;
+
+void D_BeginSurfaces (void)
+{
+	currententity = &cl_entities[0];
+	TransformVector (modelorg, transformed_modelorg);
+	VectorCopy (transformed_modelorg, world_transformed_modelorg);
+}
+
+
+/*
+==============
+D_SaveGradients
+==============
+*/
+static void D_SaveGradients (surfsetup_t *ss)
+{
+	ss->cacheblock = cacheblock;
+	ss->cachewidth = cachewidth;
+	ss->d_sdivzstepu = d_sdivzstepu;
+	ss->d_tdivzstepu = d_tdivzstepu;
+	ss->d_sdivzstepv = d_sdivzstepv;
+	ss->d_tdivzstepv = d_tdivzstepv;
+	ss->d_sdivzorigin = d_sdivzorigin;
+	ss->d_tdivzorigin = d_tdivzorigin;
+	ss->sadjust = sadjust;
+	ss->tadjust = tadjust;
+	ss->bbextents = bbextents;
+	ss->bbextentt = bbextentt;
+}
+
+
+/*
+==============
+D_RestoreWorldState
+==============
+*/
+static void D_RestoreWorldState (void)
+{
+//
+// restore the old drawing state
+// FIXME: we don't want to do this every time!
+// TODO: speed up
+//
+	currententity = &cl_entities[0];
+	VectorCopy (world_transformed_modelorg,
+				transformed_modelorg);
+	VectorCopy (base_vpn, vpn);
+	VectorCopy (base_vup, vup);
+	VectorCopy (base_vright, vright);
+	VectorCopy (base_modelorg, modelorg);
+	R_TransformFrustum ();
+}
+
+
+/*
+==============
+D_SetupSurface
+==============
+*/
+void D_SetupSurface (surf_t *s, surfsetup_t *ss)
 {
-	surf_t			*s;
 	msurface_t		*pface;
 	surfcache_t		*pcurrentcache;
-	vec3_t			world_transformed_modelorg;
 	vec3_t			local_modelorg;
 
-	currententity = &cl_entities[0];
-	TransformVector (modelorg, transformed_modelorg);
-	VectorCopy (transformed_modelorg, world_transformed_modelorg);
+	ss->d_zistepu = s->d_zistepu;
+	ss->d_zistepv = s->d_zistepv;
+	ss->d_ziorigin = s->d_ziorigin;
+	ss->cachespot = NULL;
 
 // TODO: could preset a lot of this at mode set time
 	if (r_drawflat.value)
 	{
-		for (s = &surfaces[1] ; s<surface_p ; s++)
-		{
-			if (!s->spans)
-				continue;
+		ss->type = ss_solid;
+		ss->color = (int)s->data & 0xFF;
+		return;
+	}
 
-			d_zistepu = s->d_zistepu;
-			d_zistepv = s->d_zistepv;
-			d_ziorigin = s->d_ziorigin;
+	r_drawnpolycount++;
 
-			D_DrawSolidSurface (s, (int)s->data & 0xFF);
-			D_DrawZSpans (s->spans);
+	if (s->flags & SURF_DRAWSKY)
+	{
+		if (!r_skymade)
+		{
+			R_MakeSky ();
 		}
+
+		ss->type = ss_sky;
+	}
+	else if (s->flags & SURF_DRAWBACKGROUND)
+	{
+	// set up a gradient for the background surface that places it
+	// effectively at infinity distance from the viewpoint
+		ss->d_zistepu = 0;
+		ss->d_zistepv = 0;
+		ss->d_ziorigin = -0.9;
+
+		ss->type = ss_solid;
+		ss->color = (int)r_clearcolor.value & 0xFF;
+	}
+	else if (s->flags & SURF_DRAWTURB)
+	{
+		pface = s->data;
+		miplevel = 0;
+		cacheblock = (pixel_t *)
+				((byte *)pface->texinfo->texture +
+				pface->texinfo->texture->offsets[0]);
+		cachewidth = 64;
+
+		if (s->insubmodel)
+		{
+		// FIXME: we don't want to do all this for every polygon!
+		// TODO: store once at start of frame
+			currententity = s->entity;	//FIXME: make this passed in to
+										// R_RotateBmodel ()
+			VectorSubtract (r_origin, currententity->origin,
+					local_modelorg);
+			TransformVector (local_modelorg, transformed_modelorg);
+
+			R_RotateBmodel ();	// FIXME: don't mess with the frustum,
+								// make entity passed in
+		}
+
+		D_CalcGradients (pface);
+		D_SaveGradients (ss);
+		ss->type = ss_turb;
+
+		if (s->insubmodel)
+			D_RestoreWorldState ();
 	}
 	else
 	{
-		for (s = &surfaces[1] ; s<surface_p ; s++)
+		if (s->insubmodel)
 		{
-			if (!s->spans)
-				continue;
-
-			r_drawnpolycount++;
-
-			d_zistepu = s->d_zistepu;
-			d_zistepv = s->d_zistepv;
-			d_ziorigin = s->d_ziorigin;
-
-			if (s->flags & SURF_DRAWSKY)
-			{
-				if (!r_skymade)
-				{
-					R_MakeSky ();
-				}
-
-				D_DrawSkyScans8 (s->spans);
-				D_DrawZSpans (s->spans);
-			}
-			else if (s->flags & SURF_DRAWBACKGROUND)
-			{
-			// set up a gradient for the background surface that places it
-			// effectively at infinity distance from the viewpoint
-				d_zistepu = 0;
-				d_zistepv = 0;
-				d_ziorigin = -0.9;
-
-				D_DrawSolidSurface (s, (int)r_clearcolor.value & 0xFF);
-				D_DrawZSpans (s->spans);
-			}
-			else if (s->flags & SURF_DRAWTURB)
-			{
-				pface = s->data;
-				miplevel = 0;
-				cacheblock = (pixel_t *)
-						((byte *)pface->texinfo->texture +
-						pface->texinfo->texture->offsets[0]);
-				cachewidth = 64;
-
-				if (s->insubmodel)
-				{
-				// FIXME: we don't want to do all this for every polygon!
-				// TODO: store once at start of frame
-					currententity = s->entity;	//FIXME: make this passed in to
-												// R_RotateBmodel ()
-					VectorSubtract (r_origin, currententity->origin,
-							local_modelorg);
-					TransformVector (local_modelorg, transformed_modelorg);
-
-					R_RotateBmodel ();	// FIXME: don't mess with the frustum,
-										// make entity passed in
-				}
-
-				D_CalcGradients (pface);
-				Turbulent8 (s->spans);
-				D_DrawZSpans (s->spans);
-
-				if (s->insubmodel)
-				{
-				//
-				// restore the old drawing state
-				// FIXME: we don't want to do this every time!
-				// TODO: speed up
-				//
-					currententity = &cl_entities[0];
-					VectorCopy (world_transformed_modelorg,
-								transformed_modelorg);
-					VectorCopy (base_vpn, vpn);
-					VectorCopy (base_vup, vup);
-					VectorCopy (base_vright, vright);
-					VectorCopy (base_modelorg, modelorg);
-					R_TransformFrustum ();
-				}
-			}
-			else
-			{
-				if (s->insubmodel)
-				{
-				// FIXME: we don't want to do all this for every polygon!
-				// TODO: store once at start of frame
-					currententity = s->entity;	//FIXME: make this passed in to
-												// R_RotateBmodel ()
-					VectorSubtract (r_origin, currententity->origin, local_modelorg);
-					TransformVector (local_modelorg, transformed_modelorg);
-
-					R_RotateBmodel ();	// FIXME: don't mess with the frustum,
-										// make entity passed in
-				}
-
-				pface = s->data;
-				miplevel = D_MipLevelForScale (s->nearzi * scale_for_mip
-				* pface->texinfo->mipadjust);
-
-			// FIXME: make this passed in to D_CacheSurface
-				pcurrentcache = D_CacheSurface (pface, miplevel);
-
-				cacheblock = (pixel_t *)pcurrentcache->data;
-				cachewidth = pcurrentcache->width;
-
-				D_CalcGradients (pface);
-
-				(*d_drawspans) (s->spans);
-
-				D_DrawZSpans (s->spans);
-
-				if (s->insubmodel)
-				{
-				//
-				// restore the old drawing state
-				// FIXME: we don't want to do this every time!
-				// TODO: speed up
-				//
-					currententity = &cl_entities[0];
-					VectorCopy (world_transformed_modelorg,
-								transformed_modelorg);
-					VectorCopy (base_vpn, vpn);
-					VectorCopy (base_vup, vup);
-					VectorCopy (base_vright, vright);
-					VectorCopy (base_modelorg, modelorg);
-					R_TransformFrustum ();
-				}
-			}
+		// FIXME: we don't want to do all this for every polygon!
+		// TODO: store once at start of frame
+			currententity = s->entity;	//FIXME: make this passed in to
+										// R_RotateBmodel ()
+			VectorSubtract (r_origin, currententity->origin, local_modelorg);
+			TransformVector (local_modelorg, transformed_modelorg);
+
+			R_RotateBmodel ();	// FIXME: don't mess with the frustum,
+								// make entity passed in
 		}
+
+		pface = s->data;
+		miplevel = D_MipLevelForScale (s->nearzi * scale_for_mip
+		* pface->texinfo->mipadjust);
+
+	// FIXME: make this passed in to D_CacheSurface
+		pcurrentcache = D_CacheSurface (pface, miplevel);
+
+		cacheblock = (pixel_t *)pcurrentcache->data;
+		cachewidth = pcurrentcache->width;
+
+		D_CalcGradients (pface);
+		D_SaveGradients (ss);
+		ss->type = ss_texture;
+		ss->cachespot = &pface->cachespots[miplevel];
+
+		if (s->insubmodel)
+			D_RestoreWorldState ();
+	}
+}
+
+
+/*
+==============
+D_DrawSurface
+==============
+*/
+void D_DrawSurface (surf_t *s, surfsetup_t *ss)
+{
+	d_zistepu = ss->d_zistepu;
+	d_zistepv = ss->d_zistepv;
+	d_ziorigin = ss->d_ziorigin;
+
+	switch (ss->type)
+	{
+	case ss_solid:
+		D_DrawSolidSurface (s, ss->color);
+		break;
+
+	case ss_sky:
+		D_DrawSkyScans8 (s->spans);
+		break;
+
+	case ss_turb:
+	case ss_texture:
+		cacheblock = ss->cacheblock;
+		cachewidth = ss->cachewidth;
+		d_sdivzstepu = ss->d_sdivzstepu;
+		d_tdivzstepu = ss->d_tdivzstepu;
+		d_sdivzstepv = ss->d_sdivzstepv;
+		d_tdivzstepv = ss->d_tdivzstepv;
+		d_sdivzorigin = ss->d_sdivzorigin;
+		d_tdivzorigin = ss->d_tdivzorigin;
+		sadjust = ss->sadjust;
+		tadjust = ss->tadjust;
+		bbextents = ss->bbextents;
+		bbextentt = ss->bbextentt;
+
+		if (ss->type == ss_turb)
+			Turbulent8 (s->spans);
+		else
+			(*d_drawspans) (s->spans);
+		break;
+
+	default:
+		return;
 	}
+
+	D_DrawZSpans (s->spans);
 }
 
+
+/*
+==============
+D_DrawSurfaces
+==============
+*/
+void D_DrawSurfaces (void)
+{
+	surf_t			*s;
+	surfsetup_t		ss;
+
+	D_BeginSurfaces ();
+
+	for (s = &surfaces[1] ; s<surface_p ; s++)
+	{
+		if (!s->spans)
+			continue;
+
+		D_SetupSurface (s, &ss);
+		D_DrawSurface (s, &ss);
+	}
+}
@@ -28,8 +28,6 @@ cvar_t	d_subdiv16 = {"d_subdiv16", "1"};
 cvar_t	d_mipcap = {"d_mipcap", "0"};
 cvar_t	d_mipscale = {"d_mipscale", "1"};
 
-surfcache_t		*d_initial_rover;
-qboolean		d_roverwrapped;
 int				d_minmip;
 float			d_scalemip[NUM_MIPS-1];
 
@@ -54,6 +52,11 @@ void D_Init (void)
 	Cvar_RegisterVariable (&d_mipcap);
 	Cvar_RegisterVariable (&d_mipscale);
 
+	Cmd_AddCommand ("d_surfcache", D_SCStats_f);
+
+	// softquake -- Pick the SIMD span drawer for this CPU
+	D_InitSIMD ();
+
 	r_drawpolys = false;
 	r_worldpolysbacktofront = false;
 	r_recursiveaffinetriangles = true;
@@ -133,8 +136,7 @@ void D_SetupFrame (void)
 	else
 		screenwidth = vid.rowbytes;
 
-	d_roverwrapped = false;
-	d_initial_rover = sc_rover;
+	D_SCBeginFrame ();
 
 	d_minmip = d_mipcap.value;
 	if (d_minmip > 3)
@@ -151,7 +153,11 @@ void D_SetupFrame (void)
 				else
 					d_drawspans = D_DrawSpans8;
 #else
-				d_drawspans = D_DrawSpans8;
+				// softquake -- Same pixels as D_DrawSpans8, just faster
+				if (d_simd.value && d_simddrawspans)
+					d_drawspans = d_simddrawspans;
+				else
+					d_drawspans = D_DrawSpans8;
 #endif
 
 	d_aflatcolor = 0;
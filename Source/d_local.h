@@ -45,6 +45,11 @@ typedef struct surfcache_s
 	unsigned			height;		// DEBUG only needed for debug
 	float				mipscale;
 	struct texture_s	*texture;	// checked for animating textures
+	struct surfcache_s	*prev;		// softquake -- previous block in memory
+	struct surfcache_s	*lrunext, *lruprev;	// LRU list when in use, size bucket when free
+	int					bucket;		// size bucket when free, -1 when in use
+	int					lastframe;	// r_framecount when last drawn from
+	int					prebuilt;	// built ahead by r_prebuild, not drawn from yet
 	byte				data[4];	// width*height elements
 } surfcache_t;
 
@@ -58,16 +63,13 @@ extern cvar_t	d_subdiv16;
 
 extern float	scale_for_mip;
 
-extern qboolean		d_roverwrapped;
-extern surfcache_t	*sc_rover;
-extern surfcache_t	*d_initial_rover;
 
-extern float	d_sdivzstepu, d_tdivzstepu, d_zistepu;
-extern float	d_sdivzstepv, d_tdivzstepv, d_zistepv;
-extern float	d_sdivzorigin, d_tdivzorigin, d_ziorigin;
+extern THREAD_LOCAL float	d_sdivzstepu, d_tdivzstepu, d_zistepu;
+extern THREAD_LOCAL float	d_sdivzstepv, d_tdivzstepv, d_zistepv;
+extern THREAD_LOCAL float	d_sdivzorigin, d_tdivzorigin, d_ziorigin;
 
-fixed16_t	sadjust, tadjust;
-fixed16_t	bbextents, bbextentt;
+extern THREAD_LOCAL fixed16_t	sadjust, tadjust;
+extern THREAD_LOCAL fixed16_t	bbextents, bbextentt;
 
 
 void D_DrawSpans8 (espan_t *pspans);
@@ -82,6 +84,10 @@ void D_DrawSkyScans16 (espan_t *pspan);
 void R_ShowSubDiv (void);
 void (*prealspandrawer)(void);
 surfcache_t	*D_CacheSurface (msurface_t *surface, int miplevel);
+void D_SCBeginFrame (void);
+qboolean D_PrebuildSurface (msurface_t *surface, int miplevel, drawsurf_t *ds);
+void D_BuildSurface (drawsurf_t *ds);
+void D_SCStats_f (void);
 
 extern int D_MipLevelForScale (float scale);
 
@@ -109,3 +115,11 @@ extern float	d_scalemip[3];
 
 extern void (*d_drawspans) (espan_t *pspan);
 
+// softquake -- d_simd.c
+extern cvar_t	d_simd;
+extern qboolean	cpu_sse2;
+extern qboolean	cpu_avx2;
+extern void (*d_simddrawspans) (espan_t *pspan);
+
+void D_InitSIMD (void);
+
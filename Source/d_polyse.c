@@ -24,6 +24,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "r_local.h"
 #include "d_local.h"
 
+#ifdef SIMD_X86
+#include <immintrin.h>
+#endif
+
 // TODO: put in span spilling to shrink list size
 // !!! if this is changed, it must be changed in d_polysa.s too !!!
 #define DPS_MAXSPANS			MAXHEIGHT+1	
@@ -115,6 +119,17 @@ void D_PolysetSetEdgeTable (void);
 void D_RasterizeAliasPolySmooth (void);
 void D_PolysetScanLeftEdge (int height);
 
+// softquake -- the gradients are set up separately from the rest of the
+// rasterizing, so they can be worked out for several triangles at once, and the
+// span drawer can be swapped for a SIMD one
+static void D_PolysetRasterize (void);
+static void (*d_polysetdrawspans) (spanpackage_t *pspanpackage) = D_PolysetDrawSpans8;
+
+#if	!id386 && defined SIMD_X86
+static int D_DrawNonSubdivAVX2 (void);
+static void D_PolysetDrawSpans8AVX2 (spanpackage_t *pspanpackage);
+#endif
+
 #if	!id386
 
 /*
@@ -131,6 +146,12 @@ void D_PolysetDraw (void)
 	a_spans = (spanpackage_t *)
 			(((long)&spans[0] + CACHE_SIZE - 1) & ~(CACHE_SIZE - 1));
 
+	d_polysetdrawspans = D_PolysetDrawSpans8;
+#ifdef SIMD_X86
+	if (d_simd.value && cpu_avx2)
+		d_polysetdrawspans = D_PolysetDrawSpans8AVX2;
+#endif
+
 	if (r_affinetridesc.drawtype)
 	{
 		D_DrawSubdiv ();
@@ -252,7 +273,17 @@ void D_DrawNonSubdiv (void)
 	ptri = r_affinetridesc.ptriangles;
 	lnumtriangles = r_affinetridesc.numtriangles;
 
-	for (i=0 ; i<lnumtriangles ; i++, ptri++)
+	i = 0;
+#ifdef SIMD_X86
+// softquake -- whole batches of triangles first, then whatever is left over
+	if (d_simd.value && cpu_avx2)
+	{
+		i = D_DrawNonSubdivAVX2 ();
+		ptri += i;
+	}
+#endif
+
+	for ( ; i<lnumtriangles ; i++, ptri++)
 	{
 		index0 = pfv + ptri->vertindex[0];
 		index1 = pfv + ptri->vertindex[1];
@@ -677,6 +708,357 @@ void D_PolysetDrawSpans8 (spanpackage_t *pspanpackage)
 #endif	// !id386
 
 
+#if	!id386 && defined SIMD_X86
+
+// softquake -- AVX2 versions of the alias model rasterizer
+//
+// Same as the C code, pixel for pixel, as long as the C code does its float
+// math in single precision. Used with d_simd, which is off by default in x87
+// builds for that reason (see d_simd.c).
+
+#define ALIAS_BATCH		8
+
+/*
+================
+D_TransposeVerts
+
+Turns eight finalvert_t, one per register, into one register per field
+================
+*/
+TARGET_AVX2
+static inline void D_TransposeVerts (__m256i *r)
+{
+	__m256i	a0, a1, a2, a3, a4, a5, a6, a7;
+	__m256i	b0, b1, b2, b3, b4, b5, b6, b7;
+
+	a0 = _mm256_unpacklo_epi32 (r[0], r[1]);
+	a1 = _mm256_unpackhi_epi32 (r[0], r[1]);
+	a2 = _mm256_unpacklo_epi32 (r[2], r[3]);
+	a3 = _mm256_unpackhi_epi32 (r[2], r[3]);
+	a4 = _mm256_unpacklo_epi32 (r[4], r[5]);
+	a5 = _mm256_unpackhi_epi32 (r[4], r[5]);
+	a6 = _mm256_unpacklo_epi32 (r[6], r[7]);
+	a7 = _mm256_unpackhi_epi32 (r[6], r[7]);
+
+	b0 = _mm256_unpacklo_epi64 (a0, a2);
+	b1 = _mm256_unpackhi_epi64 (a0, a2);
+	b2 = _mm256_unpacklo_epi64 (a1, a3);
+	b3 = _mm256_unpackhi_epi64 (a1, a3);
+	b4 = _mm256_unpacklo_epi64 (a4, a6);
+	b5 = _mm256_unpackhi_epi64 (a4, a6);
+	b6 = _mm256_unpacklo_epi64 (a5, a7);
+	b7 = _mm256_unpackhi_epi64 (a5, a7);
+
+	r[0] = _mm256_permute2x128_si256 (b0, b4, 0x20);
+	r[1] = _mm256_permute2x128_si256 (b1, b5, 0x20);
+	r[2] = _mm256_permute2x128_si256 (b2, b6, 0x20);
+	r[3] = _mm256_permute2x128_si256 (b3, b7, 0x20);
+	r[4] = _mm256_permute2x128_si256 (b0, b4, 0x31);
+	r[5] = _mm256_permute2x128_si256 (b1, b5, 0x31);
+	r[6] = _mm256_permute2x128_si256 (b2, b6, 0x31);
+	r[7] = _mm256_permute2x128_si256 (b3, b7, 0x31);
+}
+
+
+/*
+================
+D_DrawNonSubdivAVX2
+
+Backface culls and sets up the gradients for eight triangles at a time, then
+rasterizes the ones that are left in order. Returns the number of triangles
+done, which is everything but the last few that don't fill a whole batch.
+================
+*/
+TARGET_AVX2
+static int D_DrawNonSubdivAVX2 (void)
+{
+	mtriangle_t		*ptri;
+	finalvert_t		*pfv, *index0, *index1, *index2;
+	int				i, j, k, visible;
+	int				lnumtriangles;
+	int				facesfront[ALIAS_BATCH];
+	int				xdenom[ALIAS_BATCH];
+	int				lstepx[ALIAS_BATCH], lstepy[ALIAS_BATCH];
+	int				sstepx[ALIAS_BATCH], sstepy[ALIAS_BATCH];
+	int				tstepx[ALIAS_BATCH], tstepy[ALIAS_BATCH];
+	int				zistepx[ALIAS_BATCH], zistepy[ALIAS_BATCH];
+	__m256i			p0[8], p1[8], p2[8];
+	__m256i			seam, onseam, denom;
+	__m256			xinv, yinv, t0, t1, p00_minus_p20, p01_minus_p21;
+	__m256			p10_minus_p20, p11_minus_p21;
+
+	pfv = r_affinetridesc.pfinalverts;
+	ptri = r_affinetridesc.ptriangles;
+	lnumtriangles = r_affinetridesc.numtriangles;
+
+	onseam = _mm256_set1_epi32 (ALIAS_ONSEAM);
+
+	for (i=0 ; i + ALIAS_BATCH <= lnumtriangles ; i += ALIAS_BATCH)
+	{
+	// finalvert_t is eight ints, so each vertex fits in a register
+		for (k=0 ; k<ALIAS_BATCH ; k++)
+		{
+			p0[k] = _mm256_loadu_si256 ((__m256i *)&pfv[ptri[i+k].vertindex[0]]);
+			p1[k] = _mm256_loadu_si256 ((__m256i *)&pfv[ptri[i+k].vertindex[1]]);
+			p2[k] = _mm256_loadu_si256 ((__m256i *)&pfv[ptri[i+k].vertindex[2]]);
+			facesfront[k] = ptri[i+k].facesfront;
+		}
+
+		D_TransposeVerts (p0);
+		D_TransposeVerts (p1);
+		D_TransposeVerts (p2);
+
+		denom = _mm256_sub_epi32 (
+				_mm256_mullo_epi32 (_mm256_sub_epi32 (p0[1], p1[1]),
+						_mm256_sub_epi32 (p0[0], p2[0])),
+				_mm256_mullo_epi32 (_mm256_sub_epi32 (p0[0], p1[0]),
+						_mm256_sub_epi32 (p0[1], p2[1])));
+
+		visible = _mm256_movemask_ps (_mm256_castsi256_ps (
+				_mm256_cmpgt_epi32 (_mm256_setzero_si256 (), denom)));
+		if (!visible)
+			continue;
+
+	// seam fixup for the triangles that face away
+		seam = _mm256_cmpeq_epi32 (_mm256_loadu_si256 ((__m256i *)facesfront),
+				_mm256_setzero_si256 ());
+		seam = _mm256_and_si256 (seam, _mm256_set1_epi32 (r_affinetridesc.seamfixupX16));
+
+		p0[2] = _mm256_add_epi32 (p0[2], _mm256_and_si256 (seam,
+				_mm256_cmpeq_epi32 (onseam, _mm256_and_si256 (p0[6], onseam))));
+		p1[2] = _mm256_add_epi32 (p1[2], _mm256_and_si256 (seam,
+				_mm256_cmpeq_epi32 (onseam, _mm256_and_si256 (p1[6], onseam))));
+		p2[2] = _mm256_add_epi32 (p2[2], _mm256_and_si256 (seam,
+				_mm256_cmpeq_epi32 (onseam, _mm256_and_si256 (p2[6], onseam))));
+
+	// same as D_PolysetCalcGradients
+		p00_minus_p20 = _mm256_cvtepi32_ps (_mm256_sub_epi32 (p0[0], p2[0]));
+		p01_minus_p21 = _mm256_cvtepi32_ps (_mm256_sub_epi32 (p0[1], p2[1]));
+		p10_minus_p20 = _mm256_cvtepi32_ps (_mm256_sub_epi32 (p1[0], p2[0]));
+		p11_minus_p21 = _mm256_cvtepi32_ps (_mm256_sub_epi32 (p1[1], p2[1]));
+
+		xinv = _mm256_div_ps (_mm256_set1_ps (1.0f), _mm256_cvtepi32_ps (denom));
+		yinv = _mm256_xor_ps (xinv, _mm256_set1_ps (-0.0f));
+
+#define GRADIENT(c, xout, yout, round)												\
+		t0 = _mm256_cvtepi32_ps (_mm256_sub_epi32 (p0[c], p2[c]));					\
+		t1 = _mm256_cvtepi32_ps (_mm256_sub_epi32 (p1[c], p2[c]));					\
+		_mm256_storeu_si256 ((__m256i *)xout, _mm256_cvttps_epi32 (round (_mm256_mul_ps (	\
+				_mm256_sub_ps (_mm256_mul_ps (t1, p01_minus_p21),					\
+				_mm256_mul_ps (t0, p11_minus_p21)), xinv))));						\
+		_mm256_storeu_si256 ((__m256i *)yout, _mm256_cvttps_epi32 (round (_mm256_mul_ps (	\
+				_mm256_sub_ps (_mm256_mul_ps (t1, p00_minus_p20),					\
+				_mm256_mul_ps (t0, p10_minus_p20)), yinv))));
+
+#define NOROUND(x)	(x)
+
+		GRADIENT (4, lstepx, lstepy, _mm256_ceil_ps);
+		GRADIENT (2, sstepx, sstepy, NOROUND);
+		GRADIENT (3, tstepx, tstepy, NOROUND);
+		GRADIENT (5, zistepx, zistepy, NOROUND);
+
+#undef GRADIENT
+#undef NOROUND
+
+		_mm256_storeu_si256 ((__m256i *)xdenom, denom);
+
+	// the rasterizer is plain C, so don't make it pay for the upper halves
+		_mm256_zeroupper ();
+
+	// draw the ones that face the viewer, in order
+		for (k=0 ; k<ALIAS_BATCH ; k++)
+		{
+			if (!(visible & (1 << k)))
+				continue;
+
+			index0 = pfv + ptri[i+k].vertindex[0];
+			index1 = pfv + ptri[i+k].vertindex[1];
+			index2 = pfv + ptri[i+k].vertindex[2];
+
+			for (j=0 ; j<6 ; j++)
+			{
+				r_p0[j] = index0->v[j];
+				r_p1[j] = index1->v[j];
+				r_p2[j] = index2->v[j];
+			}
+
+			if (!facesfront[k])
+			{
+				if (index0->flags & ALIAS_ONSEAM)
+					r_p0[2] += r_affinetridesc.seamfixupX16;
+				if (index1->flags & ALIAS_ONSEAM)
+					r_p1[2] += r_affinetridesc.seamfixupX16;
+				if (index2->flags & ALIAS_ONSEAM)
+					r_p2[2] += r_affinetridesc.seamfixupX16;
+			}
+
+			d_xdenom = xdenom[k];
+			r_lstepx = lstepx[k];
+			r_lstepy = lstepy[k];
+			r_sstepx = sstepx[k];
+			r_sstepy = sstepy[k];
+			r_tstepx = tstepx[k];
+			r_tstepy = tstepy[k];
+			r_zistepx = zistepx[k];
+			r_zistepy = zistepy[k];
+
+			a_sstepxfrac = r_sstepx & 0xFFFF;
+			a_tstepxfrac = r_tstepx & 0xFFFF;
+			a_ststepxwhole = r_affinetridesc.skinwidth * (r_tstepx >> 16) +
+					(r_sstepx >> 16);
+
+			D_PolysetSetEdgeTable ();
+			D_PolysetRasterize ();
+		}
+	}
+
+	return i;
+}
+
+
+/*
+================
+D_PolysetDrawSpans8AVX2
+
+Eight pixels at a time, with whatever doesn't fill a whole group done the same
+way as D_PolysetDrawSpans8.
+
+The texels and colormap entries are gathered 32 bits at a time, ending on the
+byte that's wanted, so nothing past the end of the skin or colormap is read.
+================
+*/
+TARGET_AVX2
+static void D_PolysetDrawSpans8AVX2 (spanpackage_t *pspanpackage)
+{
+	int		lcount;
+	byte	*lpdest;
+	byte	*lptex;
+	int		lsfrac, ltfrac;
+	int		llight;
+	int		lzi;
+	short	*lpz;
+	byte	*colormap;
+	__m256i	ramp, sfracramp, tfracramp, texramp, lightramp, ziramp;
+	__m256i	skinw, lightmask, byteshuf, packperm;
+	__m256i	offs, texel, pix, z, zb, mask, old;
+
+	colormap = (byte *)acolormap - 3;
+	skinw = _mm256_set1_epi32 (r_affinetridesc.skinwidth);
+	lightmask = _mm256_set1_epi32 (0xFF00);
+
+	ramp = _mm256_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7);
+	sfracramp = _mm256_mullo_epi32 (ramp, _mm256_set1_epi32 (a_sstepxfrac));
+	tfracramp = _mm256_mullo_epi32 (ramp, _mm256_set1_epi32 (a_tstepxfrac));
+	texramp = _mm256_mullo_epi32 (ramp, _mm256_set1_epi32 (a_ststepxwhole));
+	lightramp = _mm256_mullo_epi32 (ramp, _mm256_set1_epi32 (r_lstepx));
+	ziramp = _mm256_mullo_epi32 (ramp, _mm256_set1_epi32 (r_zistepx));
+
+// low byte of each lane, packed down into the bottom of the vector
+	byteshuf = _mm256_setr_epi8 (0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+			0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	packperm = _mm256_setr_epi32 (0, 4, 1, 5, 2, 6, 3, 7);
+
+	do
+	{
+		lcount = d_aspancount - pspanpackage->count;
+
+		errorterm += erroradjustup;
+		if (errorterm >= 0)
+		{
+			d_aspancount += d_countextrastep;
+			errorterm -= erroradjustdown;
+		}
+		else
+		{
+			d_aspancount += ubasestep;
+		}
+
+		if (lcount > 0)
+		{
+			lpdest = pspanpackage->pdest;
+			lptex = pspanpackage->ptex;
+			lpz = pspanpackage->pz;
+			lsfrac = pspanpackage->sfrac;
+			ltfrac = pspanpackage->tfrac;
+			llight = pspanpackage->light;
+			lzi = pspanpackage->zi;
+
+			for ( ; lcount >= 8 ; lcount -= 8)
+			{
+			// texel offsets, carrying the fractions the same way the C code does
+				offs = _mm256_add_epi32 (texramp, _mm256_srli_epi32 (_mm256_add_epi32 (
+						_mm256_set1_epi32 (lsfrac), sfracramp), 16));
+				offs = _mm256_add_epi32 (offs, _mm256_mullo_epi32 (skinw, _mm256_srli_epi32 (
+						_mm256_add_epi32 (_mm256_set1_epi32 (ltfrac), tfracramp), 16)));
+
+				texel = _mm256_srli_epi32 (_mm256_i32gather_epi32 (
+						(const int *)(lptex - 3), offs, 1), 24);
+				texel = _mm256_add_epi32 (texel, _mm256_and_si256 (lightmask,
+						_mm256_add_epi32 (_mm256_set1_epi32 (llight), lightramp)));
+				pix = _mm256_srli_epi32 (_mm256_i32gather_epi32 (
+						(const int *)colormap, texel, 1), 24);
+
+			// z test
+				z = _mm256_srai_epi32 (_mm256_add_epi32 (_mm256_set1_epi32 (lzi), ziramp), 16);
+				zb = _mm256_cvtepi16_epi32 (_mm_loadu_si128 ((__m128i *)lpz));
+				mask = _mm256_cmpgt_epi32 (zb, z);		// set where hidden
+
+				z = _mm256_blendv_epi8 (z, zb, mask);
+				z = _mm256_permutevar8x32_epi32 (_mm256_shuffle_epi8 (z, _mm256_setr_epi8 (
+						0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1,
+						0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1)),
+						_mm256_setr_epi32 (0, 1, 4, 5, 2, 3, 6, 7));
+				_mm_storeu_si128 ((__m128i *)lpz, _mm256_castsi256_si128 (z));
+
+				old = _mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((__m128i *)lpdest));
+				pix = _mm256_blendv_epi8 (pix, old, mask);
+				pix = _mm256_permutevar8x32_epi32 (_mm256_shuffle_epi8 (pix, byteshuf), packperm);
+				_mm_storel_epi64 ((__m128i *)lpdest, _mm256_castsi256_si128 (pix));
+
+				lpdest += 8;
+				lpz += 8;
+				lzi += r_zistepx * 8;
+				llight += r_lstepx * 8;
+				lptex += a_ststepxwhole * 8;
+				lsfrac += a_sstepxfrac * 8;
+				lptex += lsfrac >> 16;
+				lsfrac &= 0xFFFF;
+				ltfrac += a_tstepxfrac * 8;
+				lptex += (ltfrac >> 16) * r_affinetridesc.skinwidth;
+				ltfrac &= 0xFFFF;
+			}
+
+			for ( ; lcount ; lcount--)
+			{
+				if ((lzi >> 16) >= *lpz)
+				{
+					*lpdest = ((byte *)acolormap)[*lptex + (llight & 0xFF00)];
+					*lpz = lzi >> 16;
+				}
+				lpdest++;
+				lzi += r_zistepx;
+				lpz++;
+				llight += r_lstepx;
+				lptex += a_ststepxwhole;
+				lsfrac += a_sstepxfrac;
+				lptex += lsfrac >> 16;
+				lsfrac &= 0xFFFF;
+				ltfrac += a_tstepxfrac;
+				if (ltfrac & 0x10000)
+				{
+					lptex += r_affinetridesc.skinwidth;
+					ltfrac &= 0xFFFF;
+				}
+			}
+		}
+
+		pspanpackage++;
+	} while (pspanpackage->count != -999999);
+}
+
+#endif	// !id386 && SIMD_X86
+
+
 /*
 ================
 D_PolysetFillSpans8
@@ -720,6 +1102,26 @@ D_RasterizeAliasPolySmooth
 ================
 */
 void D_RasterizeAliasPolySmooth (void)
+{
+//
+// set the s, t, and light gradients, which are consistent across the triangle
+// because being a triangle, things are affine
+//
+	D_PolysetCalcGradients (r_affinetridesc.skinwidth);
+
+	D_PolysetRasterize ();
+}
+
+
+/*
+================
+D_PolysetRasterize
+
+Rasterizes the triangle in r_p0, r_p1 and r_p2 with the gradients that have
+already been set up
+================
+*/
+static void D_PolysetRasterize (void)
 {
 	int				initialleftheight, initialrightheight;
 	int				*plefttop, *prighttop, *pleftbottom, *prightbottom;
@@ -734,12 +1136,6 @@ void D_RasterizeAliasPolySmooth (void)
 	initialleftheight = pleftbottom[1] - plefttop[1];
 	initialrightheight = prightbottom[1] - prighttop[1];
 
-//
-// set the s, t, and light gradients, which are consistent across the triangle
-// because being a triangle, things are affine
-//
-	D_PolysetCalcGradients (r_affinetridesc.skinwidth);
-
 //
 // rasterize the polygon
 //
@@ -944,7 +1340,7 @@ void D_RasterizeAliasPolySmooth (void)
 	d_countextrastep = ubasestep + 1;
 	originalcount = a_spans[initialrightheight].count;
 	a_spans[initialrightheight].count = -999999; // mark end of the spanpackages
-	D_PolysetDrawSpans8 (a_spans);
+	d_polysetdrawspans (a_spans);
 
 // scan out the bottom part of the right edge, if it exists
 	if (pedgetable->numrightedges == 2)
@@ -968,7 +1364,7 @@ void D_RasterizeAliasPolySmooth (void)
 		d_countextrastep = ubasestep + 1;
 		a_spans[initialrightheight + height].count = -999999;
 											// mark end of the spanpackages
-		D_PolysetDrawSpans8 (pstart);
+		d_polysetdrawspans (pstart);
 	}
 }
 
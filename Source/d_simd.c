@@ -0,0 +1,438 @@
+/*
+Copyright (C) 2023-2023 softquake
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+// d_simd.c -- SSE2 and AVX2 versions of the hottest rasterization loops
+
+// Picked at startup based on what the CPU supports. D_DrawSpans8 in d_scan.c
+// is still used on anything else, or with d_simd 0.
+//
+// These produce the same pixels as the C code, as long as the C code does its
+// float math in single precision (SSE). x87 builds keep extra precision in
+// registers, so the odd texel can land one step over. That's why d_simd is off
+// by default in those builds, unless they're built with -mfpmath=sse.
+
+#include <SDL2/SDL_cpuinfo.h>
+
+#include "quakedef.h"
+#include "d_local.h"
+
+#ifdef SIMD_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+#ifdef FLOAT_X87
+cvar_t	d_simd = {"d_simd", "0", CV_ARCHIVE};
+#else
+cvar_t	d_simd = {"d_simd", "1", CV_ARCHIVE};
+#endif
+
+qboolean	cpu_sse2;
+qboolean	cpu_avx2;
+
+void (*d_simddrawspans) (espan_t *pspan);
+
+#if	!id386 && defined SIMD_X86
+
+#define MAX_SUBDIVS		((MAXWIDTH + 7) / 8 + 8)	// padded out to a whole vector
+
+typedef struct
+{
+	int		count;
+	int		s, t;						// at the start of the span
+	float	sdivz[MAX_SUBDIVS];			// at the far end of each subdivision
+	float	tdivz[MAX_SUBDIVS];
+	float	zi[MAX_SUBDIVS];
+	int		snext[MAX_SUBDIVS];
+	int		tnext[MAX_SUBDIVS];
+} spanends_t;
+
+/*
+=============
+D_SpanEnds
+
+Same math as D_DrawSpans8, in the same order, but the far end of every
+subdivision is worked out before any pixels are drawn. Returns the number of
+subdivisions.
+=============
+*/
+static int D_SpanEnds (espan_t *pspan, spanends_t *ends, int width)
+{
+	int		i, n, count, spancount;
+	float	sdivz, tdivz, zi, z, du, dv, spancountminus1;
+	float	sdivz8stepu, tdivz8stepu, zi8stepu;
+	int		s, t;
+
+	sdivz8stepu = d_sdivzstepu * 8;
+	tdivz8stepu = d_tdivzstepu * 8;
+	zi8stepu = d_zistepu * 8;
+
+	count = pspan->count;
+	ends->count = count;
+
+// calculate the initial s/z, t/z, 1/z, s, and t and clamp
+	du = (float)pspan->u;
+	dv = (float)pspan->v;
+
+	sdivz = d_sdivzorigin + dv*d_sdivzstepv + du*d_sdivzstepu;
+	tdivz = d_tdivzorigin + dv*d_tdivzstepv + du*d_tdivzstepu;
+	zi = d_ziorigin + dv*d_zistepv + du*d_zistepu;
+	z = (float)0x10000 / zi;	// prescale to 16.16 fixed-point
+
+	s = (int)(sdivz * z) + sadjust;
+	if (s > bbextents)
+		s = bbextents;
+	else if (s < 0)
+		s = 0;
+
+	t = (int)(tdivz * z) + tadjust;
+	if (t > bbextentt)
+		t = bbextentt;
+	else if (t < 0)
+		t = 0;
+
+	ends->s = s;
+	ends->t = t;
+
+	n = 0;
+	do
+	{
+		if (count >= 8)
+			spancount = 8;
+		else
+			spancount = count;
+
+		count -= spancount;
+
+		if (count)
+		{
+			sdivz += sdivz8stepu;
+			tdivz += tdivz8stepu;
+			zi += zi8stepu;
+		}
+		else
+		{
+			spancountminus1 = (float)(spancount - 1);
+			sdivz += d_sdivzstepu * spancountminus1;
+			tdivz += d_tdivzstepu * spancountminus1;
+			zi += d_zistepu * spancountminus1;
+		}
+
+		ends->sdivz[n] = sdivz;
+		ends->tdivz[n] = tdivz;
+		ends->zi[n] = zi;
+		n++;
+	} while (count > 0);
+
+// pad out to a whole vector with something harmless to divide by
+	for (i=n ; i & (width - 1) ; i++)
+	{
+		ends->sdivz[i] = 0;
+		ends->tdivz[i] = 0;
+		ends->zi[i] = 1;
+	}
+
+	return n;
+}
+
+
+/*
+=============
+D_SpanStep
+
+sstep and tstep for subdivision i, same as D_DrawSpans8
+=============
+*/
+static int D_SpanStep (spanends_t *ends, int i, int s, int t, int *sstep, int *tstep)
+{
+	int		spancount;
+
+	spancount = ends->count - i*8;
+
+	if (spancount > 8)
+	{
+		*sstep = (ends->snext[i] - s) >> 3;
+		*tstep = (ends->tnext[i] - t) >> 3;
+		return 8;
+	}
+
+	if (spancount > 1)
+	{
+		*sstep = (ends->snext[i] - s) / (spancount - 1);
+		*tstep = (ends->tnext[i] - t) / (spancount - 1);
+	}
+
+	return spancount;
+}
+
+
+/*
+=============
+D_SpanEndsSSE2
+
+Turns s/z, t/z and 1/z at the end of each subdivision into clamped s and t,
+four at a time
+=============
+*/
+TARGET_SSE2
+static void D_SpanEndsSSE2 (spanends_t *ends, int n)
+{
+	int		i;
+	__m128	z, one;
+	__m128i	s, t, gt, lt;
+	__m128i	sadj, tadj, bbs, bbt, eight;
+
+	one = _mm_set1_ps ((float)0x10000);
+	sadj = _mm_set1_epi32 (sadjust);
+	tadj = _mm_set1_epi32 (tadjust);
+	bbs = _mm_set1_epi32 (bbextents);
+	bbt = _mm_set1_epi32 (bbextentt);
+	eight = _mm_set1_epi32 (8);
+
+	for (i=0 ; i<n ; i+=4)
+	{
+		z = _mm_div_ps (one, _mm_loadu_ps (&ends->zi[i]));
+
+	// clamp to [8, bbextents], with bbextents winning
+		s = _mm_add_epi32 (_mm_cvttps_epi32 (_mm_mul_ps (_mm_loadu_ps (&ends->sdivz[i]), z)), sadj);
+		gt = _mm_cmpgt_epi32 (s, bbs);
+		lt = _mm_cmplt_epi32 (s, eight);
+		s = _mm_or_si128 (_mm_and_si128 (lt, eight), _mm_andnot_si128 (lt, s));
+		s = _mm_or_si128 (_mm_and_si128 (gt, bbs), _mm_andnot_si128 (gt, s));
+		_mm_storeu_si128 ((__m128i *)&ends->snext[i], s);
+
+		t = _mm_add_epi32 (_mm_cvttps_epi32 (_mm_mul_ps (_mm_loadu_ps (&ends->tdivz[i]), z)), tadj);
+		gt = _mm_cmpgt_epi32 (t, bbt);
+		lt = _mm_cmplt_epi32 (t, eight);
+		t = _mm_or_si128 (_mm_and_si128 (lt, eight), _mm_andnot_si128 (lt, t));
+		t = _mm_or_si128 (_mm_and_si128 (gt, bbt), _mm_andnot_si128 (gt, t));
+		_mm_storeu_si128 ((__m128i *)&ends->tnext[i], t);
+	}
+}
+
+
+/*
+=============
+D_DrawSpans8SSE2
+=============
+*/
+TARGET_SSE2
+static void D_DrawSpans8SSE2 (espan_t *pspan)
+{
+	int				i, j, n, spancount;
+	unsigned char	*pbase, *pdest;
+	int				s, t, sstep, tstep;
+	spanends_t		ends;
+	__m128i			width, vs, vt, offs;
+	int				ofs[8];
+
+	pbase = (unsigned char *)cacheblock;
+	width = _mm_set1_epi32 (cachewidth);	// cachewidth fits in the low 16 bits
+
+	sstep = 0;	// keep compiler happy
+	tstep = 0;	// ditto
+
+	do
+	{
+		pdest = (unsigned char *)((byte *)d_viewbuffer +
+				(screenwidth * pspan->v) + pspan->u);
+
+		n = D_SpanEnds (pspan, &ends, 4);
+		D_SpanEndsSSE2 (&ends, n);
+
+		s = ends.s;
+		t = ends.t;
+
+		for (i=0 ; i<n ; i++)
+		{
+			spancount = D_SpanStep (&ends, i, s, t, &sstep, &tstep);
+
+		// s and t for four pixels at once, then (s >> 16) + (t >> 16) * cachewidth
+		// s and t never go negative, so the multiply can be done in 16 bits
+			vs = _mm_add_epi32 (_mm_set1_epi32 (s), _mm_setr_epi32 (0, sstep, sstep*2, sstep*3));
+			vt = _mm_add_epi32 (_mm_set1_epi32 (t), _mm_setr_epi32 (0, tstep, tstep*2, tstep*3));
+			offs = _mm_add_epi32 (_mm_srai_epi32 (vs, 16), _mm_madd_epi16 (_mm_srai_epi32 (vt, 16), width));
+			_mm_storeu_si128 ((__m128i *)&ofs[0], offs);
+
+			if (spancount > 4)
+			{
+				vs = _mm_add_epi32 (vs, _mm_set1_epi32 (sstep*4));
+				vt = _mm_add_epi32 (vt, _mm_set1_epi32 (tstep*4));
+				offs = _mm_add_epi32 (_mm_srai_epi32 (vs, 16), _mm_madd_epi16 (_mm_srai_epi32 (vt, 16), width));
+				_mm_storeu_si128 ((__m128i *)&ofs[4], offs);
+			}
+
+			for (j=0 ; j<spancount ; j++)
+				pdest[j] = pbase[ofs[j]];
+
+			pdest += spancount;
+			s = ends.snext[i];
+			t = ends.tnext[i];
+		}
+
+	} while ((pspan = pspan->pnext) != NULL);
+}
+
+
+/*
+=============
+D_SpanEndsAVX2
+
+Same as D_SpanEndsSSE2, eight at a time
+=============
+*/
+TARGET_AVX2
+static void D_SpanEndsAVX2 (spanends_t *ends, int n)
+{
+	int		i;
+	__m256	z, one;
+	__m256i	s, t, gt, lt;
+	__m256i	sadj, tadj, bbs, bbt, eight;
+
+	one = _mm256_set1_ps ((float)0x10000);
+	sadj = _mm256_set1_epi32 (sadjust);
+	tadj = _mm256_set1_epi32 (tadjust);
+	bbs = _mm256_set1_epi32 (bbextents);
+	bbt = _mm256_set1_epi32 (bbextentt);
+	eight = _mm256_set1_epi32 (8);
+
+	for (i=0 ; i<n ; i+=8)
+	{
+		z = _mm256_div_ps (one, _mm256_loadu_ps (&ends->zi[i]));
+
+	// clamp to [8, bbextents], with bbextents winning
+		s = _mm256_add_epi32 (_mm256_cvttps_epi32 (_mm256_mul_ps (_mm256_loadu_ps (&ends->sdivz[i]), z)), sadj);
+		gt = _mm256_cmpgt_epi32 (s, bbs);
+		lt = _mm256_cmpgt_epi32 (eight, s);
+		s = _mm256_blendv_epi8 (s, eight, lt);
+		s = _mm256_blendv_epi8 (s, bbs, gt);
+		_mm256_storeu_si256 ((__m256i *)&ends->snext[i], s);
+
+		t = _mm256_add_epi32 (_mm256_cvttps_epi32 (_mm256_mul_ps (_mm256_loadu_ps (&ends->tdivz[i]), z)), tadj);
+		gt = _mm256_cmpgt_epi32 (t, bbt);
+		lt = _mm256_cmpgt_epi32 (eight, t);
+		t = _mm256_blendv_epi8 (t, eight, lt);
+		t = _mm256_blendv_epi8 (t, bbt, gt);
+		_mm256_storeu_si256 ((__m256i *)&ends->tnext[i], t);
+	}
+}
+
+
+/*
+=============
+D_DrawSpans8AVX2
+=============
+*/
+TARGET_AVX2
+static void D_DrawSpans8AVX2 (espan_t *pspan)
+{
+	int				i, n, spancount;
+	unsigned char	*pbase, *pdest;
+	int				s, t, sstep, tstep;
+	spanends_t		ends;
+	__m256i			width, lanes, mask, vs, vt, offs, texels;
+	__m128i			packed;
+	unsigned char	out[16];
+
+	pbase = (unsigned char *)cacheblock;
+	width = _mm256_set1_epi32 (cachewidth);
+	lanes = _mm256_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7);
+
+	sstep = 0;	// keep compiler happy
+	tstep = 0;	// ditto
+
+	do
+	{
+		pdest = (unsigned char *)((byte *)d_viewbuffer +
+				(screenwidth * pspan->v) + pspan->u);
+
+		n = D_SpanEnds (pspan, &ends, 8);
+		D_SpanEndsAVX2 (&ends, n);
+
+		s = ends.s;
+		t = ends.t;
+
+		for (i=0 ; i<n ; i++)
+		{
+			spancount = D_SpanStep (&ends, i, s, t, &sstep, &tstep);
+
+			vs = _mm256_add_epi32 (_mm256_set1_epi32 (s), _mm256_mullo_epi32 (lanes, _mm256_set1_epi32 (sstep)));
+			vt = _mm256_add_epi32 (_mm256_set1_epi32 (t), _mm256_mullo_epi32 (lanes, _mm256_set1_epi32 (tstep)));
+			offs = _mm256_add_epi32 (_mm256_srai_epi32 (vs, 16),
+					_mm256_mullo_epi32 (_mm256_srai_epi32 (vt, 16), width));
+
+		// fetch the texel as the top byte of a dword, so the load never
+		// reaches past it (the surfcache_t header sits in front of the data)
+		// pixels past the end of the subdivision are left alone
+			mask = _mm256_cmpgt_epi32 (_mm256_set1_epi32 (spancount), lanes);
+			texels = _mm256_mask_i32gather_epi32 (_mm256_setzero_si256 (),
+					(const int *)(pbase - 3), offs, mask, 1);
+			texels = _mm256_srli_epi32 (texels, 24);
+
+			packed = _mm_packs_epi32 (_mm256_castsi256_si128 (texels),
+					_mm256_extracti128_si256 (texels, 1));
+			packed = _mm_packus_epi16 (packed, packed);
+
+			if (spancount == 8)
+			{
+				_mm_storel_epi64 ((__m128i *)pdest, packed);
+			}
+			else
+			{
+				_mm_storeu_si128 ((__m128i *)out, packed);
+				memcpy (pdest, out, spancount);
+			}
+
+			pdest += spancount;
+			s = ends.snext[i];
+			t = ends.tnext[i];
+		}
+
+	} while ((pspan = pspan->pnext) != NULL);
+}
+
+#endif	// !id386 && SIMD_X86
+
+
+/*
+=============
+D_InitSIMD
+=============
+*/
+void D_InitSIMD (void)
+{
+	Cvar_RegisterVariable (&d_simd);
+
+	d_simddrawspans = NULL;
+
+#ifdef SIMD_X86
+	cpu_sse2 = SDL_HasSSE2 ();
+	cpu_avx2 = SDL_HasAVX2 ();
+#endif
+
+#if	!id386 && defined SIMD_X86
+	if (cpu_avx2)
+		d_simddrawspans = D_DrawSpans8AVX2;
+	else if (cpu_sse2)
+		d_simddrawspans = D_DrawSpans8SSE2;
+#endif
+
+	Con_Printf ("SIMD:%s%s\n", cpu_sse2 ? " SSE2" : "", cpu_avx2 ? " AVX2" : "");
+}
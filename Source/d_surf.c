@@ -27,10 +27,41 @@ float           surfscale;
 qboolean        r_cache_thrash;         // set if surface cache is thrashing
 
 int                                     sc_size;
-surfcache_t                     *sc_rover, *sc_base;
+surfcache_t                     *sc_base;
 
 #define GUARDSIZE       4
 
+// softquake -- The original allocator swept a rover through the cache and threw
+// out whatever it ran over. Blocks in use are now kept on an LRU list, and free
+// blocks are kept in buckets by size, so the surfaces that get thrown out are
+// the ones that haven't been looked at for the longest time.
+
+#define MINFRAGMENT		256
+#define NUM_SC_BUCKETS	32		// one per power of two
+
+static surfcache_t	sc_lru;		// lrunext is the oldest, lruprev the newest
+static surfcache_t	*sc_buckets[NUM_SC_BUCKETS];
+
+typedef struct
+{
+	double	hits;
+	double	misses;
+	double	newsurfs;		// misses that had no cache block
+	double	lightchanges;	// misses because a lightstyle changed
+	double	dlights;		// misses because of a dynamic light, now or last frame
+	double	animations;		// misses because the texture animated
+	double	bytesbuilt;
+	double	evictions;
+	double	evictedframe;	// evictions of surfaces used this same frame
+	double	prebuilt;		// built ahead by r_prebuild
+	double	prebuilthits;	// prebuilt surfaces that got drawn
+} scstats_t;
+
+static scstats_t	sc_frame, sc_lastframe, sc_total;
+static int			sc_numframes;
+
+int D_log2 (int num);
+
 
 int     D_SurfaceCacheForRes (int width, int height)
 {
@@ -74,6 +105,171 @@ void D_ClearCacheGuard (void)
 }
 
 
+/*
+================
+D_SCLinkFree
+
+Puts a free block in the bucket for its size
+================
+*/
+static void D_SCLinkFree (surfcache_t *c)
+{
+	int		b;
+
+	b = D_log2 (c->size);
+	if (b >= NUM_SC_BUCKETS)
+		b = NUM_SC_BUCKETS - 1;
+
+	c->owner = NULL;
+	c->width = 0;
+	c->bucket = b;
+	c->lruprev = NULL;
+	c->lrunext = sc_buckets[b];
+	if (c->lrunext)
+		c->lrunext->lruprev = c;
+	sc_buckets[b] = c;
+}
+
+
+/*
+================
+D_SCUnlinkFree
+================
+*/
+static void D_SCUnlinkFree (surfcache_t *c)
+{
+	if (c->lruprev)
+		c->lruprev->lrunext = c->lrunext;
+	else
+		sc_buckets[c->bucket] = c->lrunext;
+	if (c->lrunext)
+		c->lrunext->lruprev = c->lruprev;
+
+	c->bucket = -1;
+}
+
+
+/*
+================
+D_SCUnlinkLRU
+================
+*/
+static void D_SCUnlinkLRU (surfcache_t *c)
+{
+	c->lruprev->lrunext = c->lrunext;
+	c->lrunext->lruprev = c->lruprev;
+}
+
+
+/*
+================
+D_SCLinkLRU
+
+Makes c the most recently used block
+================
+*/
+static void D_SCLinkLRU (surfcache_t *c)
+{
+	c->lrunext = &sc_lru;
+	c->lruprev = sc_lru.lruprev;
+	sc_lru.lruprev->lrunext = c;
+	sc_lru.lruprev = c;
+}
+
+
+/*
+================
+D_SCTouch
+================
+*/
+static void D_SCTouch (surfcache_t *c)
+{
+	if (c->lastframe == r_framecount)
+		return;		// already moved up this frame
+
+	c->lastframe = r_framecount;
+	D_SCUnlinkLRU (c);
+	D_SCLinkLRU (c);
+}
+
+
+/*
+================
+D_SCFree
+
+Throws out a block in use and merges it with any free neighbours
+================
+*/
+static void D_SCFree (surfcache_t *c)
+{
+	surfcache_t	*n;
+
+	if (c->owner)
+		*c->owner = NULL;
+	D_SCUnlinkLRU (c);
+
+	n = c->next;
+	if (n && n->bucket >= 0)
+	{
+		D_SCUnlinkFree (n);
+		c->size += n->size;
+		c->next = n->next;
+		if (c->next)
+			c->next->prev = c;
+	}
+
+	n = c->prev;
+	if (n && n->bucket >= 0)
+	{
+		D_SCUnlinkFree (n);
+		n->size += c->size;
+		n->next = c->next;
+		if (n->next)
+			n->next->prev = n;
+		c = n;
+	}
+
+	D_SCLinkFree (c);
+}
+
+
+/*
+================
+D_SCFindFree
+
+Returns the smallest free block in the first bucket that can hold size bytes
+================
+*/
+static surfcache_t *D_SCFindFree (int size)
+{
+	int			b;
+	surfcache_t	*c, *best;
+
+	b = D_log2 (size);
+	if (b >= NUM_SC_BUCKETS)
+		b = NUM_SC_BUCKETS - 1;
+
+// the first bucket has blocks on both sides of size
+	best = NULL;
+	for (c = sc_buckets[b] ; c ; c = c->lrunext)
+	{
+		if (c->size >= size && (!best || c->size < best->size))
+			best = c;
+	}
+	if (best)
+		return best;
+
+// anything in the later ones is big enough
+	for (b++ ; b<NUM_SC_BUCKETS ; b++)
+	{
+		if (sc_buckets[b])
+			return sc_buckets[b];
+	}
+
+	return NULL;
+}
+
+
 /*
 ================
 D_InitCaches
@@ -88,12 +284,11 @@ void D_InitCaches (void *buffer, int size)
 
 	sc_size = size - GUARDSIZE;
 	sc_base = (surfcache_t *)buffer;
-	sc_rover = sc_base;
-	
-	sc_base->next = NULL;
-	sc_base->owner = NULL;
-	sc_base->size = sc_size;
-	
+
+	// anything left on the list lived in the old buffer
+	sc_lru.lrunext = sc_lru.lruprev = &sc_lru;
+	D_FlushCaches ();
+
 	D_ClearCacheGuard ();
 }
 
@@ -110,27 +305,36 @@ void D_FlushCaches (void)
 	if (!sc_base)
 		return;
 
-	for (c = sc_base ; c ; c = c->next)
+	R_FlushPrebuild ();
+
+	for (c = sc_lru.lrunext ; c != &sc_lru ; c = c->lrunext)
 	{
 		if (c->owner)
 			*c->owner = NULL;
 	}
+
+	sc_lru.lrunext = sc_lru.lruprev = &sc_lru;
+	memset (sc_buckets, 0, sizeof(sc_buckets));
 	
-	sc_rover = sc_base;
 	sc_base->next = NULL;
-	sc_base->owner = NULL;
+	sc_base->prev = NULL;
 	sc_base->size = sc_size;
+	D_SCLinkFree (sc_base);
+
+	memset (&sc_total, 0, sizeof(sc_total));
+	sc_numframes = 0;
 }
 
 /*
 =================
-D_SCAlloc
+D_SCAllocBlock
+
+Returns NULL if it would have to throw out a surface drawn on or after keepframe
 =================
 */
-surfcache_t     *D_SCAlloc (int width, int size)
+static surfcache_t     *D_SCAllocBlock (int width, int size, int keepframe)
 {
-	surfcache_t             *new;
-	qboolean                wrapped_this_time;
+	surfcache_t             *new, *frag;
 
 	if ((width < 0) || (width > 256))
 		Sys_Error ("D_SCAlloc: bad cache width %d\n", width);
@@ -143,49 +347,40 @@ surfcache_t     *D_SCAlloc (int width, int size)
 	if (size > sc_size)
 		Sys_Error ("D_SCAlloc: %i > cache size",size);
 
-// if there is not size bytes after the rover, reset to the start
-	wrapped_this_time = false;
-
-	if ( !sc_rover || (byte *)sc_rover - (byte *)sc_base > sc_size - size)
+// throw out the least recently used surfaces until something is big enough
+	while ( !(new = D_SCFindFree (size)) )
 	{
-		if (sc_rover)
+		new = sc_lru.lrunext;
+		if (new == &sc_lru)
+			Sys_Error ("D_SCAlloc: hit the end of memory");
+		if (new->lastframe >= keepframe)
+			return NULL;
+
+		if (new->lastframe == r_framecount)
 		{
-			wrapped_this_time = true;
+			r_cache_thrash = true;
+			sc_frame.evictedframe++;
 		}
-		sc_rover = sc_base;
-	}
-		
-// colect and free surfcache_t blocks until the rover block is large enough
-	new = sc_rover;
-	if (sc_rover->owner)
-		*sc_rover->owner = NULL;
-	
-	while (new->size < size)
-	{
-	// free another
-		sc_rover = sc_rover->next;
-		if (!sc_rover)
-			Sys_Error ("D_SCAlloc: hit the end of memory");
-		if (sc_rover->owner)
-			*sc_rover->owner = NULL;
-			
-		new->size += sc_rover->size;
-		new->next = sc_rover->next;
+		sc_frame.evictions++;
+
+		D_SCFree (new);
 	}
 
+	D_SCUnlinkFree (new);
+
 // create a fragment out of any leftovers
-	if (new->size - size > 256)
+	if (new->size - size > MINFRAGMENT)
 	{
-		sc_rover = (surfcache_t *)( (byte *)new + size);
-		sc_rover->size = new->size - size;
-		sc_rover->next = new->next;
-		sc_rover->width = 0;
-		sc_rover->owner = NULL;
-		new->next = sc_rover;
+		frag = (surfcache_t *)( (byte *)new + size);
+		frag->size = new->size - size;
+		frag->next = new->next;
+		frag->prev = new;
+		if (frag->next)
+			frag->next->prev = frag;
+		new->next = frag;
 		new->size = size;
+		D_SCLinkFree (frag);
 	}
-	else
-		sc_rover = new->next;
 	
 	new->width = width;
 // DEBUG
@@ -194,21 +389,26 @@ surfcache_t     *D_SCAlloc (int width, int size)
 
 	new->owner = NULL;              // should be set properly after return
 
-	if (d_roverwrapped)
-	{
-		if (wrapped_this_time || (sc_rover >= d_initial_rover))
-			r_cache_thrash = true;
-	}
-	else if (wrapped_this_time)
-	{       
-		d_roverwrapped = true;
-	}
+	new->lastframe = r_framecount;
+	new->prebuilt = 0;
+	D_SCLinkLRU (new);
 
 D_CheckCacheGuard ();   // DEBUG
 	return new;
 }
 
 
+/*
+=================
+D_SCAlloc
+=================
+*/
+surfcache_t     *D_SCAlloc (int width, int size)
+{
+	return D_SCAllocBlock (width, size, 0x7fffffff);
+}
+
+
 /*
 =================
 D_SCDump
@@ -220,12 +420,100 @@ void D_SCDump (void)
 
 	for (test = sc_base ; test ; test = test->next)
 	{
-		if (test == sc_rover)
-			Sys_Printf ("ROVER:\n");
+		if (test->bucket >= 0)
+			Sys_Printf ("FREE:\n");
 		printf ("%p : %i bytes     %i width\n",test, test->size, test->width);
 	}
 }
 
+
+/*
+=================
+D_SCBeginFrame
+
+Called from D_SetupFrame
+=================
+*/
+void D_SCBeginFrame (void)
+{
+	int		i;
+	double	*in, *out;
+
+	if (sc_frame.hits || sc_frame.misses)
+	{
+		sc_lastframe = sc_frame;
+
+		in = (double *)&sc_frame;
+		out = (double *)&sc_total;
+		for (i=0 ; i<sizeof(scstats_t)/sizeof(double) ; i++)
+			out[i] += in[i];
+		sc_numframes++;
+	}
+
+	memset (&sc_frame, 0, sizeof(sc_frame));
+}
+
+
+/*
+=================
+D_SCPrintStats
+=================
+*/
+static void D_SCPrintStats (char *name, scstats_t *st, int frames)
+{
+	if (frames < 1)
+		frames = 1;
+
+	Con_Printf ("%s: %.0f hits, %.0f misses, %.0fk built\n", name,
+			st->hits / frames, st->misses / frames, st->bytesbuilt / frames / 1024);
+	Con_Printf ("  %.0f new, %.0f light, %.0f dlight, %.0f anim\n",
+			st->newsurfs / frames, st->lightchanges / frames,
+			st->dlights / frames, st->animations / frames);
+	Con_Printf ("  %.0f evicted, %.0f still in use\n",
+			st->evictions / frames, st->evictedframe / frames);
+	Con_Printf ("  %.0f built ahead, %.0f of those drawn\n",
+			st->prebuilt / frames, st->prebuilthits / frames);
+}
+
+
+/*
+=================
+D_SCStats_f
+
+Prints what the surface cache is up to
+=================
+*/
+void D_SCStats_f (void)
+{
+	surfcache_t	*c;
+	int			used, count, largest, freebytes;
+
+	if (!sc_base)
+		return;
+
+	used = count = largest = freebytes = 0;
+	for (c = sc_base ; c ; c = c->next)
+	{
+		if (c->bucket >= 0)
+		{
+			freebytes += c->size;
+			if (c->size > largest)
+				largest = c->size;
+		}
+		else
+		{
+			used += c->size;
+			count++;
+		}
+	}
+
+	Con_Printf ("%ik surface cache, %ik in %i surfaces, %ik free, largest %ik\n",
+			sc_size / 1024, used / 1024, count, freebytes / 1024, largest / 1024);
+	D_SCPrintStats ("last frame", &sc_lastframe, 1);
+	D_SCPrintStats ("average", &sc_total, sc_numframes);
+	Con_Printf ("%i frames since the last flush\n", sc_numframes);
+}
+
 //=============================================================================
 
 // if the num is not a power of 2, assume it will not repeat
@@ -264,6 +552,7 @@ D_CacheSurface
 surfcache_t *D_CacheSurface (msurface_t *surface, int miplevel)
 {
 	surfcache_t     *cache;
+	qboolean		dlit;
 
 //
 // if the surface is animating or flashing, flush the cache
@@ -273,19 +562,41 @@ surfcache_t *D_CacheSurface (msurface_t *surface, int miplevel)
 	r_drawsurf.lightadj[1] = d_lightstylevalue[surface->styles[1]];
 	r_drawsurf.lightadj[2] = d_lightstylevalue[surface->styles[2]];
 	r_drawsurf.lightadj[3] = d_lightstylevalue[surface->styles[3]];
+
+// softquake -- only count dynamic lights that reach the lightmap
+	dlit = R_SurfaceDlit (surface);
 	
 //
 // see if the cache holds apropriate data
 //
 	cache = surface->cachespots[miplevel];
 
-	if (cache && !cache->dlight && surface->dlightframe != r_framecount
+	if (cache && !cache->dlight && !dlit
 			&& cache->texture == r_drawsurf.texture
 			&& cache->lightadj[0] == r_drawsurf.lightadj[0]
 			&& cache->lightadj[1] == r_drawsurf.lightadj[1]
 			&& cache->lightadj[2] == r_drawsurf.lightadj[2]
 			&& cache->lightadj[3] == r_drawsurf.lightadj[3] )
+	{
+		sc_frame.hits++;
+		if (cache->prebuilt)
+		{
+			sc_frame.prebuilthits++;
+			cache->prebuilt = 0;
+		}
+		D_SCTouch (cache);
 		return cache;
+	}
+
+	sc_frame.misses++;
+	if (!cache)
+		sc_frame.newsurfs++;
+	else if (cache->dlight || dlit)
+		sc_frame.dlights++;
+	else if (cache->texture != r_drawsurf.texture)
+		sc_frame.animations++;
+	else
+		sc_frame.lightchanges++;
 
 //
 // determine shape of surface
@@ -307,8 +618,11 @@ surfcache_t *D_CacheSurface (msurface_t *surface, int miplevel)
 		cache->owner = &surface->cachespots[miplevel];
 		cache->mipscale = surfscale;
 	}
+	else
+		D_SCTouch (cache);
+	cache->prebuilt = 0;
 	
-	if (surface->dlightframe == r_framecount)
+	if (dlit)
 		cache->dlight = 1;
 	else
 		cache->dlight = 0;
@@ -327,9 +641,78 @@ surfcache_t *D_CacheSurface (msurface_t *surface, int miplevel)
 	r_drawsurf.surf = surface;
 
 	c_surf++;
+	sc_frame.bytesbuilt += r_drawsurf.surfwidth * r_drawsurf.surfheight;
 	R_DrawSurface ();
 
 	return surface->cachespots[miplevel];
 }
 
 
+/*
+================
+D_PrebuildSurface
+
+softquake -- The main thread half of building a surface ahead of time, for
+r_prebuild.c. Claims a cache block and fills in ds, without throwing out
+anything drawn in the last couple of frames.
+Returns false if the surface is already cached or there's no room.
+D_BuildSurface does the rest, on any thread.
+================
+*/
+qboolean D_PrebuildSurface (msurface_t *surface, int miplevel, drawsurf_t *ds)
+{
+	surfcache_t     *cache;
+
+	if (surface->cachespots[miplevel])
+		return false;
+
+	ds->texture = R_TextureAnimation (surface->texinfo->texture);
+	ds->lightadj[0] = d_lightstylevalue[surface->styles[0]];
+	ds->lightadj[1] = d_lightstylevalue[surface->styles[1]];
+	ds->lightadj[2] = d_lightstylevalue[surface->styles[2]];
+	ds->lightadj[3] = d_lightstylevalue[surface->styles[3]];
+
+	ds->surfmip = miplevel;
+	ds->surfwidth = surface->extents[0] >> miplevel;
+	ds->rowbytes = ds->surfwidth;
+	ds->surfheight = surface->extents[1] >> miplevel;
+	ds->surf = surface;
+
+	cache = D_SCAllocBlock (ds->surfwidth, ds->surfwidth * ds->surfheight,
+			r_framecount - 1);
+	if (!cache)
+		return false;
+
+	surface->cachespots[miplevel] = cache;
+	cache->owner = &surface->cachespots[miplevel];
+	cache->mipscale = 1.0 / (1<<miplevel);
+	cache->dlight = 0;
+	cache->prebuilt = 1;
+
+	cache->texture = ds->texture;
+	cache->lightadj[0] = ds->lightadj[0];
+	cache->lightadj[1] = ds->lightadj[1];
+	cache->lightadj[2] = ds->lightadj[2];
+	cache->lightadj[3] = ds->lightadj[3];
+
+	ds->surfdat = (pixel_t *)cache->data;
+
+	sc_frame.prebuilt++;
+	sc_frame.bytesbuilt += ds->surfwidth * ds->surfheight;
+
+	return true;
+}
+
+
+/*
+================
+D_BuildSurface
+
+Draws and lights a surface set up by D_PrebuildSurface
+================
+*/
+void D_BuildSurface (drawsurf_t *ds)
+{
+	r_drawsurf = *ds;
+	R_DrawSurface ();
+}
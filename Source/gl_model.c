@@ -229,28 +229,42 @@ void Mod_TouchModel (char *name)
 
 /*
 ==================
-Mod_LoadModel
+Mod_IsLoaded
 
-Loads a model into the cache
+softquake -- Taken out of Mod_LoadModel
 ==================
 */
-model_t *Mod_LoadModel (model_t *mod, qboolean crash)
+static qboolean Mod_IsLoaded (model_t *mod)
 {
-	void	*d;
-	unsigned *buf;
-	byte	stackbuf[1024];		// avoid dirtying the cache heap
-
 	if (!mod->needload)
 	{
 		if (mod->type == mod_alias)
 		{
-			d = Cache_Check (&mod->cache);
-			if (d)
-				return mod;
+			if (Cache_Check (&mod->cache))
+				return true;
 		}
 		else
-			return mod;		// not cached at all
+			return true;		// not cached at all
 	}
+	return false;
+}
+
+static void Mod_LoadModelData (model_t *mod, unsigned *buf);
+
+/*
+==================
+Mod_LoadModel
+
+Loads a model into the cache
+==================
+*/
+model_t *Mod_LoadModel (model_t *mod, qboolean crash)
+{
+	unsigned *buf;
+	byte	stackbuf[1024];		// avoid dirtying the cache heap
+
+	if (Mod_IsLoaded (mod))	// softquake
+		return mod;
 
 //
 // because the world is so huge, load it one piece at a time
@@ -263,14 +277,27 @@ model_t *Mod_LoadModel (model_t *mod, qboolean crash)
 //
 // load the file
 //
-	buf = (unsigned *)COM_LoadStackFile (mod->name, stackbuf, sizeof(stackbuf));
+	buf = (unsigned *)COM_LoadMappedFile (mod->name, stackbuf, sizeof(stackbuf));	// softquake
 	if (!buf)
 	{
 		if (crash)
 			Sys_Error ("Mod_NumForName: %s not found", mod->name);
 		return NULL;
 	}
-	
+
+	Mod_LoadModelData (mod, buf);	// softquake
+	return mod;
+}
+
+/*
+==================
+Mod_LoadModelData
+
+softquake -- The part of Mod_LoadModel after the file has been read
+==================
+*/
+static void Mod_LoadModelData (model_t *mod, unsigned *buf)
+{
 //
 // allocate a new model
 //
@@ -299,8 +326,6 @@ model_t *Mod_LoadModel (model_t *mod, qboolean crash)
 		Mod_LoadBrushModel (mod, buf);
 		break;
 	}
-
-	return mod;
 }
 
 /*
@@ -319,6 +344,35 @@ model_t *Mod_ForName (char *name, qboolean crash)
 	return Mod_LoadModel (mod, crash);
 }
 
+/*
+==================
+Mod_NeedsLoad
+
+softquake -- True if Mod_ForName would have to read the file
+==================
+*/
+qboolean Mod_NeedsLoad (char *name)
+{
+	return !Mod_IsLoaded (Mod_FindName (name));
+}
+
+/*
+==================
+Mod_ForNameData
+
+softquake -- Mod_ForName, for a file that has already been read into data
+==================
+*/
+model_t *Mod_ForNameData (char *name, void *data)
+{
+	model_t	*mod;
+
+	mod = Mod_FindName (name);
+	if (!Mod_IsLoaded (mod))
+		Mod_LoadModelData (mod, data);
+	return mod;
+}
+
 
 /*
 ===============================================================================
@@ -1433,16 +1487,29 @@ void *Mod_LoadAllSkins (int numskins, daliasskintype_t *pskintype)
 
 	s = pheader->skinwidth * pheader->skinheight;
 
+	// softquake -- the file can be straight out of a mapped pak, which mustn't
+	// be written to, so the flood fill is done in a copy. skin never moves on,
+	// so only the first skin was ever filled, and still is.
+	copy = NULL;
+	if (pskintype->type == ALIAS_SKIN_SINGLE)
+	{
+		copy = malloc (s);
+		if (!copy)
+			Sys_Error ("Mod_LoadAllSkins: couldn't allocate %i bytes", s);
+		memcpy (copy, skin, s);
+		Mod_FloodFillSkin( copy, pheader->skinwidth, pheader->skinheight );
+	}
+
 	for (i=0 ; i<numskins ; i++)
 	{
 		if (pskintype->type == ALIAS_SKIN_SINGLE) {
-			Mod_FloodFillSkin( skin, pheader->skinwidth, pheader->skinheight );
+			skin = i ? (byte *)(pskintype + 1) : copy;	// softquake
 
 			// save 8 bit texels for the player model to remap
 	//		if (!strcmp(loadmodel->name,"progs/player.mdl")) {
 				texels = Hunk_AllocName(s, loadname);
 				pheader->texels[i] = texels - (byte *)pheader;
-				memcpy (texels, (byte *)(pskintype + 1), s);
+				memcpy (texels, skin, s);	// softquake
 	//		}
 			q_snprintf (name, sizeof(name), "%s_%i", loadmodel->name, i);
 			pheader->gl_texturenum[i][0] =
@@ -1450,7 +1517,7 @@ void *Mod_LoadAllSkins (int numskins, daliasskintype_t *pskintype)
 			pheader->gl_texturenum[i][2] =
 			pheader->gl_texturenum[i][3] =
 				GL_LoadTexture (name, pheader->skinwidth, 
-				pheader->skinheight, (byte *)(pskintype + 1), true, false, TEX_USAGE_MODEL, TEX_PREF_FILTER_FORCE_NONE);
+				pheader->skinheight, skin, true, false, TEX_USAGE_MODEL, TEX_PREF_FILTER_FORCE_NONE);	// softquake
 			pskintype = (daliasskintype_t *)((byte *)(pskintype+1) + s);
 		} else {
 			// animating skin group.  yuck.
@@ -1463,7 +1530,6 @@ void *Mod_LoadAllSkins (int numskins, daliasskintype_t *pskintype)
 
 			for (j=0 ; j<groupskins ; j++)
 			{
-					Mod_FloodFillSkin( skin, pheader->skinwidth, pheader->skinheight );
 					if (j == 0) {
 						texels = Hunk_AllocName(s, loadname);
 						pheader->texels[i] = texels - (byte *)pheader;
@@ -1482,6 +1548,7 @@ void *Mod_LoadAllSkins (int numskins, daliasskintype_t *pskintype)
 		}
 	}
 
+	free (copy);	// softquake
 	return (void *)pskintype;
 }
 
@@ -564,22 +564,33 @@ Host_ServerFrame
 
 void _Host_ServerFrame (void)
 {
+	double	prof;	// softquake
+
 // run the world state	
 	pr_global_struct->frametime = host_frametime;
 
 // read client messages
+	prof = SV_ProfileTime ();	// softquake
 	SV_RunClients ();
+	SV_ProfileAdd (prof_runclients, prof);	// softquake
 	
 // move things around and think
 // always pause in single player if in console or menus
 	if (!sv.paused && (svs.maxclients > 1 || key_dest == key_game) )
+	{
+		prof = SV_ProfileTime ();	// softquake
 		SV_Physics ();
+		SV_ProfileAdd (prof_physics, prof);	// softquake
+	}
 }
 
 void Host_ServerFrame (void)
 {
 	float	save_host_frametime;
 	float	temp_host_frametime;
+	double	prof;	// softquake
+
+	SV_ProfileStartTick ();	// softquake
 
 // run the world state	
 	pr_global_struct->frametime = host_frametime;
@@ -603,13 +614,21 @@ void Host_ServerFrame (void)
 	host_frametime = save_host_frametime;
 
 // send all messages to the clients
+	prof = SV_ProfileTime ();	// softquake
 	SV_SendClientMessages ();
+	SV_ProfileAdd (prof_send, prof);	// softquake
+
+	SV_ProfileEndTick ();	// softquake
 }
 
 #else
 
 void Host_ServerFrame (void)
 {
+	double	prof;	// softquake
+
+	SV_ProfileStartTick ();	// softquake
+
 // run the world state	
 	pr_global_struct->frametime = host_frametime;
 
@@ -620,15 +639,25 @@ void Host_ServerFrame (void)
 	SV_CheckForNewClients ();
 
 // read client messages
+	prof = SV_ProfileTime ();	// softquake
 	SV_RunClients ();
+	SV_ProfileAdd (prof_runclients, prof);	// softquake
 	
 // move things around and think
 // always pause in single player if in console or menus
 	if (!sv.paused && (svs.maxclients > 1 || key_dest == key_game) )
+	{
+		prof = SV_ProfileTime ();	// softquake
 		SV_Physics ();
+		SV_ProfileAdd (prof_physics, prof);	// softquake
+	}
 
 // send all messages to the clients
+	prof = SV_ProfileTime ();	// softquake
 	SV_SendClientMessages ();
+	SV_ProfileAdd (prof_send, prof);	// softquake
+
+	SV_ProfileEndTick ();	// softquake
 }
 
 #endif
@@ -879,6 +908,9 @@ void Host_Init (quakeparms_t *parms)
 	NET_Init ();
 	SV_Init ();
 
+	// softquake -- Worker threads for the renderer and friends
+	Jobs_Init ();
+
 	Con_Printf ("Exe: "__TIME__" "__DATE__"\n");
 	Con_Printf ("%4.1f megabyte heap\n",parms->memsize/ (1024*1024.0));
 	
@@ -980,5 +1012,8 @@ void Host_Shutdown(void)
 	{
 		VID_Shutdown();
 	}
+
+	// softquake -- Stop the worker threads
+	Jobs_Shutdown ();
 }
 
@@ -37,3 +37,7 @@ void IN_Move (usercmd_t *cmd)
 {
 }
 
+// softquake -- in_sdl.c has this, not the sys file
+void Sys_SendKeyEvents (void)
+{
+}
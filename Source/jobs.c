@@ -0,0 +1,288 @@
+/*
+Copyright (C) 2023-2023 softquake
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+// jobs.c -- worker thread pool
+
+// A handful of threads that sit idle until someone hands them a batch of
+// indices to chew through. The thread that queued the batch pitches in as well
+// while it waits, so a pool of 1 simply runs everything on the calling thread.
+
+// Quake itself is not thread safe in the slightest.
+// Anything handed to the pool has to be written with that in mind.
+
+#include <SDL2/SDL.h>
+
+#include "quakedef.h"
+
+static SDL_Thread	*job_threads[MAX_JOB_THREADS];
+static int			job_numthreads = 1;	// workers + main thread
+
+static SDL_mutex	*job_lock;
+static SDL_cond		*job_wake;		// signaled when a batch is queued
+static SDL_cond		*job_finished;	// signaled when a batch completes
+static jobbatch_t	*job_queue;
+static qboolean		job_quit;
+
+/*
+================
+Jobs_Take
+
+Hands out the next index of a batch
+Must be called with job_lock held
+================
+*/
+static int Jobs_Take (jobbatch_t *batch)
+{
+	jobbatch_t	**link;
+	int			index;
+
+	index = batch->next++;
+
+	if (batch->next >= batch->count)
+	{
+	// nothing left to hand out, so take it off the queue
+		for (link = &job_queue ; *link ; link = &(*link)->nextbatch)
+		{
+			if (*link == batch)
+			{
+				*link = batch->nextbatch;
+				break;
+			}
+		}
+		batch->nextbatch = NULL;
+	}
+
+	return index;
+}
+
+/*
+================
+Jobs_Execute
+
+Runs a single index, then marks it as done
+Must be called with job_lock held, which is released while the job runs
+================
+*/
+static void Jobs_Execute (jobbatch_t *batch, int index)
+{
+	SDL_UnlockMutex (job_lock);
+	batch->func (batch->data, index);
+	SDL_LockMutex (job_lock);
+
+	if (++batch->done == batch->count)
+		SDL_CondBroadcast (job_finished);
+}
+
+static int Jobs_Worker (void *unused)
+{
+	jobbatch_t	*batch;
+
+	SDL_LockMutex (job_lock);
+	while (!job_quit)
+	{
+		batch = job_queue;
+		if (!batch)
+		{
+			SDL_CondWait (job_wake, job_lock);
+			continue;
+		}
+
+		Jobs_Execute (batch, Jobs_Take (batch));
+	}
+	SDL_UnlockMutex (job_lock);
+
+	return 0;
+}
+
+/*
+================
+Jobs_Init
+================
+*/
+void Jobs_Init (void)
+{
+	int		i;
+	int		count;
+
+	count = SDL_GetCPUCount ();
+
+	i = COM_CheckParm ("-threads");
+	if (i && i < com_argc - 1)
+		count = Q_atoi (com_argv[i+1]);
+
+	if (count > MAX_JOB_THREADS)
+		count = MAX_JOB_THREADS;
+	if (count < 1)
+		count = 1;
+
+	job_lock = SDL_CreateMutex ();
+	job_wake = SDL_CreateCond ();
+	job_finished = SDL_CreateCond ();
+	if (!job_lock || !job_wake || !job_finished)
+		Sys_Error ("Jobs_Init: %s", SDL_GetError ());
+
+	job_quit = false;
+	job_numthreads = 1;
+
+	for (i=1 ; i<count ; i++)
+	{
+		job_threads[i] = SDL_CreateThread (Jobs_Worker, "quake_job", NULL);
+		if (!job_threads[i])
+		{
+			Con_Printf ("Jobs_Init: %s\n", SDL_GetError ());
+			break;
+		}
+		job_numthreads++;
+	}
+
+	Con_Printf ("%i worker threads\n", job_numthreads);
+}
+
+/*
+================
+Jobs_Shutdown
+================
+*/
+void Jobs_Shutdown (void)
+{
+	int		i;
+
+	if (!job_lock)
+		return;
+
+	SDL_LockMutex (job_lock);
+	job_quit = true;
+	SDL_CondBroadcast (job_wake);
+	SDL_UnlockMutex (job_lock);
+
+	for (i=1 ; i<job_numthreads ; i++)
+	{
+		SDL_WaitThread (job_threads[i], NULL);
+		job_threads[i] = NULL;
+	}
+	job_numthreads = 1;
+
+	SDL_DestroyCond (job_finished);
+	SDL_DestroyCond (job_wake);
+	SDL_DestroyMutex (job_lock);
+	job_finished = NULL;
+	job_wake = NULL;
+	job_lock = NULL;
+}
+
+int Jobs_NumThreads (void)
+{
+	return job_numthreads;
+}
+
+/*
+================
+Jobs_Begin
+================
+*/
+void Jobs_Begin (jobbatch_t *batch, jobfunc_t func, void *data, int count)
+{
+	jobbatch_t	**link;
+
+	batch->func = func;
+	batch->data = data;
+	batch->count = count;
+	batch->next = 0;
+	batch->done = 0;
+	batch->nextbatch = NULL;
+
+	if (count <= 0 || !job_lock)
+		return;
+
+	SDL_LockMutex (job_lock);
+
+// first come, first served
+	for (link = &job_queue ; *link ; link = &(*link)->nextbatch)
+		;
+	*link = batch;
+
+	SDL_CondBroadcast (job_wake);
+	SDL_UnlockMutex (job_lock);
+}
+
+/*
+================
+Jobs_Wait
+================
+*/
+void Jobs_Wait (jobbatch_t *batch)
+{
+	if (batch->count <= 0)
+		return;
+
+	if (!job_lock)
+	{
+	// no pool yet, just do it here
+		while (batch->next < batch->count)
+			batch->func (batch->data, batch->next++);
+		batch->done = batch->count;
+		return;
+	}
+
+	SDL_LockMutex (job_lock);
+
+	while (batch->next < batch->count)
+		Jobs_Execute (batch, Jobs_Take (batch));
+
+	while (batch->done < batch->count)
+		SDL_CondWait (job_finished, job_lock);
+
+	SDL_UnlockMutex (job_lock);
+}
+
+/*
+================
+Jobs_Done
+================
+*/
+qboolean Jobs_Done (jobbatch_t *batch)
+{
+	qboolean	done;
+
+	if (batch->count <= 0)
+		return true;
+
+	if (!job_lock)
+		return batch->done >= batch->count;
+
+	SDL_LockMutex (job_lock);
+	done = batch->done >= batch->count;
+	SDL_UnlockMutex (job_lock);
+
+	return done;
+}
+
+/*
+================
+Jobs_Run
+================
+*/
+void Jobs_Run (jobfunc_t func, void *data, int count)
+{
+	jobbatch_t	batch;
+
+	Jobs_Begin (&batch, func, data, count);
+	Jobs_Wait (&batch);
+}
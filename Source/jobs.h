@@ -0,0 +1,62 @@
+/*
+Copyright (C) 2023-2023 softquake
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#ifndef _JOBS_H_
+#define _JOBS_H_
+
+// jobs.h -- worker thread pool
+
+#define MAX_JOB_THREADS	16	// including the main thread
+
+// Called once for every index in [0, count)
+// Runs on any thread, so it must only touch memory owned by that index
+// or memory nobody else is writing to
+typedef void (*jobfunc_t) (void *data, int index);
+
+typedef struct jobbatch_s
+{
+	jobfunc_t			func;
+	void				*data;
+	int					count;
+	int					next;		// next index to hand out
+	int					done;		// indices finished
+	struct jobbatch_s	*nextbatch;	// queue of batches with indices left
+} jobbatch_t;
+
+void Jobs_Init (void);
+void Jobs_Shutdown (void);
+
+int Jobs_NumThreads (void);
+// Number of threads that can run jobs at the same time, including the caller
+
+void Jobs_Begin (jobbatch_t *batch, jobfunc_t func, void *data, int count);
+// Queues up a batch and returns immediately
+// The batch must stay in memory until Jobs_Wait returns
+
+void Jobs_Wait (jobbatch_t *batch);
+// Helps out with the batch, then blocks until every index has finished
+
+qboolean Jobs_Done (jobbatch_t *batch);
+// Returns true once every index in the batch has finished
+
+void Jobs_Run (jobfunc_t func, void *data, int count);
+// Jobs_Begin followed by Jobs_Wait
+
+#endif /* _JOBS_H_ */
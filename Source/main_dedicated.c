@@ -0,0 +1,141 @@
+/*
+Copyright (C) 2023-2023 softquake
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+// main_dedicated.c -- main loop of the dedicated server build
+
+// Built with the null video, sound, input and cd drivers instead of the SDL
+// ones, so no window or audio device is ever opened. Instead of waking up
+// every millisecond to see if it's time for the next server frame, it sleeps
+// until exactly when the next sys_ticrate boundary comes around.
+
+#include "quakedef.h"
+
+#include <time.h>
+#include <errno.h>
+
+// From sys_* files
+extern char *basedir;
+extern qboolean isDedicated;
+void Sys_Init(void);
+
+static char	*dedicated_argv[MAX_NUM_ARGVS];
+
+/*
+================
+Main_Time
+
+Seconds from the monotonic clock, which SDL_GetTicks is too coarse to sleep by
+================
+*/
+static double Main_Time (void)
+{
+	struct timespec	ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+================
+Main_SleepUntil
+================
+*/
+static void Main_SleepUntil (double time)
+{
+	struct timespec	ts;
+
+	ts.tv_sec = (time_t)time;
+	ts.tv_nsec = (long)((time - ts.tv_sec) * 1e9);
+	if (ts.tv_nsec >= 1000000000)
+	{
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000;
+	}
+
+	while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+		;
+}
+
+int main(int argc, char **argv)
+{
+	double		next, now;
+	quakeparms_t parms;
+	extern int vcrFile;
+	extern int recording;
+	int mem_argc;
+	int i;
+
+	memset(&parms, 0, sizeof(parms));
+
+	// This build can't be anything but a dedicated server
+	for (i=1 ; i<argc ; i++)
+		if (!strcmp(argv[i], "-dedicated"))
+			break;
+	if (i == argc && argc < MAX_NUM_ARGVS)
+	{
+		for (i=0 ; i<argc ; i++)
+			dedicated_argv[i] = argv[i];
+		dedicated_argv[argc++] = "-dedicated";
+		argv = dedicated_argv;
+	}
+	isDedicated = true;
+
+	COM_InitArgv(argc, argv);
+	parms.argc = com_argc;
+	parms.argv = com_argv;
+
+	parms.memsize = 8*1024*1024;
+	mem_argc = COM_CheckParm("-mem");
+	if(mem_argc)
+	{
+		parms.memsize = (int) (Q_atof(com_argv[mem_argc+1]) * 1024 * 1024);
+	}
+	parms.membase = malloc (parms.memsize);
+	parms.basedir = basedir;
+
+	if (COM_CheckParm("-nostdout"))
+	{
+	   fclose(stdout);
+	   sys_stdout = 0;
+	}
+
+	Con_Printf ("SoftQuake dedicated server -- Version %s\n", SOFTQUAKE_VERSION);
+
+	Host_Init(&parms);
+
+	Sys_Init();
+
+	next = Main_Time ();
+	for (;;)
+	{
+		// play vcrfiles at max speed
+		if (vcrFile == -1 || recording)
+			Main_SleepUntil (next);
+
+		Host_Frame (sys_ticrate.value);
+
+		// if a frame took so long the next one is already late,
+		// start counting again from now instead of trying to catch up
+		next += sys_ticrate.value;
+		now = Main_Time ();
+		if (now > next + sys_ticrate.value)
+			next = now;
+	}
+}
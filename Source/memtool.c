@@ -0,0 +1,326 @@
+// Reads the log the engine writes with -memtrace
+// See Makefile.memtool and memtrace.h
+//
+// Usage: memtool [-t] <memtrace.log>
+//
+// Prints the most hunk and cache memory that was ever in use and when, and
+// what -mem would have been enough, then the allocations added up by name and
+// by the place they were made from. With -t every event is printed first, in
+// order, as a timeline.
+//
+// Places are printed as an offset from Memory_Init. To find the line, add it
+// to the address 'nm' gives for Memory_Init in the same executable, and give
+// that to addr2line.
+// Read the log on the same kind of machine that wrote it.
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "memtrace.h"
+
+
+typedef struct
+{
+	char		name[16];
+	int			kind;			// hunk, high, temp or cache
+	int			count;
+	long long	bytes;
+	int			evicted;
+	int			gone;			// evicted bytes not loaded back yet
+} nametotal_t;
+
+typedef struct
+{
+	int			site;
+	int			count;
+	long long	bytes;
+} sitetotal_t;
+
+typedef struct
+{
+	int			value;
+	double		time;
+	char		name[16];
+} peak_t;
+
+enum {kind_hunk, kind_high, kind_temp, kind_cache, kind_none};
+
+static const char *kindnames[] = {"hunk", "high", "temp", "cache", ""};
+
+static const char *eventnames[mt_numevents] =
+{
+	"alloc", "highalloc", "tempalloc", "lowmark", "highmark", "cachealloc", "cachefree", "evict"
+};
+
+static nametotal_t	*names;
+static int			numnames, maxnames;
+
+static sitetotal_t	*sites;
+static int			numsites, maxsites;
+
+
+static void fail(const char *path, const char *msg)
+{
+	fprintf(stderr, "memtool: %s: %s\n", path, msg);
+	exit(1);
+}
+
+static void *grow(void *list, int *max, int size)
+{
+	*max = *max ? *max * 2 : 256;
+	list = realloc(list, *max * size);
+	if (!list)
+		fail("memtool", "out of memory");
+	return list;
+}
+
+static int eventkind(int event)
+{
+	switch (event)
+	{
+	case mt_hunkalloc:
+		return kind_hunk;
+	case mt_highalloc:
+		return kind_high;
+	case mt_tempalloc:
+		return kind_temp;
+	case mt_cachealloc:
+	case mt_cachefree:
+	case mt_cacheevict:
+		return kind_cache;
+	}
+	return kind_none;
+}
+
+static nametotal_t *findname(const char *name, int kind)
+{
+	int		i;
+
+	for (i = 0; i < numnames; i++)
+		if (names[i].kind == kind && !strcmp(names[i].name, name))
+			return &names[i];
+
+	if (numnames == maxnames)
+		names = grow(names, &maxnames, sizeof(*names));
+	memset(&names[numnames], 0, sizeof(names[numnames]));
+	strcpy(names[numnames].name, name);
+	names[numnames].kind = kind;
+	return &names[numnames++];
+}
+
+static sitetotal_t *findsite(int site)
+{
+	int		i;
+
+	for (i = 0; i < numsites; i++)
+		if (sites[i].site == site)
+			return &sites[i];
+
+	if (numsites == maxsites)
+		sites = grow(sites, &maxsites, sizeof(*sites));
+	memset(&sites[numsites], 0, sizeof(sites[numsites]));
+	sites[numsites].site = site;
+	return &sites[numsites++];
+}
+
+static void checkpeak(peak_t *peak, int value, const memtrace_t *rec)
+{
+	if (value <= peak->value)
+		return;
+	peak->value = value;
+	peak->time = rec->time;
+	memcpy(peak->name, rec->name, sizeof(peak->name));
+}
+
+static void printpeak(const char *what, const peak_t *peak)
+{
+	printf("%-18s%10i  %7.2f MB  at %10.6f s  %s\n", what, peak->value,
+		peak->value / (1024.0 * 1024.0), peak->time, peak->name);
+}
+
+static int comparenames(const void *a, const void *b)
+{
+	const nametotal_t	*na = a, *nb = b;
+
+	if (na->bytes != nb->bytes)
+		return na->bytes < nb->bytes ? 1 : -1;
+	return strcmp(na->name, nb->name);
+}
+
+static int comparesites(const void *a, const void *b)
+{
+	const sitetotal_t	*sa = a, *sb = b;
+
+	if (sa->bytes != sb->bytes)
+		return sa->bytes < sb->bytes ? 1 : -1;
+	return sa->site - sb->site;
+}
+
+static const char *sitename(int site)
+{
+	static char	buf[32];
+
+	if (!site)
+		return "zone.c";
+	if (site < 0)
+		snprintf(buf, sizeof(buf), "Memory_Init-%#x", -site);
+	else
+		snprintf(buf, sizeof(buf), "Memory_Init+%#x", site);
+	return buf;
+}
+
+// in tenths of a megabyte, rounded up
+static int megabytes(int bytes)
+{
+	return (int)(((long long)bytes * 10 + 1024*1024 - 1) / (1024*1024));
+}
+
+int main(int argc, char **argv)
+{
+	const char			*path;
+	FILE				*f;
+	memtraceheader_t	header;
+	memtrace_t			rec;
+	nametotal_t			*name;
+	sitetotal_t			*site;
+	peak_t				peaklow, peakhigh, peakhunk, peakcache, peaktotal, peakwanted;
+	int					timeline, kind, cache, wanted, numevents, evictions, i;
+	double				lasttime;
+
+	timeline = 0;
+	path = NULL;
+	for (i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-t"))
+			timeline = 1;
+		else
+			path = argv[i];
+	}
+	if (!path)
+	{
+		fprintf(stderr, "Usage: memtool [-t] <memtrace.log>\n");
+		return 1;
+	}
+
+	f = fopen(path, "rb");
+	if (!f)
+		fail(path, "couldn't open");
+	if (fread(&header, sizeof(header), 1, f) != 1 || header.ident != MEMTRACE_IDENT)
+		fail(path, "not a -memtrace log");
+	if (header.version != MEMTRACE_VERSION)
+		fail(path, "written by a different version of the engine");
+	header.engine[sizeof(header.engine)-1] = 0;
+
+	memset(&peaklow, 0, sizeof(peaklow));
+	memset(&peakhigh, 0, sizeof(peakhigh));
+	memset(&peakhunk, 0, sizeof(peakhunk));
+	memset(&peakcache, 0, sizeof(peakcache));
+	memset(&peaktotal, 0, sizeof(peaktotal));
+	memset(&peakwanted, 0, sizeof(peakwanted));
+	cache = wanted = numevents = evictions = 0;
+	lasttime = 0;
+
+	if (timeline)
+		printf("     time event             size name               low      high     cache  site\n");
+
+	while (fread(&rec, sizeof(rec), 1, f) == 1)
+	{
+		if (rec.event < 0 || rec.event >= mt_numevents)
+			fail(path, "bad event");
+		rec.name[sizeof(rec.name)-1] = 0;
+		numevents++;
+		lasttime = rec.time;
+
+		kind = eventkind(rec.event);
+		name = kind != kind_none ? findname(rec.name, kind) : NULL;
+
+		// wanted is what the cache would hold if nothing had been evicted,
+		// so something thrown out and loaded again only counts once
+		switch (rec.event)
+		{
+		case mt_cachealloc:
+			cache += rec.size;
+			if (name->gone >= rec.size)
+				name->gone -= rec.size;
+			else
+			{
+				wanted += rec.size - name->gone;
+				name->gone = 0;
+			}
+			break;
+		case mt_cacheevict:
+			evictions++;
+			cache -= rec.size;
+			name->evicted++;
+			name->gone += rec.size;
+			break;
+		case mt_cachefree:
+			cache -= rec.size;
+			wanted -= rec.size;
+			break;
+		}
+
+		if (name && rec.event != mt_cachefree && rec.event != mt_cacheevict)
+		{
+			name->count++;
+			name->bytes += rec.size;
+			site = findsite(rec.site);
+			site->count++;
+			site->bytes += rec.size;
+		}
+
+		checkpeak(&peaklow, rec.lowused, &rec);
+		checkpeak(&peakhigh, rec.highused, &rec);
+		checkpeak(&peakhunk, rec.lowused + rec.highused, &rec);
+		checkpeak(&peakcache, cache, &rec);
+		checkpeak(&peaktotal, rec.lowused + rec.highused + cache, &rec);
+		checkpeak(&peakwanted, rec.lowused + rec.highused + wanted, &rec);
+
+		if (timeline)
+		{
+			printf("%10.6f %-11s%10i %-16s%9i %9i %9i  %s\n", rec.time, eventnames[rec.event],
+				rec.size, rec.name, rec.lowused, rec.highused, cache, sitename(rec.site));
+		}
+	}
+	fclose(f);
+
+	if (timeline)
+		printf("\n");
+
+	printf("%s: SoftQuake %s, %i events over %.3f seconds\n", path, header.engine, numevents, lasttime);
+	printf("heap: %i bytes, %.2f MB\n\n", header.hunksize, header.hunksize / (1024.0 * 1024.0));
+
+	printf("peak               bytes                       time\n");
+	printpeak("low hunk", &peaklow);
+	printpeak("high hunk", &peakhigh);
+	printpeak("low + high", &peakhunk);
+	printpeak("cache", &peakcache);
+	printpeak("low + high + cache", &peaktotal);
+	printpeak("without evictions", &peakwanted);
+	printf("%i cache evictions\n\n", evictions);
+
+	i = megabytes(peakhunk.value);
+	printf("-mem %i.%i is the least this could have run in, with things thrown out of the cache as needed\n", i / 10, i % 10);
+	i = megabytes(peakwanted.value);
+	printf("-mem %i.%i would have kept everything in the cache\n\n", i / 10, i % 10);
+
+	qsort(names, numnames, sizeof(*names), comparenames);
+	printf("by name          kind   count      bytes  evicted\n");
+	for (i = 0; i < numnames; i++)
+	{
+		printf("%-16s %-5s%8i%11lli", names[i].name, kindnames[names[i].kind], names[i].count, names[i].bytes);
+		if (names[i].evicted)
+			printf("%9i", names[i].evicted);
+		printf("\n");
+	}
+	printf("\n");
+
+	qsort(sites, numsites, sizeof(*sites), comparesites);
+	printf("by place                count      bytes\n");
+	for (i = 0; i < numsites && i < 40; i++)
+		printf("%-22s%8i%11lli\n", sitename(sites[i].site), sites[i].count, sites[i].bytes);
+
+	return 0;
+}
@@ -0,0 +1,66 @@
+/*
+Copyright (C) 2023-2023 softquake
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+// memtrace.h -- the log of hunk and cache allocations written with -memtrace
+
+// Shared by zone.c, which writes it, and memtool.c, which reads it.
+// A memtraceheader_t, then one memtrace_t per event until the end of the file,
+// in the byte order of the machine that wrote it. The log is started in
+// Memory_Init, before COM_Init has set up the byte swapping functions.
+
+#ifndef _MEMTRACE_H_
+#define _MEMTRACE_H_
+
+#define	MEMTRACE_IDENT		(('R'<<24)+('T'<<16)+('M'<<8)+'Q')
+#define	MEMTRACE_VERSION	2
+
+typedef enum
+{
+	mt_hunkalloc,		// Hunk_AllocName
+	mt_highalloc,		// Hunk_HighAllocName
+	mt_tempalloc,		// Hunk_TempAlloc
+	mt_lowmark,			// Hunk_FreeToLowMark
+	mt_highmark,		// Hunk_FreeToHighMark, also when temp memory is let go
+	mt_cachealloc,		// Cache_Alloc
+	mt_cachefree,		// Cache_Free, or a flush
+	mt_cacheevict,		// thrown out to make room for something else
+	mt_numevents
+} memtraceevent_t;
+
+typedef struct
+{
+	int		ident;
+	int		version;
+	int		hunksize;			// all of the memory, -mem
+	char	engine[16];			// SOFTQUAKE_VERSION
+} memtraceheader_t;
+
+typedef struct
+{
+	double	time;				// seconds since the log was started, from Sys_PreciseTime
+	int		event;				// memtraceevent_t
+	int		size;				// with the header and padding, how much was taken or given back
+	int		site;				// return address minus the address of Memory_Init, 0 for zone.c itself
+	int		lowused;			// hunk_low_used after the event
+	int		highused;			// hunk_high_used after the event
+	char	name[16];
+} memtrace_t;
+
+#endif /* _MEMTRACE_H_ */
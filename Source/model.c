@@ -35,6 +35,8 @@ model_t *Mod_LoadModel (model_t *mod, qboolean crash);
 
 byte	mod_novis[MAX_MAP_LEAFS/8];
 
+cvar_t	mod_bspcache = {"mod_bspcache", "1", CV_ARCHIVE};	// softquake
+
 #define	MAX_MOD_KNOWN	256
 model_t	mod_known[MAX_MOD_KNOWN];
 int		mod_numknown;
@@ -52,6 +54,7 @@ Mod_Init
 void Mod_Init (void)
 {
 	memset (mod_novis, 0xff, sizeof(mod_novis));
+	Cvar_RegisterVariable (&mod_bspcache);	// softquake
 }
 
 /*
@@ -248,29 +251,45 @@ void Mod_TouchModel (char *name)
 
 /*
 ==================
-Mod_LoadModel
+Mod_IsLoaded
 
-Loads a model into the cache
+softquake -- Taken out of Mod_LoadModel
 ==================
 */
-model_t *Mod_LoadModel (model_t *mod, qboolean crash)
+static qboolean Mod_IsLoaded (model_t *mod)
 {
-	unsigned *buf;
-	byte	stackbuf[1024];		// avoid dirtying the cache heap
-
 	if (mod->type == mod_alias)
 	{
 		if (Cache_Check (&mod->cache))
 		{
 			mod->needload = NL_PRESENT;
-			return mod;
+			return true;
 		}
 	}
 	else
 	{
 		if (mod->needload == NL_PRESENT)
-			return mod;
+			return true;
 	}
+	return false;
+}
+
+static void Mod_LoadModelData (model_t *mod, unsigned *buf);
+
+/*
+==================
+Mod_LoadModel
+
+Loads a model into the cache
+==================
+*/
+model_t *Mod_LoadModel (model_t *mod, qboolean crash)
+{
+	unsigned *buf;
+	byte	stackbuf[1024];		// avoid dirtying the cache heap
+
+	if (Mod_IsLoaded (mod))	// softquake
+		return mod;
 
 //
 // because the world is so huge, load it one piece at a time
@@ -279,14 +298,27 @@ model_t *Mod_LoadModel (model_t *mod, qboolean crash)
 //
 // load the file
 //
-	buf = (unsigned *)COM_LoadStackFile (mod->name, stackbuf, sizeof(stackbuf));
+	buf = (unsigned *)COM_LoadMappedFile (mod->name, stackbuf, sizeof(stackbuf));	// softquake
 	if (!buf)
 	{
 		if (crash)
 			Sys_Error ("Mod_NumForName: %s not found", mod->name);
 		return NULL;
 	}
-	
+
+	Mod_LoadModelData (mod, buf);	// softquake
+	return mod;
+}
+
+/*
+==================
+Mod_LoadModelData
+
+softquake -- The part of Mod_LoadModel after the file has been read
+==================
+*/
+static void Mod_LoadModelData (model_t *mod, unsigned *buf)
+{
 //
 // allocate a new model
 //
@@ -315,8 +347,6 @@ model_t *Mod_LoadModel (model_t *mod, qboolean crash)
 		Mod_LoadBrushModel (mod, buf);
 		break;
 	}
-
-	return mod;
 }
 
 /*
@@ -335,6 +365,35 @@ model_t *Mod_ForName (char *name, qboolean crash)
 	return Mod_LoadModel (mod, crash);
 }
 
+/*
+==================
+Mod_NeedsLoad
+
+softquake -- True if Mod_ForName would have to read the file
+==================
+*/
+qboolean Mod_NeedsLoad (char *name)
+{
+	return !Mod_IsLoaded (Mod_FindName (name));
+}
+
+/*
+==================
+Mod_ForNameData
+
+softquake -- Mod_ForName, for a file that has already been read into data
+==================
+*/
+model_t *Mod_ForNameData (char *name, void *data)
+{
+	model_t	*mod;
+
+	mod = Mod_FindName (name);
+	if (!Mod_IsLoaded (mod))
+		Mod_LoadModelData (mod, data);
+	return mod;
+}
+
 
 /*
 ===============================================================================
@@ -1140,6 +1199,393 @@ float RadiusFromBounds (vec3_t mins, vec3_t maxs)
 	return Length (corner);
 }
 
+/*
+===============================================================================
+
+					BRUSHMODEL CACHE
+
+softquake -- Everything Mod_LoadBrushModel puts on the hunk is in one piece,
+so once it's done that piece and the models that point into it are written
+out to bspcache/<map>.bsc in the game directory. The next time the same map
+is loaded, it's read back in with a single read and only the pointers are
+moved to where it landed.
+
+The cache is only used if it was made from a bsp with the same crc and
+length, by the same version of the engine with the same structure sizes.
+===============================================================================
+*/
+
+#define	BSPCACHE_IDENT		(('C'<<24)+('S'<<16)+('B'<<8)+'Q')
+#define	BSPCACHE_VERSION	1
+
+typedef struct
+{
+	int			ident;
+	int			version;
+	char		engine[16];			// SOFTQUAKE_VERSION
+	int			sizes[8];			// of the structures, see Mod_BSPCacheSizes
+	int			crc;
+	int			bsplength;
+	int			numleafs;			// all of them, mod->numleafs is only the visible ones
+	int			nummodels;			// the world and its submodels
+	int			datasize;
+	byte		*database;			// where the data was when it was written
+} bspcache_t;
+
+static	byte		*bspcache_oldbase, *bspcache_newbase;
+static	int			bspcache_size;
+static	qboolean	bspcache_bad;
+
+/*
+=================
+Mod_BSPCacheSizes
+=================
+*/
+static void Mod_BSPCacheSizes (int *sizes)
+{
+	sizes[0] = sizeof(void *);
+	sizes[1] = sizeof(model_t);
+	sizes[2] = sizeof(msurface_t);
+	sizes[3] = sizeof(mnode_t);
+	sizes[4] = sizeof(mleaf_t);
+	sizes[5] = sizeof(mtexinfo_t);
+	sizes[6] = sizeof(texture_t);
+	sizes[7] = sizeof(mplane_t);
+}
+
+/*
+=================
+Mod_BSPCacheName
+=================
+*/
+static void Mod_BSPCacheName (char *name, int size)
+{
+	q_snprintf (name, size, "%s/bspcache/%s.bsc", com_gamedir, loadname);
+}
+
+/*
+=================
+Mod_BSPChecksum
+
+The crc of everything the lumps cover, before any of it is swapped
+=================
+*/
+static int Mod_BSPChecksum (dheader_t *header, int *length)
+{
+	int		i, end;
+
+	*length = sizeof(dheader_t);
+	for (i=0 ; i<HEADER_LUMPS ; i++)
+	{
+		end = LittleLong (header->lumps[i].fileofs) + LittleLong (header->lumps[i].filelen);
+		if (end > *length)
+			*length = end;
+	}
+	return CRC_Block ((byte *)header, *length);
+}
+
+/*
+=================
+Mod_BSPCacheReloc
+
+Moves a pointer from where the data was when it was written to where it is now
+=================
+*/
+static void *Mod_BSPCacheReloc (void *p)
+{
+	if (!p)
+		return NULL;
+	if ((byte *)p < bspcache_oldbase || (byte *)p >= bspcache_oldbase + bspcache_size)
+	{
+		bspcache_bad = true;
+		return NULL;
+	}
+	return bspcache_newbase + ((byte *)p - bspcache_oldbase);
+}
+
+/*
+=================
+Mod_BSPCacheArray
+
+Relocates a pointer to count things, which all have to be in the data
+=================
+*/
+static void *Mod_BSPCacheArray (void *p, int count, int size)
+{
+	p = Mod_BSPCacheReloc (p);
+	if (count < 0 || (p && (byte *)p + count*size > bspcache_newbase + bspcache_size))
+		bspcache_bad = true;
+	return p;
+}
+
+#define	BSPCACHE_RELOC(p)			((p) = Mod_BSPCacheReloc (p))
+#define	BSPCACHE_ARRAY(p, count)	((p) = Mod_BSPCacheArray (p, count, sizeof(*(p))))
+
+/*
+=================
+Mod_BSPCacheRelocModel
+=================
+*/
+static void Mod_BSPCacheRelocModel (model_t *mod, int numleafs)
+{
+	int		i;
+
+	BSPCACHE_ARRAY (mod->submodels, mod->numsubmodels);
+	BSPCACHE_ARRAY (mod->planes, mod->numplanes);
+	BSPCACHE_ARRAY (mod->leafs, numleafs);
+	BSPCACHE_ARRAY (mod->vertexes, mod->numvertexes);
+	BSPCACHE_ARRAY (mod->edges, mod->numedges);
+	BSPCACHE_ARRAY (mod->nodes, mod->numnodes);
+	BSPCACHE_ARRAY (mod->texinfo, mod->numtexinfo);
+	BSPCACHE_ARRAY (mod->surfaces, mod->numsurfaces);
+	BSPCACHE_ARRAY (mod->surfedges, mod->numsurfedges);
+	BSPCACHE_ARRAY (mod->clipnodes, mod->numclipnodes);
+	BSPCACHE_ARRAY (mod->marksurfaces, mod->nummarksurfaces);
+	BSPCACHE_ARRAY (mod->textures, mod->numtextures);
+	BSPCACHE_RELOC (mod->visdata);
+	BSPCACHE_RELOC (mod->lightdata);
+	BSPCACHE_RELOC (mod->entities);
+	for (i=0 ; i<MAX_MAP_HULLS ; i++)
+	{
+		BSPCACHE_RELOC (mod->hulls[i].clipnodes);
+		BSPCACHE_RELOC (mod->hulls[i].planes);
+	}
+	memset (&mod->cache, 0, sizeof(mod->cache));
+}
+
+/*
+=================
+Mod_BSPCacheRelocData
+
+Fixes the pointers inside the structures the world model points to
+=================
+*/
+static void Mod_BSPCacheRelocData (model_t *mod, int numleafs)
+{
+	texture_t	*tx;
+	mtexinfo_t	*ti;
+	msurface_t	*surf;
+	mnode_t		*node;
+	mleaf_t		*leaf;
+	int			i;
+
+	for (i=0 ; i<mod->numtextures ; i++)
+	{
+		tx = BSPCACHE_RELOC (mod->textures[i]);
+		if (!tx)
+			continue;
+		BSPCACHE_RELOC (tx->anim_next);
+		BSPCACHE_RELOC (tx->alternate_anims);
+	}
+
+	for (i=0, ti=mod->texinfo ; i<mod->numtexinfo ; i++, ti++)
+	{
+		if (ti->texture)
+			BSPCACHE_RELOC (ti->texture);
+		else
+			ti->texture = r_notexture_mip;		// see Mod_SaveBSPCache
+	}
+
+	for (i=0, surf=mod->surfaces ; i<mod->numsurfaces ; i++, surf++)
+	{
+		BSPCACHE_RELOC (surf->plane);
+		BSPCACHE_RELOC (surf->texinfo);
+		BSPCACHE_RELOC (surf->samples);
+	}
+
+	for (i=0, node=mod->nodes ; i<mod->numnodes ; i++, node++)
+	{
+		BSPCACHE_RELOC (node->parent);
+		BSPCACHE_RELOC (node->plane);
+		BSPCACHE_RELOC (node->children[0]);
+		BSPCACHE_RELOC (node->children[1]);
+	}
+
+	for (i=0, leaf=mod->leafs ; i<numleafs ; i++, leaf++)
+	{
+		BSPCACHE_RELOC (leaf->parent);
+		BSPCACHE_RELOC (leaf->compressed_vis);
+		BSPCACHE_RELOC (leaf->firstmarksurface);
+		leaf->efrags = NULL;
+	}
+
+	for (i=0 ; i<mod->nummarksurfaces ; i++)
+		BSPCACHE_RELOC (mod->marksurfaces[i]);
+}
+
+/*
+=================
+Mod_LoadBSPCache
+
+Returns false if there's no cache for this bsp, or it can't be used
+=================
+*/
+static qboolean Mod_LoadBSPCache (model_t *mod, int crc, int bsplength)
+{
+	char		name[MAX_OSPATH], modname[MAX_QPATH];
+	FILE		*f;
+	bspcache_t	header;
+	int			sizes[8];
+	model_t		*models, *sub;
+	byte		*data;
+	int			i, mark;
+
+	Mod_BSPCacheName (name, sizeof(name));
+	f = fopen (name, "rb");
+	if (!f)
+		return false;
+
+	Mod_BSPCacheSizes (sizes);
+	if (fread (&header, 1, sizeof(header), f) != sizeof(header)
+		|| header.ident != BSPCACHE_IDENT || header.version != BSPCACHE_VERSION
+		|| strncmp (header.engine, SOFTQUAKE_VERSION, sizeof(header.engine))
+		|| memcmp (header.sizes, sizes, sizeof(sizes))
+		|| header.crc != crc || header.bsplength != bsplength
+		|| header.nummodels < 1 || header.nummodels > MAX_MOD_KNOWN
+		|| header.datasize <= 0 || header.numleafs < 0)
+	{
+		fclose (f);
+		return false;
+	}
+
+	models = malloc (header.nummodels*sizeof(model_t));
+	if (!models)
+	{
+		fclose (f);
+		return false;
+	}
+
+	mark = Hunk_LowMark ();
+	data = Hunk_AllocName (header.datasize, loadname);
+	if (fread (models, sizeof(model_t), header.nummodels, f) != header.nummodels
+		|| fread (data, 1, header.datasize, f) != header.datasize)
+	{
+		Hunk_FreeToLowMark (mark);
+		free (models);
+		fclose (f);
+		return false;
+	}
+	fclose (f);
+
+//
+// move the pointers to where the data is now
+//
+	bspcache_oldbase = header.database;
+	bspcache_newbase = data;
+	bspcache_size = header.datasize;
+	bspcache_bad = false;
+
+	for (i=0 ; i<header.nummodels ; i++)
+		Mod_BSPCacheRelocModel (&models[i], header.numleafs);
+	if (!bspcache_bad)
+		Mod_BSPCacheRelocData (&models[0], header.numleafs);
+	if (bspcache_bad)
+	{
+		Con_Printf ("%s is damaged, loading %s instead\n", name, mod->name);
+		Hunk_FreeToLowMark (mark);
+		free (models);
+		return false;
+	}
+
+	for (i=0 ; i<models[0].numtextures ; i++)
+	{
+		if (models[0].textures[i] && !Q_strncmp (models[0].textures[i]->name, "sky", 3))
+			R_InitSky (models[0].textures[i]);
+	}
+
+//
+// put the world and its submodels back where Mod_LoadBrushModel would have
+//
+	strcpy (modname, mod->name);
+	for (i=0 ; i<header.nummodels ; i++)
+	{
+		if (i == 0)
+			sub = mod;
+		else
+		{
+			q_snprintf (name, sizeof(name), "*%i", i);
+			sub = Mod_FindName (name);
+		}
+		*sub = models[i];
+		strcpy (sub->name, i ? name : modname);
+		sub->needload = NL_PRESENT;
+		loadmodel = sub;
+	}
+
+	free (models);
+	Con_DPrintf ("Loaded %s from bspcache\n", modname);
+	return true;
+}
+
+/*
+=================
+Mod_SaveBSPCache
+
+Called right after Mod_LoadBrushModel has loaded mod, with the hunk mark
+from before it started
+=================
+*/
+static void Mod_SaveBSPCache (model_t *mod, int numleafs, int mark, int crc, int bsplength)
+{
+	extern byte	*hunk_base;
+	char		name[MAX_OSPATH];
+	FILE		*f;
+	bspcache_t	header;
+	model_t		*sub;
+	mtexinfo_t	*ti;
+	byte		*data;
+	int			i;
+
+	memset (&header, 0, sizeof(header));
+	header.ident = BSPCACHE_IDENT;
+	header.version = BSPCACHE_VERSION;
+	Q_strncpy (header.engine, SOFTQUAKE_VERSION, sizeof(header.engine));
+	Mod_BSPCacheSizes (header.sizes);
+	header.crc = crc;
+	header.bsplength = bsplength;
+	header.numleafs = numleafs;
+	header.nummodels = mod->numsubmodels ? mod->numsubmodels : 1;
+	header.database = hunk_base + mark;
+	header.datasize = Hunk_LowMark () - mark;
+
+	data = malloc (header.datasize);
+	if (!data)
+		return;
+	memcpy (data, header.database, header.datasize);
+
+// r_notexture_mip isn't part of the map, it's written as NULL
+	ti = (mtexinfo_t *)(data + ((byte *)mod->texinfo - header.database));
+	for (i=0 ; i<mod->numtexinfo ; i++, ti++)
+	{
+		if (ti->texture == r_notexture_mip)
+			ti->texture = NULL;
+	}
+
+	q_snprintf (name, sizeof(name), "%s/bspcache", com_gamedir);
+	Sys_mkdir (name);
+	Mod_BSPCacheName (name, sizeof(name));
+	f = fopen (name, "wb");
+	if (!f)
+	{
+		Con_DPrintf ("Couldn't write %s\n", name);
+		free (data);
+		return;
+	}
+
+	fwrite (&header, 1, sizeof(header), f);
+	fwrite (mod, sizeof(model_t), 1, f);
+	for (i=1 ; i<header.nummodels ; i++)
+	{
+		q_snprintf (name, sizeof(name), "*%i", i);
+		sub = Mod_FindName (name);
+		fwrite (sub, sizeof(model_t), 1, f);
+	}
+	fwrite (data, 1, header.datasize, f);
+	fclose (f);
+
+	free (data);
+}
+
 /*
 =================
 Mod_LoadBrushModel
@@ -1150,6 +1596,8 @@ void Mod_LoadBrushModel (model_t *mod, void *buffer)
 	int			i, j;
 	dheader_t	*header;
 	dmodel_t 	*bm;
+	model_t		*world;
+	int			mark, crc, bsplength, numleafs;
 	
 	loadmodel->type = mod_brush;
 	
@@ -1159,6 +1607,17 @@ void Mod_LoadBrushModel (model_t *mod, void *buffer)
 	if (i != BSPVERSION)
 		Sys_Error ("Mod_LoadBrushModel: %s has wrong version number (%i should be %i)", mod->name, i, BSPVERSION);
 
+// softquake -- see if it's been loaded before
+	world = mod;
+	mark = Hunk_LowMark ();
+	crc = bsplength = 0;
+	if (mod_bspcache.value)
+	{
+		crc = Mod_BSPChecksum (header, &bsplength);
+		if (Mod_LoadBSPCache (mod, crc, bsplength))
+			return;
+	}
+
 // swap all the lumps
 	mod_base = (byte *)header;
 
@@ -1184,6 +1643,8 @@ void Mod_LoadBrushModel (model_t *mod, void *buffer)
 	Mod_LoadSubmodels (&header->lumps[LUMP_MODELS]);
 
 	Mod_MakeHull0 ();
+
+	numleafs = mod->numleafs;	// softquake -- the loop below changes it
 	
 	mod->numframes = 2;		// regular and alternate animation
 	mod->flags = 0;
@@ -1223,6 +1684,9 @@ void Mod_LoadBrushModel (model_t *mod, void *buffer)
 			mod = loadmodel;
 		}
 	}
+
+	if (mod_bspcache.value)
+		Mod_SaveBSPCache (world, numleafs, mark, crc, bsplength);	// softquake
 }
 
 /*
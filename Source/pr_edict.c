@@ -50,15 +50,23 @@ cvar_t	saved2 = {"saved2", "0", true};
 cvar_t	saved3 = {"saved3", "0", true};
 cvar_t	saved4 = {"saved4", "0", true};
 
-#define	MAX_FIELD_LEN	64
-#define GEFV_CACHESIZE	2
+// softquake -- name lookups go through hash tables built by PR_LoadProgs
+typedef struct
+{
+	int			num;		// index+1 of the def, 0 if empty
+	string_t	s_name;
+} defslot_t;
+
+typedef struct
+{
+	defslot_t	*slots;
+	int			mask;
+} defhash_t;
 
-typedef struct {
-	ddef_t	*pcache;
-	char	field[MAX_FIELD_LEN];
-} gefv_cache;
+static	defhash_t	pr_fieldhash, pr_globalhash, pr_functionhash;
 
-static gefv_cache	gefvCache[GEFV_CACHESIZE] = {{NULL, ""}, {NULL, ""}};
+int		pr_fielditems2;		// softquake -- -1 when the progs don't have it
+int		pr_fieldgravity;
 
 /*
 =================
@@ -71,6 +79,7 @@ void ED_ClearEdict (edict_t *e)
 {
 	memset (&e->v, 0, progs->entityfields * 4);
 	e->free = false;
+	ED_WAKE (e);	// softquake
 }
 
 /*
@@ -180,21 +189,91 @@ ddef_t *ED_FieldAtOfs (int ofs)
 
 /*
 ============
-ED_FindField
+PR_HashName
 ============
 */
-ddef_t *ED_FindField (char *name)
+static unsigned PR_HashName (char *name)
 {
-	ddef_t		*def;
-	int			i;
-	
-	for (i=0 ; i<progs->numfielddefs ; i++)
+	unsigned	hash;
+
+	for (hash=2166136261u ; *name ; name++)
+		hash = (hash ^ (byte)*name) * 16777619u;
+	return hash;
+}
+
+/*
+============
+PR_AllocDefHash
+============
+*/
+static void PR_AllocDefHash (defhash_t *table, int count, char *name)
+{
+	int		size;
+
+	for (size=16 ; size < count*2 ; size<<=1)
+		;
+	table->slots = Hunk_AllocName (size*sizeof(defslot_t), name);
+	table->mask = size - 1;
+}
+
+/*
+============
+PR_HashDef
+
+If a name is used twice the first one stays, which is the one the old search
+in order would have found
+============
+*/
+static void PR_HashDef (defhash_t *table, int num, string_t s_name)
+{
+	defslot_t	*slot;
+	unsigned	i;
+
+	for (i=PR_HashName (pr_strings + s_name) ; ; i++)
 	{
-		def = &pr_fielddefs[i];
-		if (!strcmp(pr_strings + def->s_name,name) )
-			return def;
+		slot = &table->slots[i & table->mask];
+		if (!slot->num)
+			break;
+		if (!strcmp (pr_strings + slot->s_name, pr_strings + s_name))
+			return;
 	}
-	return NULL;
+	slot->num = num + 1;
+	slot->s_name = s_name;
+}
+
+/*
+============
+PR_FindDef
+
+Returns the number of the def, or -1
+============
+*/
+static int PR_FindDef (defhash_t *table, char *name)
+{
+	defslot_t	*slot;
+	unsigned	i;
+
+	for (i=PR_HashName (name) ; ; i++)
+	{
+		slot = &table->slots[i & table->mask];
+		if (!slot->num)
+			return -1;
+		if (!strcmp (pr_strings + slot->s_name, name))
+			return slot->num - 1;
+	}
+}
+
+/*
+============
+ED_FindField
+============
+*/
+ddef_t *ED_FindField (char *name)
+{
+	int		i;
+
+	i = PR_FindDef (&pr_fieldhash, name);	// softquake
+	return i < 0 ? NULL : &pr_fielddefs[i];
 }
 
 
@@ -205,16 +284,10 @@ ED_FindGlobal
 */
 ddef_t *ED_FindGlobal (char *name)
 {
-	ddef_t		*def;
-	int			i;
-	
-	for (i=0 ; i<progs->numglobaldefs ; i++)
-	{
-		def = &pr_globaldefs[i];
-		if (!strcmp(pr_strings + def->s_name,name) )
-			return def;
-	}
-	return NULL;
+	int		i;
+
+	i = PR_FindDef (&pr_globalhash, name);	// softquake
+	return i < 0 ? NULL : &pr_globaldefs[i];
 }
 
 
@@ -225,44 +298,59 @@ ED_FindFunction
 */
 dfunction_t *ED_FindFunction (char *name)
 {
-	dfunction_t		*func;
-	int				i;
-	
-	for (i=0 ; i<progs->numfunctions ; i++)
-	{
-		func = &pr_functions[i];
-		if (!strcmp(pr_strings + func->s_name,name) )
-			return func;
-	}
-	return NULL;
+	int		i;
+
+	i = PR_FindDef (&pr_functionhash, name);	// softquake
+	return i < 0 ? NULL : &pr_functions[i];
 }
 
 
-eval_t *GetEdictFieldValue(edict_t *ed, char *field)
+/*
+============
+PR_BuildDefHashes
+
+Called by PR_LoadProgs once everything has been byte swapped
+============
+*/
+static void PR_BuildDefHashes (void)
 {
-	ddef_t			*def = NULL;
-	int				i;
-	static int		rep = 0;
+	ddef_t	*def;
+	int		i;
 
-	for (i=0 ; i<GEFV_CACHESIZE ; i++)
-	{
-		if (!strcmp(field, gefvCache[i].field))
-		{
-			def = gefvCache[i].pcache;
-			goto Done;
-		}
-	}
+	PR_AllocDefHash (&pr_fieldhash, progs->numfielddefs, "fieldhash");
+	for (i=0 ; i<progs->numfielddefs ; i++)
+		PR_HashDef (&pr_fieldhash, i, pr_fielddefs[i].s_name);
 
-	def = ED_FindField (field);
+	PR_AllocDefHash (&pr_globalhash, progs->numglobaldefs, "globalhash");
+	for (i=0 ; i<progs->numglobaldefs ; i++)
+		PR_HashDef (&pr_globalhash, i, pr_globaldefs[i].s_name);
 
-	if (strlen(field) < MAX_FIELD_LEN)
-	{
-		gefvCache[rep].pcache = def;
-		strcpy (gefvCache[rep].field, field);
-		rep ^= 1;
-	}
+	PR_AllocDefHash (&pr_functionhash, progs->numfunctions, "funchash");
+	for (i=0 ; i<progs->numfunctions ; i++)
+		PR_HashDef (&pr_functionhash, i, pr_functions[i].s_name);
+
+// the fields the engine looks at every frame
+	def = ED_FindField ("items2");
+	pr_fielditems2 = def ? def->ofs : -1;
+	def = ED_FindField ("gravity");
+	pr_fieldgravity = def ? def->ofs : -1;
+}
 
-Done:
+
+/*
+============
+GetEdictFieldValue
+
+softquake -- the old two entry cache is gone, so this can be called from any
+thread. Fields that are needed every frame should use E_FIELDVALUE with an
+offset found by PR_BuildDefHashes instead.
+============
+*/
+eval_t *GetEdictFieldValue(edict_t *ed, char *field)
+{
+	ddef_t			*def;
+
+	def = ED_FindField (field);
 	if (!def)
 		return NULL;
 
@@ -812,6 +900,7 @@ char *ED_ParseEdict (char *data, edict_t *ent)
 // clear it
 	if (ent != sv.edicts)	// hack
 		memset (&ent->v, 0, progs->entityfields * 4);
+	ED_WAKE (ent);	// softquake
 
 // go through all the dictionary pairs
 	while (1)
@@ -986,10 +1075,6 @@ void PR_LoadProgs (void)
 {
 	int		i;
 
-// flush the non-C variable lookup cache
-	for (i=0 ; i<GEFV_CACHESIZE ; i++)
-		gefvCache[i].field[0] = 0;
-
 	CRC_Init (&pr_crc);
 
 	progs = (dprograms_t *)COM_LoadHunkFile ("progs.dat");
@@ -1057,6 +1142,10 @@ void PR_LoadProgs (void)
 
 	for (i=0 ; i<progs->numglobals ; i++)
 		((int *)pr_globals)[i] = LittleLong (((int *)pr_globals)[i]);
+
+	PR_BuildDefHashes ();		// softquake
+	PR_BuildThreadedCode ();	// softquake
+	PR_LoadNativeProgs ();		// softquake
 }
 
 
@@ -1082,6 +1171,8 @@ void PR_Init (void)
 	Cvar_RegisterVariable (&saved2);
 	Cvar_RegisterVariable (&saved3);
 	Cvar_RegisterVariable (&saved4);
+	PR_InitThreadedCode ();		// softquake
+	PR_InitNative ();			// softquake
 }
 
 
@@ -379,6 +379,20 @@ void PR_ExecuteProgram (func_t fnum)
 	
 	f = &pr_functions[fnum];
 
+// softquake -- translated to C by progtool
+	if (pr_native && pr_native[fnum] && pr_nativecode.value)
+	{
+		PR_ExecuteNative (f, pr_native[fnum]);
+		return;
+	}
+
+// softquake -- pre-decoded statements, unless they've been turned off
+	if (pr_code && pr_threadedcode.value)
+	{
+		PR_ExecuteThreaded (f);
+		return;
+	}
+
 	runaway = 100000;
 	pr_trace = false;
 
@@ -566,6 +580,7 @@ while (1)
 		if (ed == (edict_t *)sv.edicts && sv.state == ss_active)
 			PR_RunError ("assignment to world entity");
 		c->_int = (byte *)((int *)&ed->v + b->_int) - (byte *)sv.edicts;
+		ED_WAKE (ed);	// softquake
 		break;
 		
 	case OP_LOAD_F:
@@ -658,6 +673,7 @@ while (1)
 			ed->v.frame = a->_float;
 		}
 		ed->v.think = b->function;
+		ED_WAKE (ed);	// softquake
 		break;
 		
 	default:
@@ -0,0 +1,173 @@
+/*
+Copyright (C) 2023-2023 softquake
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+// pr_native.c -- runs QuakeC functions that progtool translated to C
+
+// progtool turns every function of a progs.dat into a C function, and the
+// result, pr_progs.c, is built in with ENABLE_NATIVE_PROGS. When a progs.dat
+// is loaded whose crc and size match one of those, its functions are called
+// directly instead of being interpreted.
+//
+// Locals, parameters and the call stack are handled by PR_EnterFunction and
+// PR_LeaveFunction as usual, so stack traces and error messages are the same.
+// What's different: the runaway check only counts statements on backwards
+// branches, traceon has no effect, and 'profile' doesn't see these functions.
+// Turning pr_nativecode off gets all of that back.
+
+#include "quakedef.h"
+#include "pr_native.h"
+
+cvar_t	pr_nativecode = {"pr_nativecode", "1", CV_ARCHIVE};
+
+prnative_t	*pr_native;
+int			pr_nativebudget;
+
+
+/*
+===============
+PR_InitNative
+===============
+*/
+void PR_InitNative (void)
+{
+	Cvar_RegisterVariable (&pr_nativecode);
+}
+
+
+/*
+===============
+PR_LoadNativeProgs
+
+Called by PR_LoadProgs once pr_crc is known
+===============
+*/
+void PR_LoadNativeProgs (void)
+{
+#ifdef SOFTQUAKE_NATIVE_PROGS
+	prnativeprogs_t	**p;
+#endif
+
+	pr_native = NULL;
+
+#ifdef SOFTQUAKE_NATIVE_PROGS
+	for (p=pr_nativeprogs ; *p ; p++)
+	{
+		if ((*p)->crc != pr_crc || (*p)->filesize != com_filesize)
+			continue;
+		if ((*p)->numstatements != progs->numstatements
+		|| (*p)->numfunctions != progs->numfunctions)
+			continue;
+
+		pr_native = (*p)->functions;
+		Con_DPrintf ("Using translated progs.dat\n");
+		return;
+	}
+#endif
+}
+
+
+/*
+====================
+PR_ExecuteNative
+====================
+*/
+void PR_ExecuteNative (dfunction_t *f, prnative_t func)
+{
+	int		budget;
+
+	budget = pr_nativebudget;
+	pr_nativebudget = 100000;
+	pr_trace = false;
+
+	PR_EnterFunction (f);
+	func ();
+	PR_LeaveFunction ();
+
+	pr_nativebudget = budget;
+}
+
+
+/*
+====================
+PR_NativeCall
+
+The CALL opcodes
+====================
+*/
+void PR_NativeCall (int statement, int argc, func_t fnum)
+{
+	dfunction_t	*f;
+	int			i;
+
+	pr_xstatement = statement;
+	pr_argc = argc;
+	if (!fnum)
+		PR_RunError ("NULL function");
+
+	if (fnum >= progs->numfunctions)
+	{	// let PR_ExecuteProgram complain about it
+		PR_ExecuteProgram (fnum);
+		return;
+	}
+
+	f = &pr_functions[fnum];
+
+	if (f->first_statement < 0)
+	{	// negative statements are built in functions
+		i = -f->first_statement;
+		if (i >= pr_numbuiltins)
+			PR_RunError ("Bad builtin call number");
+		pr_builtins[i] ();
+		return;
+	}
+
+	if (!pr_native[fnum])
+	{	// progtool left this one to the interpreter
+		PR_ExecuteProgram (fnum);
+		return;
+	}
+
+	PR_EnterFunction (f);
+	pr_native[fnum] ();
+	PR_LeaveFunction ();
+}
+
+
+/*
+====================
+PR_NativeError
+====================
+*/
+void PR_NativeError (int statement, char *error)
+{
+	pr_xstatement = statement;
+	PR_RunError ("%s", error);
+}
+
+
+/*
+====================
+PR_NativeRunaway
+====================
+*/
+void PR_NativeRunaway (int statement)
+{
+	PR_NativeError (statement, "runaway loop error");
+}
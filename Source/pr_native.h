@@ -0,0 +1,172 @@
+/*
+Copyright (C) 2023-2023 softquake
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+// pr_native.h -- shared by pr_native.c and the C files written by progtool
+
+// Each opcode is spelled out the same way as in PR_ExecuteProgram, with the
+// operands turned into constant global offsets. Anything that can end up in
+// PR_RunError is handed the statement number, so the error still points at
+// the right place in progs.dat.
+
+typedef struct
+{
+	unsigned short	crc;			// of the whole file, same as pr_crc
+	int				filesize;
+	int				numstatements;
+	int				numfunctions;
+	prnative_t		*functions;		// NULL for the ones left to the interpreter
+} prnativeprogs_t;
+
+extern	prnativeprogs_t	*pr_nativeprogs[];	// NULL terminated, in pr_progs.c
+extern	int				pr_nativebudget;
+
+void PR_NativeCall (int statement, int argc, func_t fnum);
+void PR_NativeError (int statement, char *error);
+void PR_NativeRunaway (int statement);
+
+#define NG(o)	((eval_t *)&pr_globals[o])
+
+#ifdef PARANOID
+#define N_CHECKEDICT(ed)	NUM_FOR_EDICT(ed)		// make sure it's in range
+#else
+#define N_CHECKEDICT(ed)
+#endif
+
+#ifdef FPS_20
+#define N_FRAMETIME		0.05
+#else
+#define N_FRAMETIME		0.1
+#endif
+
+#define N_ADD_F(a,b,c)	NG(c)->_float = NG(a)->_float + NG(b)->_float
+#define N_ADD_V(a,b,c)	do { \
+	NG(c)->vector[0] = NG(a)->vector[0] + NG(b)->vector[0]; \
+	NG(c)->vector[1] = NG(a)->vector[1] + NG(b)->vector[1]; \
+	NG(c)->vector[2] = NG(a)->vector[2] + NG(b)->vector[2]; } while (0)
+
+#define N_SUB_F(a,b,c)	NG(c)->_float = NG(a)->_float - NG(b)->_float
+#define N_SUB_V(a,b,c)	do { \
+	NG(c)->vector[0] = NG(a)->vector[0] - NG(b)->vector[0]; \
+	NG(c)->vector[1] = NG(a)->vector[1] - NG(b)->vector[1]; \
+	NG(c)->vector[2] = NG(a)->vector[2] - NG(b)->vector[2]; } while (0)
+
+#define N_MUL_F(a,b,c)	NG(c)->_float = NG(a)->_float * NG(b)->_float
+#define N_MUL_V(a,b,c)	NG(c)->_float = NG(a)->vector[0]*NG(b)->vector[0] \
+	+ NG(a)->vector[1]*NG(b)->vector[1] \
+	+ NG(a)->vector[2]*NG(b)->vector[2]
+#define N_MUL_FV(a,b,c)	do { \
+	NG(c)->vector[0] = NG(a)->_float * NG(b)->vector[0]; \
+	NG(c)->vector[1] = NG(a)->_float * NG(b)->vector[1]; \
+	NG(c)->vector[2] = NG(a)->_float * NG(b)->vector[2]; } while (0)
+#define N_MUL_VF(a,b,c)	do { \
+	NG(c)->vector[0] = NG(b)->_float * NG(a)->vector[0]; \
+	NG(c)->vector[1] = NG(b)->_float * NG(a)->vector[1]; \
+	NG(c)->vector[2] = NG(b)->_float * NG(a)->vector[2]; } while (0)
+
+#define N_DIV_F(a,b,c)	NG(c)->_float = NG(a)->_float / NG(b)->_float
+
+#define N_BITAND(a,b,c)	NG(c)->_float = (int)NG(a)->_float & (int)NG(b)->_float
+#define N_BITOR(a,b,c)	NG(c)->_float = (int)NG(a)->_float | (int)NG(b)->_float
+
+#define N_GE(a,b,c)		NG(c)->_float = NG(a)->_float >= NG(b)->_float
+#define N_LE(a,b,c)		NG(c)->_float = NG(a)->_float <= NG(b)->_float
+#define N_GT(a,b,c)		NG(c)->_float = NG(a)->_float > NG(b)->_float
+#define N_LT(a,b,c)		NG(c)->_float = NG(a)->_float < NG(b)->_float
+#define N_AND(a,b,c)	NG(c)->_float = NG(a)->_float && NG(b)->_float
+#define N_OR(a,b,c)		NG(c)->_float = NG(a)->_float || NG(b)->_float
+
+#define N_NOT_F(a,c)	NG(c)->_float = !NG(a)->_float
+#define N_NOT_V(a,c)	NG(c)->_float = !NG(a)->vector[0] && !NG(a)->vector[1] && !NG(a)->vector[2]
+#define N_NOT_S(a,c)	NG(c)->_float = !NG(a)->string || !pr_strings[NG(a)->string]
+#define N_NOT_FNC(a,c)	NG(c)->_float = !NG(a)->function
+#define N_NOT_ENT(a,c)	NG(c)->_float = (PROG_TO_EDICT(NG(a)->edict) == sv.edicts)
+
+#define N_EQ_F(a,b,c)	NG(c)->_float = NG(a)->_float == NG(b)->_float
+#define N_EQ_V(a,b,c)	NG(c)->_float = (NG(a)->vector[0] == NG(b)->vector[0]) && \
+	(NG(a)->vector[1] == NG(b)->vector[1]) && \
+	(NG(a)->vector[2] == NG(b)->vector[2])
+#define N_EQ_S(a,b,c)	NG(c)->_float = !strcmp(pr_strings+NG(a)->string,pr_strings+NG(b)->string)
+#define N_EQ_E(a,b,c)	NG(c)->_float = NG(a)->_int == NG(b)->_int
+#define N_EQ_FNC(a,b,c)	NG(c)->_float = NG(a)->function == NG(b)->function
+
+#define N_NE_F(a,b,c)	NG(c)->_float = NG(a)->_float != NG(b)->_float
+#define N_NE_V(a,b,c)	NG(c)->_float = (NG(a)->vector[0] != NG(b)->vector[0]) || \
+	(NG(a)->vector[1] != NG(b)->vector[1]) || \
+	(NG(a)->vector[2] != NG(b)->vector[2])
+#define N_NE_S(a,b,c)	NG(c)->_float = strcmp(pr_strings+NG(a)->string,pr_strings+NG(b)->string)
+#define N_NE_E(a,b,c)	NG(c)->_float = NG(a)->_int != NG(b)->_int
+#define N_NE_FNC(a,b,c)	NG(c)->_float = NG(a)->function != NG(b)->function
+
+#define N_STORE(a,b)	NG(b)->_int = NG(a)->_int
+#define N_STORE_V(a,b)	do { \
+	NG(b)->vector[0] = NG(a)->vector[0]; \
+	NG(b)->vector[1] = NG(a)->vector[1]; \
+	NG(b)->vector[2] = NG(a)->vector[2]; } while (0)
+
+#define N_STOREP(a,b)	do { \
+	eval_t *ptr = (eval_t *)((byte *)sv.edicts + NG(b)->_int); \
+	ptr->_int = NG(a)->_int; } while (0)
+#define N_STOREP_V(a,b)	do { \
+	eval_t *ptr = (eval_t *)((byte *)sv.edicts + NG(b)->_int); \
+	ptr->vector[0] = NG(a)->vector[0]; \
+	ptr->vector[1] = NG(a)->vector[1]; \
+	ptr->vector[2] = NG(a)->vector[2]; } while (0)
+
+#define N_ADDRESS(s,a,b,c)	do { \
+	edict_t *ed = PROG_TO_EDICT(NG(a)->edict); \
+	N_CHECKEDICT(ed); \
+	if (ed == (edict_t *)sv.edicts && sv.state == ss_active) \
+		PR_NativeError (s, "assignment to world entity"); \
+	NG(c)->_int = (byte *)((int *)&ed->v + NG(b)->_int) - (byte *)sv.edicts; \
+	ED_WAKE(ed); } while (0)
+
+#define N_LOAD(a,b,c)	do { \
+	edict_t *ed = PROG_TO_EDICT(NG(a)->edict); \
+	N_CHECKEDICT(ed); \
+	NG(c)->_int = ((eval_t *)((int *)&ed->v + NG(b)->_int))->_int; } while (0)
+#define N_LOAD_V(a,b,c)	do { \
+	edict_t *ed = PROG_TO_EDICT(NG(a)->edict); \
+	eval_t *ptr; \
+	N_CHECKEDICT(ed); \
+	ptr = (eval_t *)((int *)&ed->v + NG(b)->_int); \
+	NG(c)->vector[0] = ptr->vector[0]; \
+	NG(c)->vector[1] = ptr->vector[1]; \
+	NG(c)->vector[2] = ptr->vector[2]; } while (0)
+
+#define N_CALL(s,argc,a)	PR_NativeCall (s, argc, NG(a)->function)
+
+#define N_RETURN(a)		do { \
+	pr_globals[OFS_RETURN] = pr_globals[a]; \
+	pr_globals[OFS_RETURN+1] = pr_globals[(a)+1]; \
+	pr_globals[OFS_RETURN+2] = pr_globals[(a)+2]; \
+	return; } while (0)
+
+#define N_STATE(a,b)	do { \
+	edict_t *ed = PROG_TO_EDICT(pr_global_struct->self); \
+	ed->v.nextthink = pr_global_struct->time + N_FRAMETIME; \
+	if (NG(a)->_float != ed->v.frame) \
+		ed->v.frame = NG(a)->_float; \
+	ed->v.think = NG(b)->function; \
+	ED_WAKE(ed); } while (0)
+
+// taken on every backwards branch, with the number of statements jumped over
+#define N_LOOP(s,count)	do { \
+	if ((pr_nativebudget -= (count)) <= 0) \
+		PR_NativeRunaway (s); } while (0)
@@ -0,0 +1,499 @@
+/*
+Copyright (C) 2023-2023 softquake
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+// pr_threaded.c -- pre-decoded QuakeC interpreter
+
+// When the progs are loaded, every statement is turned into a prcode_t that
+// points straight at its operands and branch target, and PR_ExecuteThreaded
+// runs those with computed goto, so each opcode jumps right into the code for
+// the next one instead of going back around a switch.
+//
+// Everything the interpreter in pr_exec.c leaves behind stays the same: the
+// call stack, the runaway counter, pr_xstatement whenever something can look
+// at it, the statement counts for the profile command and the traceon trace.
+// The only difference is when the counts and pr_xstatement are written out,
+// which is before anything that can call back out of the loop.
+//
+// Needs the labels as values extension of gcc and clang. Without it, no code
+// is built and PR_ExecuteProgram always uses the switch.
+
+#include "quakedef.h"
+
+#if defined(__GNUC__)
+#define PR_COMPUTED_GOTO
+#endif
+
+cvar_t	pr_threadedcode = {"pr_threadedcode", "1", CV_ARCHIVE};
+
+#define PR_BADOP	(OP_BITOR + 1)	// anything past the last opcode
+
+prcode_t	*pr_code;
+
+
+/*
+===============
+PR_InitThreadedCode
+===============
+*/
+void PR_InitThreadedCode (void)
+{
+	Cvar_RegisterVariable (&pr_threadedcode);
+}
+
+
+/*
+===============
+PR_BuildThreadedCode
+
+Called by PR_LoadProgs once the lumps have been swapped. Progs that jump or
+call outside their statements are left to the switch.
+===============
+*/
+void PR_BuildThreadedCode (void)
+{
+#ifdef PR_COMPUTED_GOTO
+	int				i, target;
+	dstatement_t	*st;
+	prcode_t		*code;
+
+	pr_code = NULL;
+
+	for (i=0 ; i<progs->numfunctions ; i++)
+	{
+		if (pr_functions[i].first_statement >= progs->numstatements)
+		{
+			Con_DPrintf ("PR_BuildThreadedCode: function %i starts past the end\n", i);
+			return;
+		}
+	}
+
+// one more at the end, in case the last function runs off it
+	code = Hunk_AllocName ((progs->numstatements + 1) * sizeof(prcode_t), "prcode");
+
+	for (i=0, st=pr_statements ; i<progs->numstatements ; i++, st++)
+	{
+		code[i].op = st->op > OP_BITOR ? PR_BADOP : st->op;
+		code[i].a = (eval_t *)&pr_globals[st->a];
+		code[i].b = (eval_t *)&pr_globals[st->b];
+		code[i].c = (eval_t *)&pr_globals[st->c];
+
+		if (st->op == OP_IF || st->op == OP_IFNOT)
+			target = i + st->b;
+		else if (st->op == OP_GOTO)
+			target = i + st->a;
+		else
+			continue;
+
+		if (target < 0 || target >= progs->numstatements)
+		{
+			Con_DPrintf ("PR_BuildThreadedCode: statement %i branches out of range\n", i);
+			return;
+		}
+		code[i].jump = &code[target];
+	}
+
+	code[i].op = PR_BADOP;
+
+	pr_code = code;
+#else
+	pr_code = NULL;
+#endif
+}
+
+
+#ifdef PR_COMPUTED_GOTO
+
+// counts go to the function the statements ran in, so they're written out
+// before pr_xfunction can change
+#define COUNT	(pr_xfunction->profile += profiled - runaway, profiled = runaway)
+#define SYNC	(COUNT, pr_xstatement = st - pr_code)
+
+#define JUMP(to)	do { if (!--runaway) goto runaway; st = (to); goto *dispatch[st->op]; } while (0)
+#define NEXT		JUMP(st + 1)
+
+// after a call or return, pr_xstatement is already what it was left at
+#define RESUME(to)	do { if (!--runaway) goto runaway_synced; st = (to); goto *dispatch[st->op]; } while (0)
+
+/*
+====================
+PR_ExecuteThreaded
+====================
+*/
+void PR_ExecuteThreaded (dfunction_t *f)
+{
+	static const void *optable[PR_BADOP+1] =
+	{
+		[OP_DONE] = &&op_return,
+		[OP_MUL_F] = &&op_mul_f,
+		[OP_MUL_V] = &&op_mul_v,
+		[OP_MUL_FV] = &&op_mul_fv,
+		[OP_MUL_VF] = &&op_mul_vf,
+		[OP_DIV_F] = &&op_div_f,
+		[OP_ADD_F] = &&op_add_f,
+		[OP_ADD_V] = &&op_add_v,
+		[OP_SUB_F] = &&op_sub_f,
+		[OP_SUB_V] = &&op_sub_v,
+		[OP_EQ_F] = &&op_eq_f,
+		[OP_EQ_V] = &&op_eq_v,
+		[OP_EQ_S] = &&op_eq_s,
+		[OP_EQ_E] = &&op_eq_e,
+		[OP_EQ_FNC] = &&op_eq_fnc,
+		[OP_NE_F] = &&op_ne_f,
+		[OP_NE_V] = &&op_ne_v,
+		[OP_NE_S] = &&op_ne_s,
+		[OP_NE_E] = &&op_ne_e,
+		[OP_NE_FNC] = &&op_ne_fnc,
+		[OP_LE] = &&op_le,
+		[OP_GE] = &&op_ge,
+		[OP_LT] = &&op_lt,
+		[OP_GT] = &&op_gt,
+		[OP_LOAD_F] = &&op_load,
+		[OP_LOAD_V] = &&op_load_v,
+		[OP_LOAD_S] = &&op_load,
+		[OP_LOAD_ENT] = &&op_load,
+		[OP_LOAD_FLD] = &&op_load,
+		[OP_LOAD_FNC] = &&op_load,
+		[OP_ADDRESS] = &&op_address,
+		[OP_STORE_F] = &&op_store,
+		[OP_STORE_V] = &&op_store_v,
+		[OP_STORE_S] = &&op_store,
+		[OP_STORE_ENT] = &&op_store,
+		[OP_STORE_FLD] = &&op_store,
+		[OP_STORE_FNC] = &&op_store,
+		[OP_STOREP_F] = &&op_storep,
+		[OP_STOREP_V] = &&op_storep_v,
+		[OP_STOREP_S] = &&op_storep,
+		[OP_STOREP_ENT] = &&op_storep,
+		[OP_STOREP_FLD] = &&op_storep,
+		[OP_STOREP_FNC] = &&op_storep,
+		[OP_RETURN] = &&op_return,
+		[OP_NOT_F] = &&op_not_f,
+		[OP_NOT_V] = &&op_not_v,
+		[OP_NOT_S] = &&op_not_s,
+		[OP_NOT_ENT] = &&op_not_ent,
+		[OP_NOT_FNC] = &&op_not_fnc,
+		[OP_IF] = &&op_if,
+		[OP_IFNOT] = &&op_ifnot,
+		[OP_CALL0] = &&op_call,
+		[OP_CALL1] = &&op_call,
+		[OP_CALL2] = &&op_call,
+		[OP_CALL3] = &&op_call,
+		[OP_CALL4] = &&op_call,
+		[OP_CALL5] = &&op_call,
+		[OP_CALL6] = &&op_call,
+		[OP_CALL7] = &&op_call,
+		[OP_CALL8] = &&op_call,
+		[OP_STATE] = &&op_state,
+		[OP_GOTO] = &&op_goto,
+		[OP_AND] = &&op_and,
+		[OP_OR] = &&op_or,
+		[OP_BITAND] = &&op_bitand,
+		[OP_BITOR] = &&op_bitor,
+		[PR_BADOP] = &&op_bad
+	};
+	static const void *tracetable[PR_BADOP+1] =
+	{
+		[0 ... PR_BADOP] = &&trace
+	};
+
+	const void	* const *dispatch;
+	prcode_t	*st;
+	dfunction_t	*newf;
+	edict_t		*ed;
+	eval_t		*ptr;
+	int			i, runaway, profiled, exitdepth;
+
+	runaway = profiled = 100000;
+	pr_trace = false;
+	dispatch = optable;
+
+// make a stack frame
+	exitdepth = pr_depth;
+
+	st = pr_code + PR_EnterFunction (f);
+	NEXT;
+
+trace:
+	pr_xstatement = st - pr_code;
+	if (pr_xstatement < progs->numstatements)	// not the one past the end
+		PR_PrintStatement (pr_statements + pr_xstatement);
+	goto *optable[st->op];
+
+runaway:
+	pr_xstatement = st - pr_code;
+runaway_synced:
+	runaway++;		// the next one never ran
+	COUNT;
+	PR_RunError ("runaway loop error");
+
+op_bad:
+	SYNC;
+	if (pr_xstatement == progs->numstatements)
+	{	// the extra one at the end, blame the last real statement
+		pr_xstatement--;
+		PR_RunError ("ran off the end of the last function");
+	}
+	PR_RunError ("Bad opcode %i", pr_statements[pr_xstatement].op);
+
+op_add_f:
+	st->c->_float = st->a->_float + st->b->_float;
+	NEXT;
+op_add_v:
+	st->c->vector[0] = st->a->vector[0] + st->b->vector[0];
+	st->c->vector[1] = st->a->vector[1] + st->b->vector[1];
+	st->c->vector[2] = st->a->vector[2] + st->b->vector[2];
+	NEXT;
+
+op_sub_f:
+	st->c->_float = st->a->_float - st->b->_float;
+	NEXT;
+op_sub_v:
+	st->c->vector[0] = st->a->vector[0] - st->b->vector[0];
+	st->c->vector[1] = st->a->vector[1] - st->b->vector[1];
+	st->c->vector[2] = st->a->vector[2] - st->b->vector[2];
+	NEXT;
+
+op_mul_f:
+	st->c->_float = st->a->_float * st->b->_float;
+	NEXT;
+op_mul_v:
+	st->c->_float = st->a->vector[0]*st->b->vector[0]
+			+ st->a->vector[1]*st->b->vector[1]
+			+ st->a->vector[2]*st->b->vector[2];
+	NEXT;
+op_mul_fv:
+	st->c->vector[0] = st->a->_float * st->b->vector[0];
+	st->c->vector[1] = st->a->_float * st->b->vector[1];
+	st->c->vector[2] = st->a->_float * st->b->vector[2];
+	NEXT;
+op_mul_vf:
+	st->c->vector[0] = st->b->_float * st->a->vector[0];
+	st->c->vector[1] = st->b->_float * st->a->vector[1];
+	st->c->vector[2] = st->b->_float * st->a->vector[2];
+	NEXT;
+
+op_div_f:
+	st->c->_float = st->a->_float / st->b->_float;
+	NEXT;
+
+op_bitand:
+	st->c->_float = (int)st->a->_float & (int)st->b->_float;
+	NEXT;
+op_bitor:
+	st->c->_float = (int)st->a->_float | (int)st->b->_float;
+	NEXT;
+
+op_ge:
+	st->c->_float = st->a->_float >= st->b->_float;
+	NEXT;
+op_le:
+	st->c->_float = st->a->_float <= st->b->_float;
+	NEXT;
+op_gt:
+	st->c->_float = st->a->_float > st->b->_float;
+	NEXT;
+op_lt:
+	st->c->_float = st->a->_float < st->b->_float;
+	NEXT;
+op_and:
+	st->c->_float = st->a->_float && st->b->_float;
+	NEXT;
+op_or:
+	st->c->_float = st->a->_float || st->b->_float;
+	NEXT;
+
+op_not_f:
+	st->c->_float = !st->a->_float;
+	NEXT;
+op_not_v:
+	st->c->_float = !st->a->vector[0] && !st->a->vector[1] && !st->a->vector[2];
+	NEXT;
+op_not_s:
+	st->c->_float = !st->a->string || !pr_strings[st->a->string];
+	NEXT;
+op_not_fnc:
+	st->c->_float = !st->a->function;
+	NEXT;
+op_not_ent:
+	st->c->_float = (PROG_TO_EDICT(st->a->edict) == sv.edicts);
+	NEXT;
+
+op_eq_f:
+	st->c->_float = st->a->_float == st->b->_float;
+	NEXT;
+op_eq_v:
+	st->c->_float = (st->a->vector[0] == st->b->vector[0]) &&
+				(st->a->vector[1] == st->b->vector[1]) &&
+				(st->a->vector[2] == st->b->vector[2]);
+	NEXT;
+op_eq_s:
+	st->c->_float = !strcmp(pr_strings+st->a->string,pr_strings+st->b->string);
+	NEXT;
+op_eq_e:
+	st->c->_float = st->a->_int == st->b->_int;
+	NEXT;
+op_eq_fnc:
+	st->c->_float = st->a->function == st->b->function;
+	NEXT;
+
+op_ne_f:
+	st->c->_float = st->a->_float != st->b->_float;
+	NEXT;
+op_ne_v:
+	st->c->_float = (st->a->vector[0] != st->b->vector[0]) ||
+				(st->a->vector[1] != st->b->vector[1]) ||
+				(st->a->vector[2] != st->b->vector[2]);
+	NEXT;
+op_ne_s:
+	st->c->_float = strcmp(pr_strings+st->a->string,pr_strings+st->b->string);
+	NEXT;
+op_ne_e:
+	st->c->_float = st->a->_int != st->b->_int;
+	NEXT;
+op_ne_fnc:
+	st->c->_float = st->a->function != st->b->function;
+	NEXT;
+
+//==================
+
+op_store:
+	st->b->_int = st->a->_int;
+	NEXT;
+op_store_v:
+	st->b->vector[0] = st->a->vector[0];
+	st->b->vector[1] = st->a->vector[1];
+	st->b->vector[2] = st->a->vector[2];
+	NEXT;
+
+op_storep:
+	ptr = (eval_t *)((byte *)sv.edicts + st->b->_int);
+	ptr->_int = st->a->_int;
+	NEXT;
+op_storep_v:
+	ptr = (eval_t *)((byte *)sv.edicts + st->b->_int);
+	ptr->vector[0] = st->a->vector[0];
+	ptr->vector[1] = st->a->vector[1];
+	ptr->vector[2] = st->a->vector[2];
+	NEXT;
+
+op_address:
+	ed = PROG_TO_EDICT(st->a->edict);
+#ifdef PARANOID
+	NUM_FOR_EDICT(ed);		// make sure it's in range
+#endif
+	if (ed == (edict_t *)sv.edicts && sv.state == ss_active)
+	{
+		SYNC;
+		PR_RunError ("assignment to world entity");
+	}
+	st->c->_int = (byte *)((int *)&ed->v + st->b->_int) - (byte *)sv.edicts;
+	ED_WAKE (ed);	// softquake
+	NEXT;
+
+op_load:
+	ed = PROG_TO_EDICT(st->a->edict);
+#ifdef PARANOID
+	NUM_FOR_EDICT(ed);		// make sure it's in range
+#endif
+	ptr = (eval_t *)((int *)&ed->v + st->b->_int);
+	st->c->_int = ptr->_int;
+	NEXT;
+op_load_v:
+	ed = PROG_TO_EDICT(st->a->edict);
+#ifdef PARANOID
+	NUM_FOR_EDICT(ed);		// make sure it's in range
+#endif
+	ptr = (eval_t *)((int *)&ed->v + st->b->_int);
+	st->c->vector[0] = ptr->vector[0];
+	st->c->vector[1] = ptr->vector[1];
+	st->c->vector[2] = ptr->vector[2];
+	NEXT;
+
+//==================
+
+op_ifnot:
+	if (!st->a->_int)
+		JUMP(st->jump);
+	NEXT;
+op_if:
+	if (st->a->_int)
+		JUMP(st->jump);
+	NEXT;
+op_goto:
+	JUMP(st->jump);
+
+op_call:
+	SYNC;
+	pr_argc = st->op - OP_CALL0;
+	if (!st->a->function)
+		PR_RunError ("NULL function");
+
+	newf = &pr_functions[st->a->function];
+
+	if (newf->first_statement < 0)
+	{	// negative statements are built in functions
+		i = -newf->first_statement;
+		if (i >= pr_numbuiltins)
+			PR_RunError ("Bad builtin call number");
+		pr_builtins[i] ();
+
+	// only builtins can turn the trace on or off
+		dispatch = pr_trace ? tracetable : optable;
+		RESUME(st + 1);
+	}
+
+	i = PR_EnterFunction (newf);
+	RESUME(pr_code + i + 1);
+
+op_return:
+	pr_globals[OFS_RETURN] = st->a->vector[0];
+	pr_globals[OFS_RETURN+1] = st->a->vector[1];
+	pr_globals[OFS_RETURN+2] = st->a->vector[2];
+
+	SYNC;
+	i = PR_LeaveFunction ();
+	if (pr_depth == exitdepth)
+		return;		// all done
+	RESUME(pr_code + i + 1);
+
+op_state:
+	ed = PROG_TO_EDICT(pr_global_struct->self);
+#ifdef FPS_20
+	ed->v.nextthink = pr_global_struct->time + 0.05;
+#else
+	ed->v.nextthink = pr_global_struct->time + 0.1;
+#endif
+	if (st->a->_float != ed->v.frame)
+	{
+		ed->v.frame = st->a->_float;
+	}
+	ed->v.think = st->b->function;
+	ED_WAKE (ed);	// softquake
+	NEXT;
+}
+
+#else
+
+void PR_ExecuteThreaded (dfunction_t *f)
+{
+	Sys_Error ("PR_ExecuteThreaded: not built");
+}
+
+#endif
@@ -111,6 +111,14 @@ int NUM_FOR_EDICT(edict_t *e);
 #define	E_VECTOR(e,o) (&((float*)&e->v)[o])
 #define	E_STRING(e,o) (pr_strings + *(string_t *)&((float*)&e->v)[o])
 
+// softquake -- NULL when the progs don't have the field, like GetEdictFieldValue
+#define	E_FIELDVALUE(e,o) ((o) < 0 ? NULL : (eval_t *)&((float*)&(e)->v)[o])
+
+// softquake -- has SV_Physics look at an edict again after something about it
+// changed, see SV_CheckIdle
+extern	byte	sv_edictidle[MAX_EDICTS];
+#define	ED_WAKE(e) (sv_edictidle[((byte *)(e) - (byte *)sv.edicts) / pr_edict_size] = 0)
+
 extern	int		type_size[8];
 
 typedef void (*builtin_t) (void);
@@ -127,8 +135,42 @@ extern	unsigned short		pr_crc;
 
 void PR_RunError (char *error, ...);
 
+// softquake -- pre-decoded interpreter, see pr_threaded.c
+typedef struct prcode_s
+{
+	int					op;
+	eval_t				*a, *b, *c;
+	struct prcode_s		*jump;		// IF, IFNOT and GOTO
+} prcode_t;
+
+extern	cvar_t		pr_threadedcode;
+extern	prcode_t	*pr_code;		// NULL if the progs can't be run that way
+extern	int			pr_depth;
+
+void PR_InitThreadedCode (void);
+void PR_BuildThreadedCode (void);
+void PR_ExecuteThreaded (dfunction_t *f);
+
+// softquake -- progs.dat translated to C, see pr_native.c
+typedef void (*prnative_t) (void);
+
+extern	cvar_t		pr_nativecode;
+extern	prnative_t	*pr_native;		// by function number, NULL if the progs weren't translated
+
+void PR_InitNative (void);
+void PR_LoadNativeProgs (void);
+void PR_ExecuteNative (dfunction_t *f, prnative_t func);
+
+int PR_EnterFunction (dfunction_t *f);
+int PR_LeaveFunction (void);
+void PR_PrintStatement (dstatement_t *s);
+
 void ED_PrintEdicts (void);
 void ED_PrintNum (int ent);
 
 eval_t *GetEdictFieldValue(edict_t *ed, char *field);
 
+// softquake -- field offsets found by PR_LoadProgs, -1 when the progs don't have them
+extern	int		pr_fielditems2;
+extern	int		pr_fieldgravity;
+
@@ -0,0 +1,405 @@
+// Translates progs.dat files into C for the engine to run natively
+// See Makefile.progtool and pr_native.c
+//
+// Usage: progtool <progs.dat> [<progs.dat> ...] > pr_progs.c
+//
+// Every QuakeC function becomes a C function made out of the N_ macros in
+// pr_native.h, one per statement, with labels for the branch targets.
+// Functions that can't be translated safely (branches that leave the
+// function, unknown opcodes, falling off the end) are left out, and the
+// engine interprets those as usual.
+// Assumes a little endian machine, same as the progs.dat format.
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef unsigned char byte;
+
+#include "pr_comp.h"
+
+
+typedef struct
+{
+	const char		*path;
+	byte			*data;
+	int				size;
+	unsigned short	crc;
+
+	dprograms_t		*progs;
+	dstatement_t	*statements;
+	dfunction_t		*functions;
+	char			*strings;
+
+	int				*last;		// per function, its last statement, or -1 if it's not translated
+	byte			*target;	// per statement, set if something branches to it
+} progsfile_t;
+
+static const char *opmacros[] =
+{
+	[OP_MUL_F] = "N_MUL_F",
+	[OP_MUL_V] = "N_MUL_V",
+	[OP_MUL_FV] = "N_MUL_FV",
+	[OP_MUL_VF] = "N_MUL_VF",
+	[OP_DIV_F] = "N_DIV_F",
+	[OP_ADD_F] = "N_ADD_F",
+	[OP_ADD_V] = "N_ADD_V",
+	[OP_SUB_F] = "N_SUB_F",
+	[OP_SUB_V] = "N_SUB_V",
+	[OP_EQ_F] = "N_EQ_F",
+	[OP_EQ_V] = "N_EQ_V",
+	[OP_EQ_S] = "N_EQ_S",
+	[OP_EQ_E] = "N_EQ_E",
+	[OP_EQ_FNC] = "N_EQ_FNC",
+	[OP_NE_F] = "N_NE_F",
+	[OP_NE_V] = "N_NE_V",
+	[OP_NE_S] = "N_NE_S",
+	[OP_NE_E] = "N_NE_E",
+	[OP_NE_FNC] = "N_NE_FNC",
+	[OP_LE] = "N_LE",
+	[OP_GE] = "N_GE",
+	[OP_LT] = "N_LT",
+	[OP_GT] = "N_GT",
+	[OP_LOAD_F] = "N_LOAD",
+	[OP_LOAD_V] = "N_LOAD_V",
+	[OP_LOAD_S] = "N_LOAD",
+	[OP_LOAD_ENT] = "N_LOAD",
+	[OP_LOAD_FLD] = "N_LOAD",
+	[OP_LOAD_FNC] = "N_LOAD",
+	[OP_AND] = "N_AND",
+	[OP_OR] = "N_OR",
+	[OP_BITAND] = "N_BITAND",
+	[OP_BITOR] = "N_BITOR",
+};
+
+
+void fail(const char *path, const char *msg)
+{
+	fprintf(stderr, "progtool: %s: %s\n", path, msg);
+	exit(1);
+}
+
+// Same crc as crc.c, a bit at a time
+unsigned short crc_block(const byte *data, int size)
+{
+	unsigned short crc = 0xffff;
+	int i, j;
+
+	for(i = 0; i < size; i++)
+	{
+		crc ^= data[i] << 8;
+		for(j = 0; j < 8; j++)
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+	return crc;
+}
+
+void load_progs(progsfile_t *p, const char *path)
+{
+	FILE *f;
+
+	p->path = path;
+	f = fopen(path, "rb");
+	if(!f)
+		fail(path, "couldn't open");
+
+	fseek(f, 0, SEEK_END);
+	p->size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	p->data = malloc(p->size);
+	if(!p->data || fread(p->data, 1, p->size, f) != (size_t)p->size)
+		fail(path, "couldn't read");
+	fclose(f);
+
+	if(p->size < (int)sizeof(dprograms_t))
+		fail(path, "too small");
+
+	p->crc = crc_block(p->data, p->size);
+
+	p->progs = (dprograms_t *)p->data;
+	if(p->progs->version != PROG_VERSION)
+		fail(path, "wrong version number");
+
+	p->statements = (dstatement_t *)(p->data + p->progs->ofs_statements);
+	p->functions = (dfunction_t *)(p->data + p->progs->ofs_functions);
+	p->strings = (char *)p->data + p->progs->ofs_strings;
+}
+
+int is_branch(int op)
+{
+	return op == OP_IF || op == OP_IFNOT || op == OP_GOTO;
+}
+
+int branch_target(dstatement_t *st, int s)
+{
+	return s + (st->op == OP_GOTO ? st->a : st->b);
+}
+
+// Works out where each function ends, and whether it can be translated
+void find_functions(progsfile_t *p)
+{
+	int numfunctions = p->progs->numfunctions;
+	int numstatements = p->progs->numstatements;
+	int i, j, s, first, last, next, t, op;
+
+	p->last = malloc(numfunctions * sizeof(int));
+	p->target = calloc(numstatements, 1);
+	if(!p->last || !p->target)
+		fail(p->path, "out of memory");
+
+	for(i = 0; i < numfunctions; i++)
+	{
+		p->last[i] = -1;
+
+		first = p->functions[i].first_statement;
+		if(i == 0 || first <= 0 || first >= numstatements)
+			continue;	// nothing, a builtin, or broken
+
+		// a function runs up to wherever the next one starts
+		next = numstatements;
+		for(j = 0; j < numfunctions; j++)
+		{
+			if(p->functions[j].first_statement > first && p->functions[j].first_statement < next)
+				next = p->functions[j].first_statement;
+		}
+		last = next - 1;
+
+		op = p->statements[last].op;
+		if(op != OP_DONE && op != OP_RETURN && op != OP_GOTO)
+			continue;
+
+		for(s = first; s <= last; s++)
+		{
+			op = p->statements[s].op;
+			if(op > OP_BITOR)
+				break;
+			if(is_branch(op))
+			{
+				t = branch_target(&p->statements[s], s);
+				if(t < first || t > last)
+					break;
+			}
+		}
+		if(s <= last)
+			continue;
+
+		for(s = first; s <= last; s++)
+		{
+			if(is_branch(p->statements[s].op))
+				p->target[branch_target(&p->statements[s], s)] = 1;
+		}
+		p->last[i] = last;
+	}
+}
+
+void print_name(progsfile_t *p, int string)
+{
+	const char *c;
+
+	if(string < 0 || string >= p->progs->numstrings)
+		return;
+
+	// only what's safe in a comment
+	for(c = p->strings + string; *c; c++)
+		putchar((*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || (*c >= '0' && *c <= '9')
+			|| *c == '_' || *c == '.' || *c == '-' ? *c : '?');
+}
+
+void emit_jump(dstatement_t *st, int s, int t, int cond)
+{
+	const char *indent = "\t";
+
+	if(cond)
+	{
+		printf("\tif (%sNG(%i)->_int)", st->op == OP_IFNOT ? "!" : "", st->a);
+		indent = "\t\t";
+	}
+
+	if(t > s)
+	{
+		printf(cond ? "\n%sgoto s%i;\n" : "%sgoto s%i;\n", indent, t);
+		return;
+	}
+
+	// backwards, so it might be a loop
+	if(cond)
+		printf("\n\t{\n");
+	printf("%sN_LOOP (%i, %i);\n", indent, s, s - t + 1);
+	printf("%sgoto s%i;\n", indent, t);
+	if(cond)
+		printf("\t}\n");
+}
+
+void emit_statement(progsfile_t *p, int s)
+{
+	dstatement_t *st = &p->statements[s];
+
+	switch(st->op)
+	{
+	case OP_DONE:
+	case OP_RETURN:
+		printf("\tN_RETURN (%i);\n", st->a);
+		break;
+
+	case OP_NOT_F:
+		printf("\tN_NOT_F (%i, %i);\n", st->a, st->c);
+		break;
+	case OP_NOT_V:
+		printf("\tN_NOT_V (%i, %i);\n", st->a, st->c);
+		break;
+	case OP_NOT_S:
+		printf("\tN_NOT_S (%i, %i);\n", st->a, st->c);
+		break;
+	case OP_NOT_ENT:
+		printf("\tN_NOT_ENT (%i, %i);\n", st->a, st->c);
+		break;
+	case OP_NOT_FNC:
+		printf("\tN_NOT_FNC (%i, %i);\n", st->a, st->c);
+		break;
+
+	case OP_STORE_F:
+	case OP_STORE_S:
+	case OP_STORE_ENT:
+	case OP_STORE_FLD:
+	case OP_STORE_FNC:
+		printf("\tN_STORE (%i, %i);\n", st->a, st->b);
+		break;
+	case OP_STORE_V:
+		printf("\tN_STORE_V (%i, %i);\n", st->a, st->b);
+		break;
+
+	case OP_STOREP_F:
+	case OP_STOREP_S:
+	case OP_STOREP_ENT:
+	case OP_STOREP_FLD:
+	case OP_STOREP_FNC:
+		printf("\tN_STOREP (%i, %i);\n", st->a, st->b);
+		break;
+	case OP_STOREP_V:
+		printf("\tN_STOREP_V (%i, %i);\n", st->a, st->b);
+		break;
+
+	case OP_ADDRESS:
+		printf("\tN_ADDRESS (%i, %i, %i, %i);\n", s, st->a, st->b, st->c);
+		break;
+
+	case OP_IF:
+	case OP_IFNOT:
+		emit_jump(st, s, s + st->b, 1);
+		break;
+	case OP_GOTO:
+		emit_jump(st, s, s + st->a, 0);
+		break;
+
+	case OP_CALL0:
+	case OP_CALL1:
+	case OP_CALL2:
+	case OP_CALL3:
+	case OP_CALL4:
+	case OP_CALL5:
+	case OP_CALL6:
+	case OP_CALL7:
+	case OP_CALL8:
+		printf("\tN_CALL (%i, %i, %i);\n", s, st->op - OP_CALL0, st->a);
+		break;
+
+	case OP_STATE:
+		printf("\tN_STATE (%i, %i);\n", st->a, st->b);
+		break;
+
+	default:
+		printf("\t%s (%i, %i, %i);\n", opmacros[st->op], st->a, st->b, st->c);
+		break;
+	}
+}
+
+void emit_progs(progsfile_t *p, int index)
+{
+	int numfunctions = p->progs->numfunctions;
+	int i, s, translated;
+
+	printf("\n\n// %s\n\n", p->path);
+
+	for(i = 0; i < numfunctions; i++)
+	{
+		if(p->last[i] >= 0)
+			printf("static void p%i_f%i (void);\n", index, i);
+	}
+
+	translated = 0;
+	for(i = 0; i < numfunctions; i++)
+	{
+		if(p->last[i] < 0)
+			continue;
+		translated++;
+
+		printf("\n// ");
+		print_name(p, p->functions[i].s_name);
+		printf(", ");
+		print_name(p, p->functions[i].s_file);
+		printf("\nstatic void p%i_f%i (void)\n{\n", index, i);
+
+		for(s = p->functions[i].first_statement; s <= p->last[i]; s++)
+		{
+			if(p->target[s])
+				printf("s%i:\n", s);
+			emit_statement(p, s);
+		}
+
+		printf("}\n");
+	}
+
+	printf("\nstatic prnative_t p%i_functions[%i] =\n{\n", index, numfunctions);
+	for(i = 0; i < numfunctions; i++)
+	{
+		if(p->last[i] >= 0)
+			printf("\tp%i_f%i,\n", index, i);
+		else
+			printf("\tNULL,\n");
+	}
+	printf("};\n");
+
+	printf("\nstatic prnativeprogs_t p%i_progs =\n{\n", index);
+	printf("\t0x%04x, %i, %i, %i, p%i_functions\n", p->crc, p->size,
+		p->progs->numstatements, numfunctions, index);
+	printf("};\n");
+
+	fprintf(stderr, "%s: translated %i of %i functions\n", p->path, translated, numfunctions);
+}
+
+int main(int argc, char **argv)
+{
+	progsfile_t *files;
+	int i;
+
+	if(argc < 2)
+	{
+		fprintf(stderr, "Usage: progtool <progs.dat> [<progs.dat> ...] > pr_progs.c\n");
+		return 1;
+	}
+
+	files = calloc(argc - 1, sizeof(progsfile_t));
+	if(!files)
+		fail("progtool", "out of memory");
+
+	printf("// Generated by progtool, don't edit\n");
+	printf("// Build with ENABLE_NATIVE_PROGS, see softquake-notes.txt\n\n");
+	printf("#include \"quakedef.h\"\n");
+	printf("#include \"pr_native.h\"\n");
+
+	for(i = 0; i < argc - 1; i++)
+	{
+		load_progs(&files[i], argv[i + 1]);
+		find_functions(&files[i]);
+		emit_progs(&files[i], i);
+	}
+
+	printf("\n\nprnativeprogs_t *pr_nativeprogs[] =\n{\n");
+	for(i = 0; i < argc - 1; i++)
+		printf("\t&p%i_progs,\n", i);
+	printf("\tNULL\n};\n");
+
+	return 0;
+}
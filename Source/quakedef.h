@@ -291,6 +291,7 @@ typedef struct
 #include "gl_texmgr.h"
 #endif
 #include "cvar_common.h"
+#include "jobs.h"
 
 
 //=============================================================================
@@ -24,6 +24,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "d_local.h"	// FIXME: shouldn't be needed (is needed for patch
 						// right now, but that should move)
 
+#ifdef SIMD_X86
+#include <emmintrin.h>
+#endif
+
 #define LIGHT_MIN	5		// lowest light value we'll allow, to avoid the
 							//  need for inner-loop light clamping
 
@@ -72,6 +76,45 @@ float	r_avertexnormals[NUMVERTEXNORMALS][3] = {
 #include "anorms.h"
 };
 
+// softquake -- transformed vertex cache
+//
+// Each entity that draws an alias model gets a slot holding the vertices as
+// they were last transformed, projected and lit, along with everything that
+// went into them. If none of it has changed since the last time, the vertices
+// are drawn straight from the slot. Anything standing still with the camera
+// standing still (intermissions, paused demos, idle monsters seen from a
+// parked camera) skips the vertex work entirely.
+cvar_t	r_aliascache = {"r_aliascache", "1", CV_ARCHIVE};
+
+#define ALIAS_CACHE_SLOTS	512		// power of two
+
+typedef struct
+{
+	model_t		*model;
+	trivertx_t	*verts;				// the frame being drawn
+	int			trivial_accept;
+	float		transform[3][4];	// origin, angles and view all end up in here
+	int			ambientlight;
+	float		shadelight;
+	vec3_t		lightvec;
+	float		ziscale;
+	float		xscale, yscale;
+	float		xcenter, ycenter;
+	int			vrect[4];			// alias vrect, for the clip flags
+} aliaskey_t;
+
+typedef struct
+{
+	qboolean	valid;
+	aliaskey_t	key;
+	int			maxverts;
+	finalvert_t	*finalverts;
+	auxvert_t	*auxverts;
+} aliascache_t;
+
+static aliascache_t	r_aliascacheslots[ALIAS_CACHE_SLOTS];
+static qboolean		r_aliasvertscached;	// pfinalverts are already done
+
 void R_AliasTransformAndProjectFinalVerts (finalvert_t *fv,
 	stvert_t *pstverts);
 void R_AliasSetUpTransform (int trivial_accept);
@@ -97,6 +140,7 @@ qboolean R_AliasCheckBBox (void)
 	qboolean			zclipped, zfullyclipped;
 	unsigned			anyclip, allclip;
 	int					minz;
+	float				left, top, right, bottom;
 	
 // expand, rotate, and translate points into worldspace
 
@@ -200,6 +244,9 @@ qboolean R_AliasCheckBBox (void)
 	anyclip = 0;
 	allclip = ALIAS_XY_CLIP_MASK;
 
+	left = top = 999999;
+	right = bottom = -999999;
+
 // TODO: probably should do this loop in ASM, especially if we use floats
 	for (i=0 ; i<numv ; i++)
 	{
@@ -226,11 +273,27 @@ qboolean R_AliasCheckBBox (void)
 
 		anyclip |= flags;
 		allclip &= flags;
+
+		if (v0 < left)
+			left = v0;
+		if (v0 > right)
+			right = v0;
+		if (v1 < top)
+			top = v1;
+		if (v1 > bottom)
+			bottom = v1;
 	}
 
 	if (allclip)
 		return false;	// trivial reject off one side
 
+// softquake -- or hidden behind the world
+	if (!zclipped && R_OccludedByWorld (left, top, right, bottom, minz))
+	{
+		r_amodels_occluded++;
+		return false;
+	}
+
 	currententity->trivial_accept = !anyclip & !zclipped;
 
 	if (currententity->trivial_accept)
@@ -279,23 +342,27 @@ void R_AliasPreparePoints (void)
  	fv = pfinalverts;
 	av = pauxverts;
 
-	for (i=0 ; i<r_anumverts ; i++, fv++, av++, r_apverts++, pstverts++)
+// softquake -- nothing to do if they're still in the cache from last time
+	if (!r_aliasvertscached)
 	{
-		R_AliasTransformFinalVert (fv, av, r_apverts, pstverts);
-		if (av->fv[2] < ALIAS_Z_CLIP_PLANE)
-			fv->flags |= ALIAS_Z_CLIP;
-		else
+		for (i=0 ; i<r_anumverts ; i++, fv++, av++, r_apverts++, pstverts++)
 		{
-			 R_AliasProjectFinalVert (fv, av);
-
-			if (fv->v[0] < r_refdef.aliasvrect.x)
-				fv->flags |= ALIAS_LEFT_CLIP;
-			if (fv->v[1] < r_refdef.aliasvrect.y)
-				fv->flags |= ALIAS_TOP_CLIP;
-			if (fv->v[0] > r_refdef.aliasvrectright)
-				fv->flags |= ALIAS_RIGHT_CLIP;
-			if (fv->v[1] > r_refdef.aliasvrectbottom)
-				fv->flags |= ALIAS_BOTTOM_CLIP;	
+			R_AliasTransformFinalVert (fv, av, r_apverts, pstverts);
+			if (av->fv[2] < ALIAS_Z_CLIP_PLANE)
+				fv->flags |= ALIAS_Z_CLIP;
+			else
+			{
+				 R_AliasProjectFinalVert (fv, av);
+
+				if (fv->v[0] < r_refdef.aliasvrect.x)
+					fv->flags |= ALIAS_LEFT_CLIP;
+				if (fv->v[1] < r_refdef.aliasvrect.y)
+					fv->flags |= ALIAS_TOP_CLIP;
+				if (fv->v[0] > r_refdef.aliasvrectright)
+					fv->flags |= ALIAS_RIGHT_CLIP;
+				if (fv->v[1] > r_refdef.aliasvrectbottom)
+					fv->flags |= ALIAS_BOTTOM_CLIP;	
+			}
 		}
 	}
 
@@ -506,6 +573,151 @@ void R_AliasTransformAndProjectFinalVerts (finalvert_t *fv, stvert_t *pstverts)
 #endif
 
 
+#if	!id386 && defined SIMD_X86
+
+/*
+================
+R_AliasLightLevels
+
+Works out the light for every vertex normal, the same way as
+R_AliasTransformFinalVert does per vertex
+================
+*/
+static void R_AliasLightLevels (int *levels)
+{
+	int		i, temp;
+	float	lightcos, *plightnormal;
+
+	for (i=0 ; i<256 ; i++)
+	{
+		if (i >= NUMVERTEXNORMALS)
+		{
+			levels[i] = r_ambientlight;
+			continue;
+		}
+
+		plightnormal = r_avertexnormals[i];
+		lightcos = DotProduct (plightnormal, r_plightvec);
+		temp = r_ambientlight;
+
+		if (lightcos < 0)
+		{
+			temp += (int)(r_shadelight * lightcos);
+			if (temp < 0)
+				temp = 0;
+		}
+
+		levels[i] = temp;
+	}
+}
+
+
+/*
+================
+R_AliasTransformAndProjectFinalVertsSSE2
+
+Same as R_AliasTransformAndProjectFinalVerts, four vertices at a time. The
+vertices are unpacked into one register per coordinate, and the lighting is
+looked up per normal instead of being worked out per vertex.
+================
+*/
+TARGET_SSE2
+static void R_AliasTransformAndProjectFinalVertsSSE2 (finalvert_t *fv, stvert_t *pstverts)
+{
+	int			i, k;
+	int			levels[256];
+	int			normals[4];
+	trivertx_t	*pverts;
+	__m128		m[3][4], xcenter, ycenter, x, y, z, zi, d0, d1;
+	__m128i		raw, bytemask, r[4], t[4];
+
+	R_AliasLightLevels (levels);
+
+	for (i=0 ; i<3 ; i++)
+		for (k=0 ; k<4 ; k++)
+			m[i][k] = _mm_set1_ps (aliastransform[i][k]);
+	xcenter = _mm_set1_ps (aliasxcenter);
+	ycenter = _mm_set1_ps (aliasycenter);
+	bytemask = _mm_set1_epi32 (0xFF);
+
+	pverts = r_apverts;
+
+	for (i=0 ; i + 4 <= r_anumverts ; i += 4, fv += 4, pverts += 4, pstverts += 4)
+	{
+	// trivertx_t is four bytes, so this is four whole vertices
+		raw = _mm_loadu_si128 ((__m128i *)pverts);
+		x = _mm_cvtepi32_ps (_mm_and_si128 (raw, bytemask));
+		y = _mm_cvtepi32_ps (_mm_and_si128 (_mm_srli_epi32 (raw, 8), bytemask));
+		z = _mm_cvtepi32_ps (_mm_and_si128 (_mm_srli_epi32 (raw, 16), bytemask));
+		_mm_storeu_si128 ((__m128i *)normals, _mm_srli_epi32 (raw, 24));
+
+	// same order of operations as DotProduct
+		zi = _mm_add_ps (_mm_add_ps (_mm_add_ps (_mm_mul_ps (x, m[2][0]),
+				_mm_mul_ps (y, m[2][1])), _mm_mul_ps (z, m[2][2])), m[2][3]);
+		zi = _mm_div_ps (_mm_set1_ps (1.0f), zi);
+
+		d0 = _mm_add_ps (_mm_add_ps (_mm_add_ps (_mm_mul_ps (x, m[0][0]),
+				_mm_mul_ps (y, m[0][1])), _mm_mul_ps (z, m[0][2])), m[0][3]);
+		d1 = _mm_add_ps (_mm_add_ps (_mm_add_ps (_mm_mul_ps (x, m[1][0]),
+				_mm_mul_ps (y, m[1][1])), _mm_mul_ps (z, m[1][2])), m[1][3]);
+
+	// fields 0-3 of the four finalverts
+		r[0] = _mm_cvttps_epi32 (_mm_add_ps (_mm_mul_ps (d0, zi), xcenter));
+		r[1] = _mm_cvttps_epi32 (_mm_add_ps (_mm_mul_ps (d1, zi), ycenter));
+		r[2] = _mm_setr_epi32 (pstverts[0].s, pstverts[1].s, pstverts[2].s, pstverts[3].s);
+		r[3] = _mm_setr_epi32 (pstverts[0].t, pstverts[1].t, pstverts[2].t, pstverts[3].t);
+
+		t[0] = _mm_unpacklo_epi32 (r[0], r[1]);
+		t[1] = _mm_unpacklo_epi32 (r[2], r[3]);
+		t[2] = _mm_unpackhi_epi32 (r[0], r[1]);
+		t[3] = _mm_unpackhi_epi32 (r[2], r[3]);
+		_mm_storeu_si128 ((__m128i *)&fv[0].v[0], _mm_unpacklo_epi64 (t[0], t[1]));
+		_mm_storeu_si128 ((__m128i *)&fv[1].v[0], _mm_unpackhi_epi64 (t[0], t[1]));
+		_mm_storeu_si128 ((__m128i *)&fv[2].v[0], _mm_unpacklo_epi64 (t[2], t[3]));
+		_mm_storeu_si128 ((__m128i *)&fv[3].v[0], _mm_unpackhi_epi64 (t[2], t[3]));
+
+	// and the rest: light, 1/z, flags and the unused one
+		r[0] = _mm_setr_epi32 (levels[normals[0]], levels[normals[1]],
+				levels[normals[2]], levels[normals[3]]);
+		r[1] = _mm_cvttps_epi32 (zi);
+		r[2] = _mm_setr_epi32 (pstverts[0].onseam, pstverts[1].onseam,
+				pstverts[2].onseam, pstverts[3].onseam);
+		r[3] = _mm_setzero_si128 ();
+
+		t[0] = _mm_unpacklo_epi32 (r[0], r[1]);
+		t[1] = _mm_unpacklo_epi32 (r[2], r[3]);
+		t[2] = _mm_unpackhi_epi32 (r[0], r[1]);
+		t[3] = _mm_unpackhi_epi32 (r[2], r[3]);
+		_mm_storeu_si128 ((__m128i *)&fv[0].v[4], _mm_unpacklo_epi64 (t[0], t[1]));
+		_mm_storeu_si128 ((__m128i *)&fv[1].v[4], _mm_unpackhi_epi64 (t[0], t[1]));
+		_mm_storeu_si128 ((__m128i *)&fv[2].v[4], _mm_unpacklo_epi64 (t[2], t[3]));
+		_mm_storeu_si128 ((__m128i *)&fv[3].v[4], _mm_unpackhi_epi64 (t[2], t[3]));
+	}
+
+// the last few one at a time
+	for ( ; i<r_anumverts ; i++, fv++, pverts++, pstverts++)
+	{
+		float	fzi;
+
+		fzi = 1.0 / (DotProduct(pverts->v, aliastransform[2]) +
+				aliastransform[2][3]);
+
+		fv->v[5] = fzi;
+		fv->v[0] = ((DotProduct(pverts->v, aliastransform[0]) +
+				aliastransform[0][3]) * fzi) + aliasxcenter;
+		fv->v[1] = ((DotProduct(pverts->v, aliastransform[1]) +
+				aliastransform[1][3]) * fzi) + aliasycenter;
+
+		fv->v[2] = pstverts->s;
+		fv->v[3] = pstverts->t;
+		fv->flags = pstverts->onseam;
+		fv->v[4] = levels[pverts->lightnormalindex];
+	}
+}
+
+#endif	// !id386 && SIMD_X86
+
+
 /*
 ================
 R_AliasProjectFinalVert
@@ -540,7 +752,15 @@ void R_AliasPrepareUnclippedPoints (void)
 // FIXME: just use pfinalverts directly?
 	fv = pfinalverts;
 
-	R_AliasTransformAndProjectFinalVerts (fv, pstverts);
+	if (!r_aliasvertscached)
+	{
+#if	!id386 && defined SIMD_X86
+		if (d_simd.value && cpu_sse2)
+			R_AliasTransformAndProjectFinalVertsSSE2 (fv, pstverts);
+		else
+#endif
+			R_AliasTransformAndProjectFinalVerts (fv, pstverts);
+	}
 
 	if (r_affinetridesc.drawtype)
 		D_PolysetDrawFinalVerts (fv, r_anumverts);
@@ -695,6 +915,82 @@ void R_AliasSetupFrame (void)
 }
 
 
+/*
+================
+R_InitAliasCache
+================
+*/
+void R_InitAliasCache (void)
+{
+	Cvar_RegisterVariable (&r_aliascache);
+}
+
+
+/*
+================
+R_AliasCacheVerts
+
+Points pfinalverts and pauxverts at the current entity's cache slot, and sets
+r_aliasvertscached if they already hold what this frame would put there.
+Returns false if the cache is turned off.
+================
+*/
+static qboolean R_AliasCacheVerts (void)
+{
+	aliaskey_t		key;
+	aliascache_t	*cache;
+
+	if (!r_aliascache.value)
+		return false;
+
+	memset (&key, 0, sizeof(key));		// no stray padding for memcmp
+	key.model = currententity->model;
+	key.verts = r_apverts;
+	key.trivial_accept = currententity->trivial_accept;
+	memcpy (key.transform, aliastransform, sizeof(key.transform));
+	key.ambientlight = r_ambientlight;
+	key.shadelight = r_shadelight;
+	VectorCopy (r_plightvec, key.lightvec);
+	key.ziscale = ziscale;
+	key.xscale = aliasxscale;
+	key.yscale = aliasyscale;
+	key.xcenter = aliasxcenter;
+	key.ycenter = aliasycenter;
+	key.vrect[0] = r_refdef.aliasvrect.x;
+	key.vrect[1] = r_refdef.aliasvrect.y;
+	key.vrect[2] = r_refdef.aliasvrectright;
+	key.vrect[3] = r_refdef.aliasvrectbottom;
+
+// entities mostly live in arrays, so neighbours get neighbouring slots
+	cache = &r_aliascacheslots[((size_t)currententity / sizeof(entity_t)) &
+			(ALIAS_CACHE_SLOTS - 1)];
+
+	if (cache->maxverts < pmdl->numverts)
+	{
+		free (cache->finalverts);
+		free (cache->auxverts);
+
+		cache->maxverts = pmdl->numverts;
+		cache->finalverts = calloc (cache->maxverts, sizeof(finalvert_t));
+		cache->auxverts = calloc (cache->maxverts, sizeof(auxvert_t));
+		if (!cache->finalverts || !cache->auxverts)
+			Sys_Error ("R_AliasCacheVerts: out of memory");
+
+		cache->valid = false;
+	}
+
+	r_aliasvertscached = cache->valid && !memcmp (&cache->key, &key, sizeof(key));
+
+	cache->valid = true;
+	cache->key = key;
+
+	pfinalverts = cache->finalverts;
+	pauxverts = cache->auxverts;
+
+	return true;
+}
+
+
 /*
 ================
 R_AliasDrawModel
@@ -706,16 +1002,8 @@ void R_AliasDrawModel (alight_t *plighting)
 						((CACHE_SIZE - 1) / sizeof(finalvert_t)) + 1];
 	auxvert_t		auxverts[MAXALIASVERTS];
 
-	// softquake -- valgrind fix (uninitialised variable)
-	memset (finalverts, 0, sizeof(finalverts));
-
 	r_amodels_drawn++;
 
-// cache align
-	pfinalverts = (finalvert_t *)
-			(((long)&finalverts[0] + CACHE_SIZE - 1) & ~(CACHE_SIZE - 1));
-	pauxverts = &auxverts[0];
-
 	paliashdr = (aliashdr_t *)Mod_Extradata (currententity->model);
 	pmdl = (mdl_t *)((byte *)paliashdr + paliashdr->model);
 
@@ -748,6 +1036,19 @@ void R_AliasDrawModel (alight_t *plighting)
 	else
 		ziscale = (float)0x8000 * (float)0x10000 * 3.0;
 
+	r_aliasvertscached = false;
+
+	if (!R_AliasCacheVerts ())
+	{
+		// softquake -- valgrind fix (uninitialised variable)
+		memset (finalverts, 0, sizeof(finalverts));
+
+	// cache align
+		pfinalverts = (finalvert_t *)
+				(((long)&finalverts[0] + CACHE_SIZE - 1) & ~(CACHE_SIZE - 1));
+		pauxverts = &auxverts[0];
+	}
+
 	if (currententity->trivial_accept)
 		R_AliasPrepareUnclippedPoints ();
 	else
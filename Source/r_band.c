@@ -0,0 +1,469 @@
+/*
+Copyright (C) 2023-2023 softquake
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+// r_band.c -- multithreaded edge scanning and span drawing
+
+// The screen is split into horizontal bands, and each band is scanned and
+// drawn by whichever worker thread gets to it first.
+//
+// Every band works on its own copy of the edges and surfaces, and keeps all of
+// its spans around instead of flushing them, so the bands never touch each
+// other's memory.
+//
+// The active edge table at the top of each band depends on every scan line
+// above it, so it is worked out up front on the main thread. This is a lot
+// cheaper than generating the spans, but it doesn't go away with more threads.
+//
+// Surface setup (surface cache, bmodel transforms, sky) stays on the main
+// thread and happens once per surface before any band is drawn. Each pixel
+// still belongs to exactly one span with the same gradients as the single
+// threaded path, so the output is identical.
+
+#include "quakedef.h"
+#include "r_local.h"
+#include "d_local.h"
+
+cvar_t	r_bands = {"r_bands", "0", CV_ARCHIVE};
+
+#define MAX_BANDS	32
+
+typedef struct
+{
+	int			edge;		// index into r_edges
+	fixed16_t	u;
+} bandedge_t;
+
+typedef struct
+{
+	int			top, bottom;	// scan lines [top, bottom)
+
+	edge_t		*edges;			// private copy of r_edges
+	int			maxedges;
+	surf_t		*surfs;			// private copy of surfaces[1] onwards
+	int			maxsurfs;
+
+	bandedge_t	*active;		// active edge table at the top of the band
+	int			numactive;
+	int			maxactive;
+
+	edge_t		*newedges[MAXHEIGHT];
+	edge_t		*removeedges[MAXHEIGHT];
+
+	espan_t		**spanblocks;	// MAXSPANS each, kept between frames
+	int			numspanblocks;
+	int			maxspanblocks;
+	int			spanblock;		// next one to hand out
+} band_t;
+
+static band_t		r_bandlist[MAX_BANDS];
+static int			r_numbands;
+
+static THREAD_LOCAL band_t	*r_currentband;
+
+// surfaces and edges as left by R_RenderWorld and R_DrawBEntitiesOnList
+static surf_t		*r_basesurfaces;
+static int			r_numbasesurfs;		// not counting the dummy
+static int			r_numbaseedges;
+
+// scratch copy for working out the active edge tables
+static edge_t		*r_stepedges;
+static int			r_maxstepedges;
+static edge_t		*r_stepnewedges[MAXHEIGHT];
+static edge_t		*r_stepremoveedges[MAXHEIGHT];
+
+static surfsetup_t	*r_bandsetups;
+static int			r_maxbandsetups;
+
+
+/*
+================
+R_InitBands
+================
+*/
+void R_InitBands (void)
+{
+	Cvar_RegisterVariable (&r_bands);
+}
+
+
+/*
+================
+R_BandAlloc
+
+Makes sure buf has room for at least count elements
+================
+*/
+static void *R_BandAlloc (void *buf, int *max, int count, int size)
+{
+	if (count <= *max)
+		return buf;
+
+	free (buf);
+
+	count += count / 2;		// leave room to grow
+	buf = malloc (count * size);
+	if (!buf)
+		Sys_Error ("R_BandAlloc: failed on %i bytes", count * size);
+
+	*max = count;
+	return buf;
+}
+
+
+/*
+================
+R_CopyEdges
+
+Copies r_edges to dest, along with the new and remove lists for the scan lines
+[top, bottom), with all of the links pointing into dest
+================
+*/
+static void R_CopyEdges (edge_t *dest, edge_t **newedge, edge_t **removeedge,
+		int top, int bottom)
+{
+	int		i, iv;
+	edge_t	*in, *out;
+
+	memcpy (dest, r_edges, r_numbaseedges * sizeof(edge_t));
+
+	in = r_edges;
+	out = dest;
+	for (i=0 ; i<r_numbaseedges ; i++, in++, out++)
+	{
+		if (in->next)
+			out->next = dest + (in->next - r_edges);
+		if (in->nextremove)
+			out->nextremove = dest + (in->nextremove - r_edges);
+	}
+
+	for (iv=top ; iv<bottom ; iv++)
+	{
+		newedge[iv] = newedges[iv] ? dest + (newedges[iv] - r_edges) : NULL;
+		removeedge[iv] = removeedges[iv] ? dest + (removeedges[iv] - r_edges) : NULL;
+	}
+}
+
+
+/*
+================
+R_SaveActiveEdges
+================
+*/
+static void R_SaveActiveEdges (band_t *band)
+{
+	edge_t		*edge;
+	bandedge_t	*out;
+	int			count;
+
+	count = 0;
+	for (edge=edge_head.next ; edge != &edge_tail ; edge=edge->next)
+		count++;
+
+	band->active = R_BandAlloc (band->active, &band->maxactive, count, sizeof(bandedge_t));
+	band->numactive = count;
+
+	out = band->active;
+	for (edge=edge_head.next ; edge != &edge_tail ; edge=edge->next, out++)
+	{
+		out->edge = edge - r_stepedges;
+		out->u = edge->u;
+	}
+}
+
+
+/*
+================
+R_RestoreActiveEdges
+================
+*/
+static void R_RestoreActiveEdges (band_t *band)
+{
+	edge_t		*edge, *prev;
+	bandedge_t	*in;
+	int			i;
+
+	R_ClearActiveEdges ();
+
+	prev = &edge_head;
+	in = band->active;
+	for (i=0 ; i<band->numactive ; i++, in++)
+	{
+		edge = &band->edges[in->edge];
+		edge->u = in->u;
+		edge->prev = prev;
+		prev->next = edge;
+		prev = edge;
+	}
+
+	prev->next = &edge_tail;
+	edge_tail.prev = prev;
+}
+
+
+/*
+================
+R_BandSpanOverflow
+
+Called by R_ScanBandEdges when the current span block is close to full
+================
+*/
+void R_BandSpanOverflow (void)
+{
+	band_t	*band;
+	espan_t	*block;
+
+	band = r_currentband;
+
+	if (band->spanblock == band->numspanblocks)
+	{
+		if (band->numspanblocks == band->maxspanblocks)
+		{
+			band->maxspanblocks += 16;
+			band->spanblocks = realloc (band->spanblocks,
+					band->maxspanblocks * sizeof(*band->spanblocks));
+			if (!band->spanblocks)
+				Sys_Error ("R_BandSpanOverflow: out of memory");
+		}
+
+		block = malloc (MAXSPANS * sizeof(espan_t));
+		if (!block)
+			Sys_Error ("R_BandSpanOverflow: out of memory");
+
+		band->spanblocks[band->numspanblocks++] = block;
+	}
+
+	block = band->spanblocks[band->spanblock++];
+
+	span_p = block;
+	max_span_p = &block[MAXSPANS - r_refdef.vrect.width];
+}
+
+
+/*
+================
+R_ScanBand
+================
+*/
+static void R_ScanBand (void *data, int index)
+{
+	band_t	*band;
+	surf_t	*savesurfaces;
+
+	band = &r_bandlist[index];
+	r_currentband = band;
+
+// the main thread helps out too, so put its surfaces back when done
+	savesurfaces = surfaces;
+
+	R_CopyEdges (band->edges, band->newedges, band->removeedges,
+			band->top, band->bottom);
+
+	memcpy (band->surfs, &r_basesurfaces[1], r_numbasesurfs * sizeof(surf_t));
+	surfaces = band->surfs - 1;
+
+	R_RestoreActiveEdges (band);
+
+	band->spanblock = 0;
+	R_BandSpanOverflow ();
+
+	R_ScanBandEdges (band->newedges, band->removeedges, band->top, band->bottom);
+
+	surfaces = savesurfaces;
+	r_currentband = NULL;
+}
+
+
+/*
+================
+R_DrawBand
+================
+*/
+static void R_DrawBand (void *data, int index)
+{
+	band_t	*band;
+	surf_t	*s;
+	int		i;
+
+	band = &r_bandlist[index];
+
+	for (i=0, s=band->surfs ; i<r_numbasesurfs ; i++, s++)
+	{
+		if (s->spans)
+			D_DrawSurface (s, &r_bandsetups[i]);
+	}
+}
+
+
+/*
+================
+R_SetupBandSurfaces
+
+Sets up every surface that ended up with spans in any band.
+Returns false if the surface cache had to throw out something set up earlier.
+================
+*/
+static qboolean R_SetupBandSurfaces (void)
+{
+	int			i, b;
+	surfsetup_t	*ss;
+
+	D_BeginSurfaces ();
+
+	for (i=0, ss=r_bandsetups ; i<r_numbasesurfs ; i++, ss++)
+	{
+		for (b=0 ; b<r_numbands ; b++)
+		{
+			if (r_bandlist[b].surfs[i].spans)
+				break;
+		}
+
+		if (b == r_numbands)
+		{
+			ss->type = ss_none;
+			ss->cachespot = NULL;
+			continue;
+		}
+
+		D_SetupSurface (&r_basesurfaces[i+1], ss);
+	}
+
+	for (i=0, ss=r_bandsetups ; i<r_numbasesurfs ; i++, ss++)
+	{
+		if (!ss->cachespot)
+			continue;
+
+		if (!*ss->cachespot || (pixel_t *)(*ss->cachespot)->data != ss->cacheblock)
+			return false;
+	}
+
+	return true;
+}
+
+
+/*
+================
+R_DrawBandsInOrder
+
+Fallback for when the surface cache is too small to hold everything on screen.
+Same as D_DrawSurfaces, one band at a time.
+================
+*/
+static void R_DrawBandsInOrder (void)
+{
+	int			i, b;
+	surf_t		*s;
+	surfsetup_t	ss;
+
+	D_BeginSurfaces ();
+
+	for (b=0 ; b<r_numbands ; b++)
+	{
+		for (i=0, s=r_bandlist[b].surfs ; i<r_numbasesurfs ; i++, s++)
+		{
+			if (!s->spans)
+				continue;
+
+			D_SetupSurface (&r_basesurfaces[i+1], &ss);
+			D_DrawSurface (s, &ss);
+		}
+	}
+}
+
+
+/*
+================
+R_ScanBands
+
+Replacement for R_ScanEdges
+Returns false if banding is turned off
+================
+*/
+qboolean R_ScanBands (void)
+{
+	int		b, count, height;
+	band_t	*band;
+
+	count = (int)r_bands.value;
+	if (count > MAX_BANDS)
+		count = MAX_BANDS;
+	height = r_refdef.vrectbottom - r_refdef.vrect.y;
+	if (count > height)
+		count = height;
+	if (count < 2)
+		return false;
+
+	r_numbands = count;
+	r_basesurfaces = surfaces;
+	r_numbasesurfs = surface_p - &surfaces[1];
+	r_numbaseedges = edge_p - r_edges;
+
+	for (b=0 ; b<r_numbands ; b++)
+	{
+		band = &r_bandlist[b];
+		band->top = r_refdef.vrect.y + height * b / r_numbands;
+		band->bottom = r_refdef.vrect.y + height * (b + 1) / r_numbands;
+
+		band->edges = R_BandAlloc (band->edges, &band->maxedges,
+				r_numbaseedges, sizeof(edge_t));
+		band->surfs = R_BandAlloc (band->surfs, &band->maxsurfs,
+				r_numbasesurfs, sizeof(surf_t));
+	}
+
+	r_bandsetups = R_BandAlloc (r_bandsetups, &r_maxbandsetups,
+			r_numbasesurfs, sizeof(surfsetup_t));
+
+//
+// walk the edges down the whole screen once to find out what the active edge
+// table looks like at the top of each band
+//
+	r_stepedges = R_BandAlloc (r_stepedges, &r_maxstepedges,
+			r_numbaseedges, sizeof(edge_t));
+	R_CopyEdges (r_stepedges, r_stepnewedges, r_stepremoveedges,
+			r_refdef.vrect.y, r_refdef.vrectbottom);
+
+	R_ClearActiveEdges ();
+	r_bandlist[0].numactive = 0;
+
+	for (b=1 ; b<r_numbands ; b++)
+	{
+		R_StepEdges (r_stepnewedges, r_stepremoveedges,
+				r_bandlist[b-1].top, r_bandlist[b].top);
+		R_SaveActiveEdges (&r_bandlist[b]);
+	}
+
+//
+// generate the spans
+//
+	Jobs_Run (R_ScanBand, NULL, r_numbands);
+
+//
+// draw them
+//
+	if (R_SetupBandSurfaces ())
+	{
+		Jobs_Run (R_DrawBand, NULL, r_numbands);
+	}
+	else
+	{
+		R_DrawBandsInOrder ();
+	}
+
+	return true;
+}
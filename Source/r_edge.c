@@ -37,7 +37,10 @@ have a sentinal at both ends?
 edge_t	*auxedges;
 edge_t	*r_edges, *edge_p, *edge_max;
 
-surf_t	*surfaces, *surface_p, *surf_max;
+// softquake -- Scanning state is per thread, so bands can be scanned at the
+// same time. See r_band.c
+THREAD_LOCAL surf_t	*surfaces;
+surf_t	*surface_p, *surf_max;
 
 // surfaces are generated in back to front order by the bsp, so if a surf
 // pointer is greater than another one, it should be drawn in front
@@ -46,24 +49,24 @@ surf_t	*surfaces, *surface_p, *surf_max;
 edge_t	*newedges[MAXHEIGHT];
 edge_t	*removeedges[MAXHEIGHT];
 
-espan_t	*span_p, *max_span_p;
+THREAD_LOCAL espan_t	*span_p, *max_span_p;
 
 int		r_currentkey;
 
 extern	int	screenwidth;
 
-int	current_iv;
+THREAD_LOCAL int	current_iv;
 
-int	edge_head_u_shift20, edge_tail_u_shift20;
+THREAD_LOCAL int	edge_head_u_shift20, edge_tail_u_shift20;
 
 static void (*pdrawfunc)(void);
 
-edge_t	edge_head;
-edge_t	edge_tail;
-edge_t	edge_aftertail;
-edge_t	edge_sentinel;
+THREAD_LOCAL edge_t	edge_head;
+THREAD_LOCAL edge_t	edge_tail;
+THREAD_LOCAL edge_t	edge_aftertail;
+THREAD_LOCAL edge_t	edge_sentinel;
 
-float	fv;
+THREAD_LOCAL float	fv;
 
 void R_GenerateSpans (void);
 void R_GenerateSpansBackward (void);
@@ -651,29 +654,13 @@ void R_GenerateSpansBackward (void)
 
 /*
 ==============
-R_ScanEdges
-
-Input: 
-newedges[] array
-	this has links to edges, which have links to surfaces
+R_ClearActiveEdges
 
-Output:
-Each surface has a linked list of its visible spans
+softquake -- Split out of R_ScanEdges so bands can share it
 ==============
 */
-void R_ScanEdges (void)
+void R_ClearActiveEdges (void)
 {
-	int		iv, bottom;
-	byte	basespans[MAXSPANS*sizeof(espan_t)+CACHE_SIZE];
-	espan_t	*basespan_p;
-	surf_t	*s;
-
-	basespan_p = (espan_t *)
-			((long)(basespans + CACHE_SIZE - 1) & ~(CACHE_SIZE - 1));
-	max_span_p = &basespan_p[MAXSPANS - r_refdef.vrect.width];
-
-	span_p = basespan_p;
-
 // clear active edges to just the background edges around the whole screen
 // FIXME: most of this only needs to be set up once
 	edge_head.u = r_refdef.vrect.x << 20;
@@ -705,6 +692,35 @@ void R_ScanEdges (void)
 	edge_sentinel.u = 0xd0000000;
 
 	edge_sentinel.prev = &edge_aftertail;
+}
+
+
+/*
+==============
+R_ScanEdges
+
+Input: 
+newedges[] array
+	this has links to edges, which have links to surfaces
+
+Output:
+Each surface has a linked list of its visible spans
+==============
+*/
+void R_ScanEdges (void)
+{
+	int		iv, bottom;
+	byte	basespans[MAXSPANS*sizeof(espan_t)+CACHE_SIZE];
+	espan_t	*basespan_p;
+	surf_t	*s;
+
+	basespan_p = (espan_t *)
+			((long)(basespans + CACHE_SIZE - 1) & ~(CACHE_SIZE - 1));
+	max_span_p = &basespan_p[MAXSPANS - r_refdef.vrect.width];
+
+	span_p = basespan_p;
+
+	R_ClearActiveEdges ();
 
 //	
 // process all scan lines
@@ -778,3 +794,72 @@ void R_ScanEdges (void)
 }
 
 
+/*
+==============
+R_StepEdges
+
+softquake -- Walks the active edge table down from scan line top to bottom,
+without generating any spans. Used to find out what the table looks like at the
+top of each band.
+==============
+*/
+void R_StepEdges (edge_t **newedge, edge_t **removeedge, int top, int bottom)
+{
+	int		iv;
+
+	for (iv=top ; iv<bottom ; iv++)
+	{
+		if (newedge[iv])
+			R_InsertNewEdges (newedge[iv], edge_head.next);
+
+		if (removeedge[iv])
+			R_RemoveEdges (removeedge[iv]);
+
+		if (edge_head.next != &edge_tail)
+			R_StepActiveU (edge_head.next);
+	}
+}
+
+
+/*
+==============
+R_ScanBandEdges
+
+softquake -- R_ScanEdges for the scan lines [top, bottom) only.
+The active edge table must already be set up for scan line top.
+Spans are never flushed here; R_BandSpanOverflow hands out more room instead.
+==============
+*/
+void R_ScanBandEdges (edge_t **newedge, edge_t **removeedge, int top, int bottom)
+{
+	int		iv, last;
+
+	last = r_refdef.vrectbottom - 1;
+
+	for (iv=top ; iv<bottom ; iv++)
+	{
+		current_iv = iv;
+		fv = (float)iv;
+
+	// mark that the head (background start) span is pre-included
+		surfaces[1].spanstate = 1;
+
+		if (newedge[iv])
+			R_InsertNewEdges (newedge[iv], edge_head.next);
+
+		(*pdrawfunc) ();
+
+	// no need to step or sort or remove on the last scan
+		if (iv == last)
+			break;
+
+		if (span_p >= max_span_p)
+			R_BandSpanOverflow ();
+
+		if (removeedge[iv])
+			R_RemoveEdges (removeedge[iv]);
+
+		if (edge_head.next != &edge_tail)
+			R_StepActiveU (edge_head.next);
+	}
+}
@@ -140,6 +140,7 @@ void R_SetSkyFrame (void);
 void R_DrawSurfaceBlock16 (void);
 void R_DrawSurfaceBlock8 (void);
 texture_t *R_TextureAnimation (texture_t *base);
+qboolean R_SurfaceDlit (msurface_t *surf);
 
 #if	id386
 
@@ -167,6 +168,28 @@ void R_InsertNewEdges (edge_t *edgestoadd, edge_t *edgelist);
 void R_StepActiveU (edge_t *pedge);
 void R_RemoveEdges (edge_t *pedge);
 
+// softquake -- Banded edge scanning, see r_band.c
+void R_ClearActiveEdges (void);
+void R_StepEdges (edge_t **newedge, edge_t **removeedge, int top, int bottom);
+void R_ScanBandEdges (edge_t **newedge, edge_t **removeedge, int top, int bottom);
+void R_BandSpanOverflow (void);
+void R_InitBands (void);
+qboolean R_ScanBands (void);
+
+// softquake -- Surface cache prebuilding, see r_prebuild.c
+void R_InitPrebuild (void);
+void R_StartPrebuild (void);
+void R_FinishPrebuild (void);
+void R_FlushPrebuild (void);
+
+// softquake -- Transformed alias vertex cache, see r_alias.c
+void R_InitAliasCache (void);
+
+// softquake -- Hierarchical z buffer culling, see r_occlude.c
+extern int		r_amodels_occluded;
+void R_InitOcclusion (void);
+qboolean R_OccludedByWorld (float left, float top, float right, float bottom, float nearz);
+
 extern void R_Surf8Start (void);
 extern void R_Surf8End (void);
 extern void R_Surf16Start (void);
@@ -190,8 +213,8 @@ extern int		*pfrustum_indexes[4];
 extern int			ubasestep, errorterm, erroradjustup, erroradjustdown;
 extern int			vstartscan;
 
-extern fixed16_t	sadjust, tadjust;
-extern fixed16_t	bbextents, bbextentt;
+extern THREAD_LOCAL fixed16_t	sadjust, tadjust;
+extern THREAD_LOCAL fixed16_t	bbextents, bbextentt;
 
 #define MAXBVERTINDEXES	1000	// new clipped vertices when clipping bmodels
 								//  to the world BSP
@@ -265,10 +288,12 @@ extern	edge_t	*removeedges[MAXHEIGHT];
 extern	int	screenwidth;
 
 // FIXME: make stack vars when debugging done
-extern	edge_t	edge_head;
-extern	edge_t	edge_tail;
-extern	edge_t	edge_aftertail;
-extern int		r_bmodelactive;
+// softquake -- These are per thread so bands can be scanned at the same time
+extern	THREAD_LOCAL edge_t	edge_head;
+extern	THREAD_LOCAL edge_t	edge_tail;
+extern	THREAD_LOCAL edge_t	edge_aftertail;
+extern THREAD_LOCAL int		r_bmodelactive;
+extern THREAD_LOCAL espan_t	*span_p, *max_span_p;
 extern vrect_t	*pconupdate;
 
 extern float		aliasxscale, aliasyscale, aliasxcenter, aliasycenter;
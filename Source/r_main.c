@@ -244,6 +244,12 @@ void R_Init (void)
 
 	// softquake -- Common cvars between SoftQuake and GLQuake
 	R_RegisterCommonCvars();
+
+	// softquake -- Multithreaded edge scanning
+	R_InitBands ();
+	R_InitPrebuild ();
+	R_InitAliasCache ();
+	R_InitOcclusion ();
 }
 
 /*
@@ -986,7 +992,11 @@ void R_EdgeDrawing (void)
 	}
 	
 	if (!(r_drawpolys | r_drawculledpolys))
-		R_ScanEdges ();
+	{
+		// softquake -- Split the screen into bands and scan them on the worker threads
+		if (!R_ScanBands ())
+			R_ScanEdges ();
+	}
 }
 
 
@@ -1003,6 +1013,10 @@ void R_RenderView_ (void)
 
 	r_warpbuffer = warpbuffer;
 
+// softquake -- surfaces built ahead last frame have to be done before anything
+// looks at the surface cache
+	R_FinishPrebuild ();
+
 	if (r_timegraph.value || r_speeds.value || r_dspeeds.value)
 		r_time1 = Sys_FloatTime ();
 
@@ -1071,6 +1085,10 @@ SetVisibilityByPassages ();
 
 	V_SetContentsColor (r_viewleaf->contents);
 
+// softquake -- build what might come into view next frame while the rest of
+// the frame goes on
+	R_StartPrebuild ();
+
 	if (r_timegraph.value)
 		R_TimeGraph ();
 
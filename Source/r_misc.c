@@ -239,6 +239,7 @@ R_PrintAliasStats
 void R_PrintAliasStats (void)
 {
 	Con_Printf ("%3i polygon model drawn\n", r_amodels_drawn);
+	Con_Printf ("%3i polygon model occluded\n", r_amodels_occluded);	// softquake
 }
 
 
@@ -514,6 +515,7 @@ r_refdef.viewangles[2]=    0;
 	r_drawnpolycount = 0;
 	r_wholepolycount = 0;
 	r_amodels_drawn = 0;
+	r_amodels_occluded = 0;
 	r_outofsurfaces = 0;
 	r_outofedges = 0;
 
@@ -0,0 +1,374 @@
+/*
+Copyright (C) 2023-2023 softquake
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+// r_occlude.c -- culls alias models that are hidden behind the world
+
+// Once the world and brush models have been drawn, the z buffer holds the
+// 1/z of whatever is visible at every pixel of the view. It's boiled down into
+// a pyramid of tiles, each holding the farthest (smallest) 1/z underneath it.
+// An entity whose nearest point is still farther away than the farthest thing
+// in every tile its screen bounds touch can't put a single pixel on screen,
+// so it's thrown out before any of its vertices are touched.
+//
+// The pyramid is only built the first time it's needed in a frame, so frames
+// without any models in view don't pay for it.
+//
+// Brush models can't be culled this way, since they go through the edge list
+// together with the world and there's no z buffer yet when they're set up.
+
+#include "quakedef.h"
+#include "r_local.h"
+#include "d_local.h"
+
+#ifdef SIMD_X86
+#include <emmintrin.h>
+#endif
+
+cvar_t	r_occlusion = {"r_occlusion", "1", CV_ARCHIVE};
+
+#define HZB_TILE_SHIFT	3				// level 0 tiles are 8x8 pixels
+#define HZB_TILE_SIZE	(1 << HZB_TILE_SHIFT)
+#define HZB_MAX_LEVELS	16
+
+// leeway for the rounding in the world and alias z gradients
+#define HZB_Z_EPSILON	2
+
+typedef struct
+{
+	short	*data;
+	int		width, height;
+} hzblevel_t;
+
+static hzblevel_t	r_hzb[HZB_MAX_LEVELS];
+static int			r_hzblevels;
+static short		*r_hzbdata;
+static int			r_hzbsize;
+static int			r_hzbframe = -1;
+static vrect_t		r_hzbrect;
+
+int					r_amodels_occluded;
+
+
+/*
+================
+R_InitOcclusion
+================
+*/
+void R_InitOcclusion (void)
+{
+	Cvar_RegisterVariable (&r_occlusion);
+}
+
+
+/*
+================
+R_HZBTileRows
+
+Smallest value in each whole tile across a band of z buffer rows
+================
+*/
+static void R_HZBTileRows (short *out, int x, int y, int rows, int tiles)
+{
+	int		i, j, k;
+	short	*z, m;
+
+	for (i=0 ; i<tiles ; i++, x+=HZB_TILE_SIZE)
+	{
+		m = 0x7fff;
+		for (j=0 ; j<rows ; j++)
+		{
+			z = zspantable[y+j] + x;
+			for (k=0 ; k<HZB_TILE_SIZE ; k++)
+			{
+				if (z[k] < m)
+					m = z[k];
+			}
+		}
+		out[i] = m;
+	}
+}
+
+
+#ifdef SIMD_X86
+
+/*
+================
+R_HZBTileRowsSSE2
+================
+*/
+TARGET_SSE2
+static void R_HZBTileRowsSSE2 (short *out, int x, int y, int rows, int tiles)
+{
+	int		i, j;
+	__m128i	m;
+
+	for (i=0 ; i<tiles ; i++, x+=HZB_TILE_SIZE)
+	{
+		m = _mm_loadu_si128 ((__m128i *)(zspantable[y] + x));
+		for (j=1 ; j<rows ; j++)
+			m = _mm_min_epi16 (m, _mm_loadu_si128 ((__m128i *)(zspantable[y+j] + x)));
+
+		m = _mm_min_epi16 (m, _mm_srli_si128 (m, 8));
+		m = _mm_min_epi16 (m, _mm_srli_si128 (m, 4));
+		m = _mm_min_epi16 (m, _mm_srli_si128 (m, 2));
+		out[i] = (short)_mm_cvtsi128_si32 (m);
+	}
+}
+
+#endif
+
+
+/*
+================
+R_BuildHZB
+================
+*/
+static void R_BuildHZB (void)
+{
+	int			i, x, y, tx, ty, rows, wholetiles, size;
+	int			width, height;
+	hzblevel_t	*lev, *prev;
+	short		*out, *in, m;
+	short		*z;
+
+	r_hzbrect = r_refdef.vrect;
+
+// lay out the levels, each half the size of the one before, down to 1x1
+	width = (r_hzbrect.width + HZB_TILE_SIZE - 1) >> HZB_TILE_SHIFT;
+	height = (r_hzbrect.height + HZB_TILE_SIZE - 1) >> HZB_TILE_SHIFT;
+
+	size = 0;
+	for (r_hzblevels=0 ; r_hzblevels<HZB_MAX_LEVELS ; r_hzblevels++)
+	{
+		r_hzb[r_hzblevels].width = width;
+		r_hzb[r_hzblevels].height = height;
+		size += width * height;
+
+		if (width == 1 && height == 1)
+		{
+			r_hzblevels++;
+			break;
+		}
+
+		width = (width + 1) >> 1;
+		height = (height + 1) >> 1;
+	}
+
+	if (size > r_hzbsize)
+	{
+		free (r_hzbdata);
+		r_hzbdata = malloc (size * sizeof(short));
+		if (!r_hzbdata)
+			Sys_Error ("R_BuildHZB: out of memory");
+		r_hzbsize = size;
+	}
+
+	out = r_hzbdata;
+	for (i=0 ; i<r_hzblevels ; i++)
+	{
+		r_hzb[i].data = out;
+		out += r_hzb[i].width * r_hzb[i].height;
+	}
+
+// level 0 straight from the z buffer
+	lev = &r_hzb[0];
+	wholetiles = r_hzbrect.width >> HZB_TILE_SHIFT;
+
+	for (ty=0 ; ty<lev->height ; ty++)
+	{
+		y = r_hzbrect.y + (ty << HZB_TILE_SHIFT);
+		rows = r_hzbrect.y + r_hzbrect.height - y;
+		if (rows > HZB_TILE_SIZE)
+			rows = HZB_TILE_SIZE;
+
+		out = lev->data + ty * lev->width;
+
+#ifdef SIMD_X86
+		if (d_simd.value && cpu_sse2)
+			R_HZBTileRowsSSE2 (out, r_hzbrect.x, y, rows, wholetiles);
+		else
+#endif
+			R_HZBTileRows (out, r_hzbrect.x, y, rows, wholetiles);
+
+	// the leftover columns on the right
+		if (wholetiles < lev->width)
+		{
+			x = r_hzbrect.x + (wholetiles << HZB_TILE_SHIFT);
+			m = 0x7fff;
+			for (i=0 ; i<rows ; i++)
+			{
+				for (z = zspantable[y+i] + x ; z < zspantable[y+i] + r_hzbrect.x + r_hzbrect.width ; z++)
+				{
+					if (*z < m)
+						m = *z;
+				}
+			}
+			out[wholetiles] = m;
+		}
+	}
+
+// and each level after that from the one before
+	for (i=1 ; i<r_hzblevels ; i++)
+	{
+		lev = &r_hzb[i];
+		prev = &r_hzb[i-1];
+
+		for (ty=0 ; ty<lev->height ; ty++)
+		{
+			for (tx=0 ; tx<lev->width ; tx++)
+			{
+				in = prev->data + (ty*2) * prev->width + tx*2;
+
+				m = in[0];
+				if (tx*2 + 1 < prev->width && in[1] < m)
+					m = in[1];
+				if (ty*2 + 1 < prev->height)
+				{
+					in += prev->width;
+					if (in[0] < m)
+						m = in[0];
+					if (tx*2 + 1 < prev->width && in[1] < m)
+						m = in[1];
+				}
+
+				lev->data[ty * lev->width + tx] = m;
+			}
+		}
+	}
+
+	r_hzbframe = r_framecount;
+}
+
+
+/*
+================
+R_HZBTileOccludes
+
+Returns true if everything in the part of the given tile that's inside the
+level 0 tile range [tx0, tx1] x [ty0, ty1] is nearer than zi
+================
+*/
+static qboolean R_HZBTileOccludes (int level, int tx, int ty,
+		int tx0, int ty0, int tx1, int ty1, int zi)
+{
+	hzblevel_t	*lev;
+	int			x, y, cx0, cy0, cx1, cy1;
+
+	lev = &r_hzb[level];
+	if (lev->data[ty * lev->width + tx] > zi)
+		return true;
+
+	if (!level)
+		return false;
+
+// not the whole tile, but maybe the part that matters
+	level--;
+	cx0 = tx*2;
+	cy0 = ty*2;
+	cx1 = cx0 + 1;
+	cy1 = cy0 + 1;
+
+	if (cx0 < tx0 >> level)
+		cx0 = tx0 >> level;
+	if (cy0 < ty0 >> level)
+		cy0 = ty0 >> level;
+	if (cx1 > tx1 >> level)
+		cx1 = tx1 >> level;
+	if (cy1 > ty1 >> level)
+		cy1 = ty1 >> level;
+
+	for (y=cy0 ; y<=cy1 ; y++)
+	{
+		for (x=cx0 ; x<=cx1 ; x++)
+		{
+			if (!R_HZBTileOccludes (level, x, y, tx0, ty0, tx1, ty1, zi))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+================
+R_OccludedByWorld
+
+Takes the screen bounds of something and the view space z of its nearest
+point. Returns true if the world hides all of it.
+================
+*/
+qboolean R_OccludedByWorld (float left, float top, float right, float bottom, float nearz)
+{
+	int		x0, y0, x1, y1, tx, ty, level, zi;
+
+	if (!r_occlusion.value || r_drawpolys || r_drawculledpolys)
+		return false;
+
+	if (nearz < ALIAS_Z_CLIP_PLANE)
+		return false;
+
+// pixels the model could touch, with a pixel to spare for rounding
+	x0 = (int)floor (left) - 1;
+	y0 = (int)floor (top) - 1;
+	x1 = (int)ceil (right) + 1;
+	y1 = (int)ceil (bottom) + 1;
+
+	if (x0 < r_refdef.vrect.x)
+		x0 = r_refdef.vrect.x;
+	if (y0 < r_refdef.vrect.y)
+		y0 = r_refdef.vrect.y;
+	if (x1 > r_refdef.vrectright - 1)
+		x1 = r_refdef.vrectright - 1;
+	if (y1 > r_refdef.vrectbottom - 1)
+		y1 = r_refdef.vrectbottom - 1;
+
+	if (x0 > x1 || y0 > y1)
+		return false;		// off screen, that's for the frustum checks to say
+
+	if (r_hzbframe != r_framecount)
+		R_BuildHZB ();
+
+// same scale as the z buffer, where bigger is nearer
+	zi = (int)(0x8000 / nearz) + HZB_Z_EPSILON;
+
+	x0 = (x0 - r_hzbrect.x) >> HZB_TILE_SHIFT;
+	y0 = (y0 - r_hzbrect.y) >> HZB_TILE_SHIFT;
+	x1 = (x1 - r_hzbrect.x) >> HZB_TILE_SHIFT;
+	y1 = (y1 - r_hzbrect.y) >> HZB_TILE_SHIFT;
+
+// start from the first level where it's no more than 2x2 tiles
+	for (level=0 ; level<r_hzblevels-1 ; level++)
+	{
+		if ((x1 >> level) - (x0 >> level) <= 1 && (y1 >> level) - (y0 >> level) <= 1)
+			break;
+	}
+
+	for (ty=y0>>level ; ty<=y1>>level ; ty++)
+	{
+		for (tx=x0>>level ; tx<=x1>>level ; tx++)
+		{
+			if (!R_HZBTileOccludes (level, tx, ty, x0, y0, x1, y1, zi))
+				return false;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,324 @@
+/*
+Copyright (C) 2023-2023 softquake
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+// r_prebuild.c -- builds surface cache entries ahead of time on the worker threads
+
+// At the end of a frame, the world surfaces that are in the PVS and facing the
+// viewer, but weren't drawn, are the likeliest to show up when the camera turns.
+// The closest of them are set up on the main thread and handed to the worker
+// pool, which lights and draws them while the rest of the frame (sound, the
+// server, the 2D stuff, presenting) goes on. The next frame waits for them
+// before it touches the surface cache, and will hopefully find them there.
+//
+// The mip level is a guess based on the distance to the surface, and only
+// surfaces with nothing cached at all are built, with the lightstyles as they
+// are now. Surfaces lit by dynamic lights are left alone, since they'll be
+// rebuilt anyway.
+
+#include "quakedef.h"
+#include "r_local.h"
+#include "d_local.h"
+
+cvar_t	r_prebuild = {"r_prebuild", "0", CV_ARCHIVE};
+
+#define MAX_PREBUILD			256
+#define MAX_PREBUILD_CANDIDATES	4096
+
+typedef struct
+{
+	msurface_t	*surf;
+	int			miplevel;
+	float		dist;
+} prebuildcand_t;
+
+static prebuildcand_t	r_prebuildcands[MAX_PREBUILD_CANDIDATES];
+
+static drawsurf_t		r_prebuildsurfs[MAX_PREBUILD];
+static jobbatch_t		r_prebuildbatch;
+static qboolean			r_prebuilding;
+
+// world surface bounding boxes, worked out once per map
+static float			(*r_surfbounds)[6];
+static int				r_numsurfbounds;
+static model_t			*r_boundsmodel;
+
+
+/*
+================
+R_InitPrebuild
+================
+*/
+void R_InitPrebuild (void)
+{
+	Cvar_RegisterVariable (&r_prebuild);
+}
+
+
+/*
+================
+R_CalcSurfaceBounds
+================
+*/
+static void R_CalcSurfaceBounds (model_t *model)
+{
+	int			i, j, k, lindex;
+	msurface_t	*surf;
+	float		*bounds, *v;
+
+	if (model->numsurfaces > r_numsurfbounds)
+	{
+		free (r_surfbounds);
+		r_surfbounds = malloc (model->numsurfaces * sizeof(*r_surfbounds));
+		if (!r_surfbounds)
+			Sys_Error ("R_CalcSurfaceBounds: out of memory");
+		r_numsurfbounds = model->numsurfaces;
+	}
+
+	for (i=0, surf=model->surfaces ; i<model->numsurfaces ; i++, surf++)
+	{
+		bounds = r_surfbounds[i];
+		bounds[0] = bounds[1] = bounds[2] = 999999;
+		bounds[3] = bounds[4] = bounds[5] = -999999;
+
+		for (j=0 ; j<surf->numedges ; j++)
+		{
+			lindex = model->surfedges[surf->firstedge + j];
+			if (lindex > 0)
+				v = model->vertexes[model->edges[lindex].v[0]].position;
+			else
+				v = model->vertexes[model->edges[-lindex].v[1]].position;
+
+			for (k=0 ; k<3 ; k++)
+			{
+				if (v[k] < bounds[k])
+					bounds[k] = v[k];
+				if (v[k] > bounds[3+k])
+					bounds[3+k] = v[k];
+			}
+		}
+	}
+
+	r_boundsmodel = model;
+}
+
+
+/*
+================
+R_SurfaceDistance
+
+Distance from the view origin to the closest point of the surface's bounds
+================
+*/
+static float R_SurfaceDistance (float *bounds)
+{
+	int		i;
+	float	d, dist;
+
+	dist = 0;
+	for (i=0 ; i<3 ; i++)
+	{
+		if (r_origin[i] < bounds[i])
+			d = bounds[i] - r_origin[i];
+		else if (r_origin[i] > bounds[3+i])
+			d = r_origin[i] - bounds[3+i];
+		else
+			continue;
+		dist += d*d;
+	}
+
+	return sqrt (dist);
+}
+
+
+/*
+================
+R_CompareCandidates
+================
+*/
+static int R_CompareCandidates (const void *a, const void *b)
+{
+	float	d;
+
+	d = ((prebuildcand_t *)a)->dist - ((prebuildcand_t *)b)->dist;
+	if (d < 0)
+		return -1;
+	if (d > 0)
+		return 1;
+	return 0;
+}
+
+
+/*
+================
+R_PrebuildSurface
+================
+*/
+static void R_PrebuildSurface (void *data, int index)
+{
+	D_BuildSurface (&r_prebuildsurfs[index]);
+}
+
+
+/*
+================
+R_GatherCandidates
+
+Finds world surfaces in the PVS that face the viewer, weren't drawn this
+frame, and have nothing in the surface cache at the mip level they'd probably
+be drawn at
+================
+*/
+static int R_GatherCandidates (void)
+{
+	model_t			*model;
+	mleaf_t			*leaf;
+	msurface_t		*surf, **mark;
+	prebuildcand_t	*cand;
+	int				i, c, numcands, miplevel;
+	float			dot, dist;
+
+	model = cl.worldmodel;
+	numcands = 0;
+
+	for (i=0 ; i<model->numleafs ; i++)
+	{
+		leaf = &model->leafs[i+1];
+		if (leaf->visframe != r_visframecount)
+			continue;
+
+		mark = leaf->firstmarksurface;
+		for (c=leaf->nummarksurfaces ; c ; c--, mark++)
+		{
+			surf = *mark;
+
+			if (surf->visframe == r_framecount)
+				continue;		// drawn, or at least looked at, this frame
+			if (surf->flags & (SURF_DRAWSKY | SURF_DRAWTURB))
+				continue;		// not cached
+			if (surf->dlightframe == r_framecount)
+				continue;		// would just be built again
+
+			dot = DotProduct (r_origin, surf->plane->normal) - surf->plane->dist;
+			if (surf->flags & SURF_PLANEBACK)
+				dot = -dot;
+			if (dot < BACKFACE_EPSILON)
+				continue;		// can't be seen from here
+
+			dist = R_SurfaceDistance (r_surfbounds[surf - model->surfaces]);
+			if (dist < 1)
+				dist = 1;
+
+			miplevel = D_MipLevelForScale (scale_for_mip *
+					surf->texinfo->mipadjust / dist);
+			if (surf->cachespots[miplevel])
+				continue;
+
+			cand = &r_prebuildcands[numcands++];
+			cand->surf = surf;
+			cand->miplevel = miplevel;
+			cand->dist = dist;
+
+			if (numcands == MAX_PREBUILD_CANDIDATES)
+				return numcands;
+		}
+	}
+
+	return numcands;
+}
+
+
+/*
+================
+R_StartPrebuild
+
+Called at the end of R_RenderView
+================
+*/
+void R_StartPrebuild (void)
+{
+	int			i, count, numcands, numsurfs;
+	entity_t	*saveent;
+
+	count = (int)r_prebuild.value;
+	if (count > MAX_PREBUILD)
+		count = MAX_PREBUILD;
+	if (count < 1 || Jobs_NumThreads () < 2 || r_prebuilding)
+		return;
+
+	if (r_boundsmodel != cl.worldmodel)
+		R_CalcSurfaceBounds (cl.worldmodel);
+
+	numcands = R_GatherCandidates ();
+	if (!numcands)
+		return;
+
+	qsort (r_prebuildcands, numcands, sizeof(prebuildcand_t), R_CompareCandidates);
+
+// texture animation looks at the current entity
+	saveent = currententity;
+	currententity = &cl_entities[0];
+
+	numsurfs = 0;
+	for (i=0 ; i<numcands && numsurfs<count ; i++)
+	{
+		if (D_PrebuildSurface (r_prebuildcands[i].surf,
+				r_prebuildcands[i].miplevel, &r_prebuildsurfs[numsurfs]))
+			numsurfs++;
+	}
+
+	currententity = saveent;
+
+	if (!numsurfs)
+		return;
+
+	Jobs_Begin (&r_prebuildbatch, R_PrebuildSurface, NULL, numsurfs);
+	r_prebuilding = true;
+}
+
+
+/*
+================
+R_FinishPrebuild
+
+Waits for the surfaces started last frame
+================
+*/
+void R_FinishPrebuild (void)
+{
+	if (!r_prebuilding)
+		return;
+
+	Jobs_Wait (&r_prebuildbatch);
+	r_prebuilding = false;
+}
+
+
+/*
+================
+R_FlushPrebuild
+
+Called by D_FlushCaches, before the cache or the world model goes away
+================
+*/
+void R_FlushPrebuild (void)
+{
+	R_FinishPrebuild ();
+	r_boundsmodel = NULL;
+}
@@ -44,8 +44,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 extern void	R_DrawLine (polyvert_t *polyvert0, polyvert_t *polyvert1);
 
-extern int		cachewidth;
-extern pixel_t	*cacheblock;
+extern THREAD_LOCAL int		cachewidth;
+extern THREAD_LOCAL pixel_t	*cacheblock;
 extern int		screenwidth;
 
 extern	float	pixelAspect;
@@ -98,7 +98,8 @@ typedef struct surf_s
 	int			pad[2];				// to 64 bytes
 } surf_t;
 
-extern	surf_t	*surfaces, *surface_p, *surf_max;
+extern	THREAD_LOCAL surf_t	*surfaces;	// softquake -- Each band has its own copy, see r_band.c
+extern	surf_t	*surface_p, *surf_max;
 
 // surfaces are generated in back to front order by the bsp, so if a surf
 // pointer is greater than another one, it should be drawn in front
@@ -106,6 +107,36 @@ extern	surf_t	*surfaces, *surface_p, *surf_max;
 // surfaces[0] is a dummy, because index 0 is used to indicate no surface
 //  attached to an edge_t
 
+// softquake -- Everything the driver needs to draw the spans of a surface.
+// Filled in by D_SetupSurface on the main thread, so D_DrawSurface can be
+// called from any thread afterwards.
+typedef enum
+{
+	ss_none,
+	ss_solid,		// flat color
+	ss_sky,
+	ss_turb,
+	ss_texture		// surface cache
+} surfsetuptype_t;
+
+typedef struct
+{
+	surfsetuptype_t	type;
+	int				color;			// ss_solid only
+	pixel_t			*cacheblock;
+	int				cachewidth;
+	struct surfcache_s	**cachespot;	// ss_texture only, to spot evictions
+	float			d_sdivzstepu, d_tdivzstepu, d_zistepu;
+	float			d_sdivzstepv, d_tdivzstepv, d_zistepv;
+	float			d_sdivzorigin, d_tdivzorigin, d_ziorigin;
+	fixed16_t		sadjust, tadjust;
+	fixed16_t		bbextents, bbextentt;
+} surfsetup_t;
+
+void D_BeginSurfaces (void);
+void D_SetupSurface (surf_t *s, surfsetup_t *ss);
+void D_DrawSurface (surf_t *s, surfsetup_t *ss);
+
 //===================================================================
 
 extern vec3_t	sxformaxis[4];	// s axis transformed into viewspace
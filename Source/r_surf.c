@@ -21,21 +21,27 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "quakedef.h"
 #include "r_local.h"
+#include "d_local.h"
 
-drawsurf_t	r_drawsurf;
-
-int				lightleft, sourcesstep, blocksize, sourcetstep;
-int				lightdelta, lightdeltastep;
-int				lightright, lightleftstep, lightrightstep, blockdivshift;
-unsigned		blockdivmask;
-void			*prowdestbase;
-unsigned char	*pbasesource;
-int				surfrowbytes;	// used by ASM files
-unsigned		*r_lightptr;
-int				r_stepback;
-int				r_lightwidth;
-int				r_numhblocks, r_numvblocks;
-unsigned char	*r_source, *r_sourcemax;
+#ifdef SIMD_X86
+#include <immintrin.h>
+#endif
+
+// softquake -- Thread local, so r_prebuild.c can build surfaces on the worker threads
+THREAD_LOCAL drawsurf_t	r_drawsurf;
+
+THREAD_LOCAL int				lightleft, sourcesstep, blocksize, sourcetstep;
+THREAD_LOCAL int				lightdelta, lightdeltastep;
+THREAD_LOCAL int				lightright, lightleftstep, lightrightstep, blockdivshift;
+THREAD_LOCAL unsigned			blockdivmask;
+THREAD_LOCAL void				*prowdestbase;
+THREAD_LOCAL unsigned char		*pbasesource;
+THREAD_LOCAL int				surfrowbytes;	// used by ASM files
+THREAD_LOCAL unsigned			*r_lightptr;
+THREAD_LOCAL int				r_stepback;
+THREAD_LOCAL int				r_lightwidth;
+THREAD_LOCAL int				r_numhblocks, r_numvblocks;
+THREAD_LOCAL unsigned char		*r_source, *r_sourcemax;
 
 void R_DrawSurfaceBlock8_mip0 (void);
 void R_DrawSurfaceBlock8_mip1 (void);
@@ -49,9 +55,20 @@ static void	(*surfmiptable[4])(void) = {
 	R_DrawSurfaceBlock8_mip3
 };
 
+#ifdef SIMD_X86
+// softquake -- 16 and 8 texel wide blocks only, the smaller mips aren't worth it
+static void R_DrawSurfaceBlock8_mip0AVX2 (void);
+static void R_DrawSurfaceBlock8_mip1AVX2 (void);
+
+static void	(*surfmiptableAVX2[2])(void) = {
+	R_DrawSurfaceBlock8_mip0AVX2,
+	R_DrawSurfaceBlock8_mip1AVX2
+};
+#endif
+
 
 
-unsigned		blocklights[18*18];
+THREAD_LOCAL unsigned		blocklights[18*18];
 
 /*
 ===============
@@ -139,6 +156,221 @@ void R_AddDynamicLights (void)
 	}
 }
 
+/*
+===============
+R_SurfaceDlit
+
+softquake -- R_MarkLights only checks the distance to the plane, so a light
+can be marked on a surface without reaching any of its lightmap samples.
+Returns true if R_AddDynamicLights would actually change the lightmap.
+===============
+*/
+qboolean R_SurfaceDlit (msurface_t *surf)
+{
+	int			lnum;
+	int			sd, td, mins, mint;
+	float		dist, rad, minlight;
+	vec3_t		impact, local;
+	int			s, t;
+	int			i;
+	int			smax, tmax;
+	mtexinfo_t	*tex;
+
+	if (surf->dlightframe != r_framecount)
+		return false;
+
+	smax = (surf->extents[0]>>4)+1;
+	tmax = (surf->extents[1]>>4)+1;
+	tex = surf->texinfo;
+
+	for (lnum=0 ; lnum<MAX_DLIGHTS ; lnum++)
+	{
+		if ( !(surf->dlightbits & (1<<lnum) ) )
+			continue;		// not lit by this light
+
+		rad = cl_dlights[lnum].radius;
+		dist = DotProduct (cl_dlights[lnum].origin, surf->plane->normal) -
+				surf->plane->dist;
+		rad -= fabs(dist);
+		minlight = cl_dlights[lnum].minlight;
+		if (rad < minlight)
+			continue;
+		minlight = rad - minlight;
+
+		for (i=0 ; i<3 ; i++)
+		{
+			impact[i] = cl_dlights[lnum].origin[i] -
+					surf->plane->normal[i]*dist;
+		}
+
+		local[0] = DotProduct (impact, tex->vecs[0]) + tex->vecs[0][3];
+		local[1] = DotProduct (impact, tex->vecs[1]) + tex->vecs[1][3];
+
+		local[0] -= surf->texturemins[0];
+		local[1] -= surf->texturemins[1];
+
+	// the distance grows with both sd and td, so the closest sample is the
+	// one with the smallest of each
+		mint = 0x7fffffff;
+		for (t = 0 ; t<tmax ; t++)
+		{
+			td = local[1] - t*16;
+			if (td < 0)
+				td = -td;
+			if (td < mint)
+				mint = td;
+		}
+
+		mins = 0x7fffffff;
+		for (s=0 ; s<smax ; s++)
+		{
+			sd = local[0] - s*16;
+			if (sd < 0)
+				sd = -sd;
+			if (sd < mins)
+				mins = sd;
+		}
+
+		if (mins > mint)
+			dist = mins + (mint>>1);
+		else
+			dist = mint + (mins>>1);
+		if (dist < minlight)
+			return true;
+	}
+
+	return false;
+}
+
+#ifdef SIMD_X86
+// softquake -- SSE2 and AVX2 versions of the lightmap loops
+// Integer only, so they give the same results as the C code everywhere.
+// Each one returns how many samples it did; the C code finishes the rest.
+
+TARGET_SSE2
+static int R_AddLightmapSSE2 (byte *lightmap, unsigned scale, int size)
+{
+	int			i;
+	__m128i		zero, vscale, samples, lo, hi, *dest;
+
+	zero = _mm_setzero_si128 ();
+	vscale = _mm_set1_epi16 ((short)scale);	// only called with scale < 0x10000
+
+	for (i=0 ; i+8<=size ; i+=8)
+	{
+		samples = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((__m128i *)(lightmap + i)), zero);
+
+	// 16x16 -> 32 bit products, put back together from the low and high halves
+		lo = _mm_mullo_epi16 (samples, vscale);
+		hi = _mm_mulhi_epu16 (samples, vscale);
+
+		dest = (__m128i *)(blocklights + i);
+		_mm_storeu_si128 (dest, _mm_add_epi32 (_mm_loadu_si128 (dest), _mm_unpacklo_epi16 (lo, hi)));
+		_mm_storeu_si128 (dest + 1, _mm_add_epi32 (_mm_loadu_si128 (dest + 1), _mm_unpackhi_epi16 (lo, hi)));
+	}
+
+	return i;
+}
+
+TARGET_AVX2
+static int R_AddLightmapAVX2 (byte *lightmap, unsigned scale, int size)
+{
+	int			i;
+	__m256i		vscale, samples, *dest;
+
+	vscale = _mm256_set1_epi32 (scale);
+
+	for (i=0 ; i+8<=size ; i+=8)
+	{
+		samples = _mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((__m128i *)(lightmap + i)));
+		dest = (__m256i *)(blocklights + i);
+		_mm256_storeu_si256 (dest, _mm256_add_epi32 (_mm256_loadu_si256 (dest),
+				_mm256_mullo_epi32 (samples, vscale)));
+	}
+
+	return i;
+}
+
+TARGET_SSE2
+static int R_BoundLightsSSE2 (int size)
+{
+	int			i;
+	__m128i		full, minlight, t, clamp, *dest;
+
+	full = _mm_set1_epi32 (255*256);
+	minlight = _mm_set1_epi32 (1 << 6);
+
+	for (i=0 ; i+4<=size ; i+=4)
+	{
+		dest = (__m128i *)(blocklights + i);
+		t = _mm_srai_epi32 (_mm_sub_epi32 (full, _mm_loadu_si128 (dest)), 8 - VID_CBITS);
+		clamp = _mm_cmplt_epi32 (t, minlight);
+		t = _mm_or_si128 (_mm_and_si128 (clamp, minlight), _mm_andnot_si128 (clamp, t));
+		_mm_storeu_si128 (dest, t);
+	}
+
+	return i;
+}
+#endif
+
+
+/*
+===============
+R_AddLightmap
+
+blocklights += lightmap * scale
+===============
+*/
+static void R_AddLightmap (byte *lightmap, unsigned scale, int size)
+{
+	int		i;
+
+	i = 0;
+#ifdef SIMD_X86
+	if (d_simd.value)
+	{
+		if (cpu_avx2)
+			i = R_AddLightmapAVX2 (lightmap, scale, size);
+		else if (cpu_sse2 && scale < 0x10000)
+			i = R_AddLightmapSSE2 (lightmap, scale, size);
+	}
+#endif
+
+	for ( ; i<size ; i++)
+		blocklights[i] += lightmap[i] * scale;
+}
+
+
+/*
+===============
+R_BoundLights
+
+Turns the summed up light into the 0 - 63 shade range in the colormap,
+as 8.8 fixed point
+===============
+*/
+static void R_BoundLights (int size)
+{
+	int		i, t;
+
+	i = 0;
+#ifdef SIMD_X86
+	if (d_simd.value && cpu_sse2)
+		i = R_BoundLightsSSE2 (size);
+#endif
+
+	for ( ; i<size ; i++)
+	{
+		t = (255*256 - (int)blocklights[i]) >> (8 - VID_CBITS);
+
+		if (t < (1 << 6))
+			t = (1 << 6);
+
+		blocklights[i] = t;
+	}
+}
+
+
 /*
 ===============
 R_BuildLightMap
@@ -149,7 +381,6 @@ Combine and scale multiple lightmaps into the 8.8 format in blocklights
 void R_BuildLightMap (void)
 {
 	int			smax, tmax;
-	int			t;
 	int			i, size;
 	byte		*lightmap;
 	unsigned	scale;
@@ -181,8 +412,7 @@ void R_BuildLightMap (void)
 			 maps++)
 		{
 			scale = r_drawsurf.lightadj[maps];	// 8.8 fraction		
-			for (i=0 ; i<size ; i++)
-				blocklights[i] += lightmap[i] * scale;
+			R_AddLightmap (lightmap, scale, size);
 			lightmap += size;	// skip to next lightmap
 		}
 
@@ -191,15 +421,7 @@ void R_BuildLightMap (void)
 		R_AddDynamicLights ();
 
 // bound, invert, and shift
-	for (i=0 ; i<size ; i++)
-	{
-		t = (255*256 - (int)blocklights[i]) >> (8 - VID_CBITS);
-
-		if (t < (1 << 6))
-			t = (1 << 6);
-
-		blocklights[i] = t;
-	}
+	R_BoundLights (size);
 }
 
 
@@ -284,6 +506,10 @@ void R_DrawSurface (void)
 	if (r_pixbytes == 1)
 	{
 		pblockdrawer = surfmiptable[r_drawsurf.surfmip];
+#ifdef SIMD_X86
+		if (d_simd.value && cpu_avx2 && r_drawsurf.surfmip < 2)
+			pblockdrawer = surfmiptableAVX2[r_drawsurf.surfmip];
+#endif
 	// TODO: only needs to be set when there is a display settings change
 		horzblockstep = blocksize;
 	}
@@ -575,6 +801,108 @@ void R_DrawSurfaceBlock8_mip3 (void)
 }
 
 
+#ifdef SIMD_X86
+/*
+================
+R_DrawSurfaceBlock8AVX2
+
+softquake -- Same as R_DrawSurfaceBlock8_mip0 / mip1, a whole row at a time.
+The light for each texel is worked out directly instead of stepped, which
+comes to the same thing in integer math, and the colormap is read with
+gathers. Only the low byte of each gather is kept; the colormap is padded
+enough in the hunk that the three bytes read past the last entry are safe.
+================
+*/
+TARGET_AVX2
+static void R_DrawSurfaceBlock8AVX2 (int shift)
+{
+	int				v, i, size, lightstep;
+	unsigned char	*psource, *prowdest;
+	const int		*colormap;
+	__m256i			lightmask, bytemask, ramp0, ramp1, light, index, c0, c1;
+	__m128i			out;
+
+	size = 1 << shift;
+	colormap = (const int *)vid.colormap;
+	lightmask = _mm256_set1_epi32 (0xFF00);
+	bytemask = _mm256_set1_epi32 (0xFF);
+
+// how many steps along from lightright each texel is
+	if (size == 16)
+	{
+		ramp0 = _mm256_setr_epi32 (15, 14, 13, 12, 11, 10, 9, 8);
+		ramp1 = _mm256_setr_epi32 (7, 6, 5, 4, 3, 2, 1, 0);
+	}
+	else
+	{
+		ramp0 = _mm256_setr_epi32 (7, 6, 5, 4, 3, 2, 1, 0);
+		ramp1 = ramp0;
+	}
+
+	psource = pbasesource;
+	prowdest = prowdestbase;
+
+	for (v=0 ; v<r_numvblocks ; v++)
+	{
+		lightleft = r_lightptr[0];
+		lightright = r_lightptr[1];
+		r_lightptr += r_lightwidth;
+		lightleftstep = (r_lightptr[0] - lightleft) >> shift;
+		lightrightstep = (r_lightptr[1] - lightright) >> shift;
+
+		for (i=0 ; i<size ; i++)
+		{
+			lightstep = (lightleft - lightright) >> shift;
+
+			light = _mm256_add_epi32 (_mm256_set1_epi32 (lightright),
+					_mm256_mullo_epi32 (_mm256_set1_epi32 (lightstep), ramp0));
+			index = _mm256_add_epi32 (_mm256_and_si256 (light, lightmask),
+					_mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((__m128i *)psource)));
+			c0 = _mm256_and_si256 (_mm256_i32gather_epi32 (colormap, index, 1), bytemask);
+
+			if (size == 16)
+			{
+				light = _mm256_add_epi32 (_mm256_set1_epi32 (lightright),
+						_mm256_mullo_epi32 (_mm256_set1_epi32 (lightstep), ramp1));
+				index = _mm256_add_epi32 (_mm256_and_si256 (light, lightmask),
+						_mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((__m128i *)(psource + 8))));
+				c1 = _mm256_and_si256 (_mm256_i32gather_epi32 (colormap, index, 1), bytemask);
+
+			// 32 -> 16 bits packs within each 128 bit lane, so put the lanes back in order
+				c0 = _mm256_permute4x64_epi64 (_mm256_packus_epi32 (c0, c1), _MM_SHUFFLE(3, 1, 2, 0));
+				out = _mm_packus_epi16 (_mm256_castsi256_si128 (c0), _mm256_extracti128_si256 (c0, 1));
+				_mm_storeu_si128 ((__m128i *)prowdest, out);
+			}
+			else
+			{
+				out = _mm_packus_epi32 (_mm256_castsi256_si128 (c0), _mm256_extracti128_si256 (c0, 1));
+				out = _mm_packus_epi16 (out, out);
+				_mm_storel_epi64 ((__m128i *)prowdest, out);
+			}
+
+			psource += sourcetstep;
+			lightright += lightrightstep;
+			lightleft += lightleftstep;
+			prowdest += surfrowbytes;
+		}
+
+		if (psource >= r_sourcemax)
+			psource -= r_stepback;
+	}
+}
+
+static void R_DrawSurfaceBlock8_mip0AVX2 (void)
+{
+	R_DrawSurfaceBlock8AVX2 (4);
+}
+
+static void R_DrawSurfaceBlock8_mip1AVX2 (void)
+{
+	R_DrawSurfaceBlock8AVX2 (3);
+}
+#endif
+
+
 /*
 ================
 R_DrawSurfaceBlock16
@@ -240,6 +240,35 @@ void SV_BroadcastPrintf (char *fmt, ...);
 
 void SV_Physics (void);
 
+byte *SV_FatPVS (vec3_t org);
+
+// softquake -- sv_vis.c
+extern	cvar_t	sv_visindex;
+
+void SV_InitVis (void);
+void SV_ClearVisIndex (void);
+void SV_LinkVisIndex (edict_t *ent);
+byte *SV_ClientFatPVS (edict_t *clent, vec3_t org);
+int SV_VisibleEdicts (edict_t *clent, byte *pvs, int *list);
+
+// softquake -- sv_prof.c
+typedef enum
+{
+	prof_runclients, prof_physics, prof_client, prof_pusher, prof_step,
+	prof_toss, prof_other, prof_send, prof_total, prof_numphases
+} profphase_t;
+
+extern	cvar_t		sv_profile;
+extern	qboolean	sv_profiling;
+
+void SV_InitProfile (void);
+void SV_ClearProfile (void);
+void SV_ProfileStartTick (void);
+void SV_ProfileEndTick (void);
+double SV_ProfileTime (void);
+void SV_ProfileAdd (profphase_t phase, double start);
+profphase_t SV_ProfilePhase (edict_t *ent, int num);
+
 qboolean SV_CheckBottom (edict_t *ent);
 qboolean SV_movestep (edict_t *ent, vec3_t move, qboolean relink);
 
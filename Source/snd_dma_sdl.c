@@ -343,6 +343,48 @@ sfx_t *S_PrecacheSound (char *name)
 	return sfx;
 }
 
+/*
+==================
+S_NeedsLoad
+
+softquake
+==================
+*/
+sfx_t *S_NeedsLoad (char *name)
+{
+	sfx_t	*sfx;
+
+	if (!sound_started || nosound.value || !precache.value)
+		return NULL;
+
+	sfx = S_FindName (name);
+	if (Cache_Check (&sfx->cache))
+		return NULL;
+	return sfx;
+}
+
+/*
+==================
+S_PrecacheDecoded
+
+softquake
+==================
+*/
+sfx_t *S_PrecacheDecoded (char *name, sfxcache_t *sc, int size)
+{
+	sfx_t		*sfx;
+	sfxcache_t	*dest;
+
+	sfx = S_FindName (name);
+	if (!sc || Cache_Check (&sfx->cache))
+		return sfx;
+
+	dest = Cache_Alloc (&sfx->cache, size, sfx->name);
+	if (dest)
+		memcpy (dest, sc, size);
+	return sfx;
+}
+
 
 //=============================================================================
 
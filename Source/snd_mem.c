@@ -28,20 +28,18 @@ byte *S_Alloc (int size);
 /*
 ================
 ResampleSfx
+
+softquake -- Takes the sfxcache_t to fill in instead of the sfx_t, so it
+doesn't have to be in the cache yet, and can run on any thread
 ================
 */
-void ResampleSfx (sfx_t *sfx, int inrate, int inwidth, byte *data)
+void ResampleSfx (sfxcache_t *sc, int inrate, int inwidth, byte *data)
 {
 	int		outcount;
 	int		srcsample;
 	float	stepscale;
 	int		i;
 	int		sample, samplefrac, fracstep;
-	sfxcache_t	*sc;
-	
-	sc = Cache_Check (&sfx->cache);
-	if (!sc)
-		return;
 
 	stepscale = (float)inrate / shm->speed;	// this is usually 0.5, 1, or 2
 
@@ -100,7 +98,6 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 	byte	*data;
 	wavinfo_t	info;
 	int		len;
-	float	stepscale;
 	sfxcache_t	*sc;
 	byte	stackbuf[1*1024];		// avoid dirtying the cache heap
 
@@ -116,7 +113,7 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 
 //	Con_Printf ("loading %s\n",namebuffer);
 
-	data = COM_LoadStackFile(namebuffer, stackbuf, sizeof(stackbuf));
+	data = COM_LoadMappedFile(namebuffer, stackbuf, sizeof(stackbuf));	// softquake
 
 	if (!data)
 	{
@@ -124,31 +121,65 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 		return NULL;
 	}
 
-	info = GetWavinfo (s->name, data, com_filesize);
-	if (info.channels != 1)
+	// softquake -- split up for cl_stream.c
+	len = S_SoundInfo (s, data, com_filesize, &info);
+	if (!len)
+		return NULL;
+
+	sc = Cache_Alloc ( &s->cache, len, s->name);
+	if (!sc)
+		return NULL;
+
+	S_DecodeSound (sc, &info, data);
+
+	return sc;
+}
+
+/*
+==============
+S_SoundInfo
+
+softquake -- Reads the wav header, returning the size of the sfxcache_t the
+sound will need, or 0 if it can't be played
+==============
+*/
+int S_SoundInfo (sfx_t *s, byte *data, int length, wavinfo_t *info)
+{
+	float	stepscale;
+	int		len;
+
+	*info = GetWavinfo (s->name, data, length);
+	if (info->channels != 1)
 	{
 		Con_Printf ("%s is a stereo sample\n",s->name);
-		return NULL;
+		return 0;
 	}
 
-	stepscale = (float)info.rate / shm->speed;	
-	len = info.samples / stepscale;
+	stepscale = (float)info->rate / shm->speed;	
+	len = info->samples / stepscale;
 
-	len = len * info.width * info.channels;
+	len = len * info->width * info->channels;
 
-	sc = Cache_Alloc ( &s->cache, len + sizeof(sfxcache_t), s->name);
-	if (!sc)
-		return NULL;
-	
-	sc->length = info.samples;
-	sc->loopstart = info.loopstart;
-	sc->speed = info.rate;
-	sc->width = info.width;
-	sc->stereo = info.channels;
+	return len + sizeof(sfxcache_t);
+}
 
-	ResampleSfx (s, sc->speed, sc->width, data + info.dataofs);
+/*
+==============
+S_DecodeSound
 
-	return sc;
+softquake -- Fills in the sfxcache_t from the wav S_SoundInfo looked at.
+Can run on any thread.
+==============
+*/
+void S_DecodeSound (sfxcache_t *sc, wavinfo_t *info, byte *data)
+{
+	sc->length = info->samples;
+	sc->loopstart = info->loopstart;
+	sc->speed = info->rate;
+	sc->width = info->width;
+	sc->stereo = info->channels;
+
+	ResampleSfx (sc, sc->speed, sc->width, data + info->dataofs);
 }
 
 
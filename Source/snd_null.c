@@ -67,6 +67,25 @@ sfx_t *S_PrecacheSound (char *sample)
 	return NULL;
 }
 
+sfx_t *S_NeedsLoad (char *sample)
+{
+	return NULL;
+}
+
+int S_SoundInfo (sfx_t *s, byte *data, int length, wavinfo_t *info)
+{
+	return 0;
+}
+
+void S_DecodeSound (sfxcache_t *sc, wavinfo_t *info, byte *data)
+{
+}
+
+sfx_t *S_PrecacheDecoded (char *sample, sfxcache_t *sc, int size)
+{
+	return NULL;
+}
+
 void S_ClearPrecache (void)
 {
 }
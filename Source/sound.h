@@ -168,6 +168,15 @@ sfxcache_t *S_LoadSound (sfx_t *s);
 
 wavinfo_t GetWavinfo (char *name, byte *wav, int wavlength);
 
+// softquake -- S_PrecacheSound in pieces, so cl_stream.c can decode sounds
+// on the worker threads
+sfx_t *S_NeedsLoad (char *sample);
+// the sfx_t S_PrecacheSound would load, or NULL if it wouldn't load anything
+int S_SoundInfo (sfx_t *s, byte *data, int length, wavinfo_t *info);
+void S_DecodeSound (sfxcache_t *sc, wavinfo_t *info, byte *data);
+sfx_t *S_PrecacheDecoded (char *sample, sfxcache_t *sc, int size);
+// S_PrecacheSound with the sound already decoded into sc, NULL if it couldn't be
+
 void SND_InitScaletable (void);
 void SNDDMA_Submit(void);
 void SNDDMA_LockBuffer(void);
@@ -26,6 +26,11 @@ server_static_t	svs;
 
 char	localmodels[MAX_MODELS][5];			// inline model names for precache
 
+// softquake
+cvar_t	sv_threadedsend = {"sv_threadedsend", "1", CV_ARCHIVE};
+
+static	qboolean	sv_prebuilding;		// datagrams are being built on the worker threads
+
 //============================================================================
 
 /*
@@ -47,6 +52,7 @@ void SV_Init (void)
 	extern	cvar_t	sv_idealpitchscale;
 	extern	cvar_t	sv_aim;
 	extern	cvar_t	sv_altnoclip;
+	extern	cvar_t	sv_skipidle;
 
 	Cvar_RegisterVariable (&sv_maxvelocity);
 	Cvar_RegisterVariable (&sv_gravity);
@@ -59,6 +65,15 @@ void SV_Init (void)
 	Cvar_RegisterVariable (&sv_aim);
 	Cvar_RegisterVariable (&sv_nostep);
 	Cvar_RegisterVariable (&sv_altnoclip);
+	Cvar_RegisterVariable (&sv_areagrid); // softquake
+	Cmd_AddCommand ("tracebench", SV_TraceBench_f); // softquake
+	Cvar_RegisterVariable (&sv_tracecache); // softquake
+	Cvar_RegisterVariable (&sv_tracestats); // softquake
+	Cmd_AddCommand ("tracestats", SV_TraceStats_f); // softquake
+	SV_InitVis (); // softquake
+	Cvar_RegisterVariable (&sv_threadedsend); // softquake
+	SV_InitProfile (); // softquake
+	Cvar_RegisterVariable (&sv_skipidle); // softquake
 
 	for (i=0 ; i<MAX_MODELS ; i++)
 		sprintf (localmodels[i], "*%i", i);
@@ -422,27 +437,39 @@ byte *SV_FatPVS (vec3_t org)
 
 /*
 =============
-SV_WriteEntitiesToClient
+SV_WriteEntitiesInPVS
 
+softquake -- SV_WriteEntitiesToClient once the PVS has been found, which can
+run for several clients at once. Returns false if the packet overflowed.
 =============
 */
-void SV_WriteEntitiesToClient (edict_t	*clent, sizebuf_t *msg)
+static qboolean SV_WriteEntitiesInPVS (edict_t *clent, byte *pvs, sizebuf_t *msg)
 {
-	int		e, i;
+	int		e, i, j;
 	int		bits;
-	byte	*pvs;
-	vec3_t	org;
 	float	miss;
 	edict_t	*ent;
-
-// find the client's PVS
-	VectorAdd (clent->v.origin, clent->v.view_ofs, org);
-	pvs = SV_FatPVS (org);
+	int		visible[MAX_EDICTS];
+	int		numvisible;
+	qboolean	useindex;
+
+// softquake -- only go through the entities in leafs the client can see
+	useindex = sv_visindex.value != 0;
+	if (useindex)
+		numvisible = SV_VisibleEdicts (clent, pvs, visible);
+	else
+	{
+		numvisible = 0;
+		for (e=1 ; e<sv.num_edicts ; e++)
+			visible[numvisible++] = e;
+	}
 
 // send over all entities (excpet the client) that touch the pvs
-	ent = NEXT_EDICT(sv.edicts);
-	for (e=1 ; e<sv.num_edicts ; e++, ent = NEXT_EDICT(ent))
+	for (j=0 ; j<numvisible ; j++)
 	{
+		e = visible[j];
+		ent = EDICT_NUM(e);
+
 #ifdef QUAKE2
 		// don't send if flagged for NODRAW and there are no lighting effects
 		if (ent->v.effects == EF_NODRAW)
@@ -456,19 +483,19 @@ void SV_WriteEntitiesToClient (edict_t	*clent, sizebuf_t *msg)
 			if (!ent->v.modelindex || !pr_strings[ent->v.model])
 				continue;
 
-			for (i=0 ; i < ent->num_leafs ; i++)
-				if (pvs[ent->leafnums[i] >> 3] & (1 << (ent->leafnums[i]&7) ))
-					break;
-				
-			if (i == ent->num_leafs)
-				continue;		// not visible
+			if (!useindex)	// softquake -- or it's known already
+			{
+				for (i=0 ; i < ent->num_leafs ; i++)
+					if (pvs[ent->leafnums[i] >> 3] & (1 << (ent->leafnums[i]&7) ))
+						break;
+					
+				if (i == ent->num_leafs)
+					continue;		// not visible
+			}
 		}
 
 		if (msg->maxsize - msg->cursize < 16)
-		{
-			Con_Printf ("packet overflow\n");
-			return;
-		}
+			return false;	// softquake -- the caller says so
 
 // send an update
 		bits = 0;
@@ -548,6 +575,30 @@ void SV_WriteEntitiesToClient (edict_t	*clent, sizebuf_t *msg)
 		if (bits & U_ANGLE3)
 			MSG_WriteAngle(msg, ent->v.angles[2]);
 	}
+
+	return true;
+}
+
+/*
+=============
+SV_WriteEntitiesToClient
+
+=============
+*/
+void SV_WriteEntitiesToClient (edict_t	*clent, sizebuf_t *msg)
+{
+	byte	*pvs;
+	vec3_t	org;
+
+// find the client's PVS
+	VectorAdd (clent->v.origin, clent->v.view_ofs, org);
+	if (sv_visindex.value)
+		pvs = SV_ClientFatPVS (clent, org);	// softquake
+	else
+		pvs = SV_FatPVS (org);
+
+	if (!SV_WriteEntitiesInPVS (clent, pvs, msg))
+		Con_Printf ("packet overflow\n");
 }
 
 /*
@@ -604,7 +655,8 @@ void SV_WriteClientdataToMessage (edict_t *ent, sizebuf_t *msg)
 //
 // send the current viewpos offset from the view entity
 //
-	SV_SetIdealPitch ();		// how much to look up / down ideally
+	if (!sv_prebuilding)	// softquake -- otherwise it's been done already
+		SV_SetIdealPitch ();		// how much to look up / down ideally
 
 // a fixangle might get lost in a dropped packet.  Oh well.
 	if ( ent->v.fixangle )
@@ -628,7 +680,7 @@ void SV_WriteClientdataToMessage (edict_t *ent, sizebuf_t *msg)
 #ifdef QUAKE2
 	items = (int)ent->v.items | ((int)ent->v.items2 << 23);
 #else
-	val = GetEdictFieldValue(ent, "items2");
+	val = E_FIELDVALUE(ent, pr_fielditems2);	// softquake
 
 	if (val)
 		items = (int)ent->v.items | ((int)val->_float << 23);
@@ -714,6 +766,110 @@ void SV_WriteClientdataToMessage (edict_t *ent, sizebuf_t *msg)
 	}
 }
 
+/*
+=============================================================================
+
+softquake -- DATAGRAMS BUILT IN PARALLEL
+
+With sv_threadedsend on and more than one client in the game, the datagrams
+of all the clients are put together at once on the worker threads before
+anything is sent, and SV_SendClientDatagram just sends them in the usual order.
+
+Building a datagram only reads the server state, apart from the damage and
+fixangle fields of the client's own edict. The few things that aren't safe to
+do on several threads are done up front on the main thread: finding each
+client's PVS, and SV_SetIdealPitch, which traces.
+
+The one difference: a client dropped while sending doesn't run its disconnect
+QuakeC until after the datagrams for the clients after it have been built.
+
+=============================================================================
+*/
+
+typedef struct
+{
+	qboolean	built;
+	qboolean	packetoverflow;
+	byte		*pvs;
+	sizebuf_t	msg;
+	byte		buf[MAX_DATAGRAM];
+} prebuilt_t;
+
+static	prebuilt_t	sv_prebuilt[MAX_SCOREBOARD];
+static	int			sv_prebuildclients[MAX_SCOREBOARD];
+
+/*
+=======================
+SV_PrebuildDatagram
+=======================
+*/
+static void SV_PrebuildDatagram (void *data, int index)
+{
+	client_t	*client;
+	prebuilt_t	*pre;
+
+	client = &svs.clients[sv_prebuildclients[index]];
+	pre = &sv_prebuilt[sv_prebuildclients[index]];
+
+	pre->msg.data = pre->buf;
+	pre->msg.maxsize = sizeof(pre->buf);
+	pre->msg.cursize = 0;
+	pre->msg.allowoverflow = true;
+	pre->msg.overflowed = false;
+
+	MSG_WriteByte (&pre->msg, svc_time);
+	MSG_WriteFloat (&pre->msg, sv.time);
+
+	SV_WriteClientdataToMessage (client->edict, &pre->msg);
+
+	pre->packetoverflow = !SV_WriteEntitiesInPVS (client->edict, pre->pvs, &pre->msg);
+
+	if (pre->msg.cursize + sv.datagram.cursize < pre->msg.maxsize)
+		SZ_Write (&pre->msg, sv.datagram.data, sv.datagram.cursize);
+
+	pre->built = true;
+}
+
+/*
+=======================
+SV_PrebuildDatagrams
+=======================
+*/
+static void SV_PrebuildDatagrams (void)
+{
+	int			i, count;
+	client_t	*client;
+	vec3_t		org;
+
+	for (i=0 ; i<MAX_SCOREBOARD ; i++)
+		sv_prebuilt[i].built = false;
+
+	if (!sv_threadedsend.value || Jobs_NumThreads () < 2)
+		return;
+
+	count = 0;
+	for (i=0, client = svs.clients ; i<svs.maxclients ; i++, client++)
+	{
+		if (client->active && client->spawned)
+			sv_prebuildclients[count++] = i;
+	}
+	if (count < 2)
+		return;
+
+	for (i=0 ; i<count ; i++)
+	{
+		client = &svs.clients[sv_prebuildclients[i]];
+		VectorAdd (client->edict->v.origin, client->edict->v.view_ofs, org);
+		sv_prebuilt[sv_prebuildclients[i]].pvs = SV_ClientFatPVS (client->edict, org);
+	}
+
+	SV_SetIdealPitch ();
+
+	sv_prebuilding = true;
+	Jobs_Run (SV_PrebuildDatagram, NULL, count);
+	sv_prebuilding = false;
+}
+
 /*
 =======================
 SV_SendClientDatagram
@@ -723,6 +879,22 @@ qboolean SV_SendClientDatagram (client_t *client)
 {
 	byte		buf[MAX_DATAGRAM];
 	sizebuf_t	msg;
+	prebuilt_t	*pre;
+
+// softquake -- it may have been put together already
+	pre = &sv_prebuilt[client - svs.clients];
+	if (pre->built)
+	{
+		pre->built = false;
+		if (pre->packetoverflow)
+			Con_Printf ("packet overflow\n");
+		if (NET_SendUnreliableMessage (client->netconnection, &pre->msg) == -1)
+		{
+			SV_DropClient (true);// if the message couldn't send, kick off
+			return false;
+		}
+		return true;
+	}
 	
 	msg.data = buf;
 	msg.maxsize = sizeof(buf);
@@ -825,6 +997,9 @@ void SV_SendClientMessages (void)
 // update frags, names, etc
 	SV_UpdateToReliableMessages ();
 
+// softquake -- put the datagrams together on the worker threads
+	SV_PrebuildDatagrams ();
+
 // build individual updates
 	for (i=0, host_client = svs.clients ; i<svs.maxclients ; i++, host_client++)
 	{
@@ -1108,6 +1283,7 @@ void SV_SpawnServer (char *server)
 	sv.max_edicts = MAX_EDICTS;
 	
 	sv.edicts = Hunk_AllocName (sv.max_edicts*pr_edict_size, "edicts");
+	memset (sv_edictidle, 0, sizeof(sv_edictidle));	// softquake
 
 	sv.datagram.maxsize = sizeof(sv.datagram_buf);
 	sv.datagram.cursize = 0;
@@ -1153,6 +1329,8 @@ void SV_SpawnServer (char *server)
 // clear world interaction links
 //
 	SV_ClearWorld ();
+	SV_ClearVisIndex (); // softquake
+	SV_ClearProfile (); // softquake
 	
 	sv.sound_precache[0] = pr_strings;
 
@@ -40,6 +40,9 @@ qboolean SV_CheckBottom (edict_t *ent)
 	trace_t	trace;
 	int		x, y;
 	float	mid, bottom;
+	vec3_t	starts[4], stops[4];
+	trace_t	traces[4];
+	int		i;
 	
 	VectorAdd (ent->v.origin, ent->v.mins, mins);
 	VectorAdd (ent->v.origin, ent->v.maxs, maxs);
@@ -78,20 +81,29 @@ realcheck:
 	mid = bottom = trace.endpos[2];
 	
 // the corners must be within 16 of the midpoint	
+// softquake -- traced all at once
 	for	(x=0 ; x<=1 ; x++)
 		for	(y=0 ; y<=1 ; y++)
 		{
-			start[0] = stop[0] = x ? maxs[0] : mins[0];
-			start[1] = stop[1] = y ? maxs[1] : mins[1];
-			
-			trace = SV_Move (start, vec3_origin, vec3_origin, stop, true, ent);
-			
-			if (trace.fraction != 1.0 && trace.endpos[2] > bottom)
-				bottom = trace.endpos[2];
-			if (trace.fraction == 1.0 || mid - trace.endpos[2] > STEPSIZE)
-				return false;
+			i = x*2 + y;
+			starts[i][0] = stops[i][0] = x ? maxs[0] : mins[0];
+			starts[i][1] = stops[i][1] = y ? maxs[1] : mins[1];
+			starts[i][2] = start[2];
+			stops[i][2] = stop[2];
 		}
 
+	SV_MoveBatch (4, starts, vec3_origin, vec3_origin, stops, true, ent, traces);
+
+	for (i=0 ; i<4 ; i++)
+	{
+		trace = traces[i];
+			
+		if (trace.fraction != 1.0 && trace.endpos[2] > bottom)
+			bottom = trace.endpos[2];
+		if (trace.fraction == 1.0 || mid - trace.endpos[2] > STEPSIZE)
+			return false;
+	}
+
 	c_yes++;
 	return true;
 }
@@ -181,6 +193,7 @@ qboolean SV_movestep (edict_t *ent, vec3_t move, qboolean relink)
 			if (relink)
 				SV_LinkEdict (ent, true);
 			ent->v.flags = (int)ent->v.flags & ~FL_ONGROUND;
+			ED_WAKE (ent);	// softquake
 //	Con_Printf ("fall down\n"); 
 			return true;
 		}
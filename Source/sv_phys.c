@@ -44,6 +44,12 @@ cvar_t	sv_stopspeed = {"sv_stopspeed","100"};
 cvar_t	sv_gravity = {"sv_gravity","800",false,true};
 cvar_t	sv_maxvelocity = {"sv_maxvelocity","2000"};
 cvar_t	sv_nostep = {"sv_nostep","0"};
+cvar_t	sv_skipidle = {"sv_skipidle","1",CV_ARCHIVE};	// softquake
+
+// softquake -- edicts that SV_Physics can pass over without touching them,
+// kept apart from the edicts so the whole list stays in a few cache lines
+byte	sv_edictidle[MAX_EDICTS];
+float	sv_edictthink[MAX_EDICTS];		// its nextthink when it went idle
 
 #ifdef QUAKE2
 static	vec3_t	vec_origin = {0.0, 0.0, 0.0};
@@ -380,7 +386,7 @@ void SV_AddGravity (edict_t *ent)
 #else
 	eval_t	*val;
 
-	val = GetEdictFieldValue(ent, "gravity");
+	val = E_FIELDVALUE(ent, pr_fieldgravity);	// softquake
 	if (val && val->_float)
 		ent_gravity = val->_float;
 	else
@@ -502,7 +508,10 @@ void SV_PushMove (edict_t *pusher, float movetime)
 
 	// remove the onground flag for non-players
 		if (check->v.movetype != MOVETYPE_WALK)
+		{
 			check->v.flags = (int)check->v.flags & ~FL_ONGROUND;
+			ED_WAKE (check);	// softquake
+		}
 		
 		VectorCopy (check->v.origin, entorig);
 		VectorCopy (check->v.origin, moved_from[num_moved]);
@@ -628,7 +637,10 @@ void SV_PushRotate (edict_t *pusher, float movetime)
 
 	// remove the onground flag for non-players
 		if (check->v.movetype != MOVETYPE_WALK)
+		{
 			check->v.flags = (int)check->v.flags & ~FL_ONGROUND;
+			ED_WAKE (check);	// softquake
+		}
 		
 		VectorCopy (check->v.origin, entorig);
 		VectorCopy (check->v.origin, moved_from[num_moved]);
@@ -1498,6 +1510,47 @@ void SV_Physics_Step (edict_t *ent)
 
 //============================================================================
 
+/*
+================
+SV_CheckIdle
+
+softquake -- Marks an edict that SV_Physics has just run as idle if all it
+would do next frame, unless it's time for it to think, is nothing: a free
+edict, a MOVETYPE_NONE one, or a tossed one that is resting on the ground.
+Pushers move their ltime forward every frame, so they're never idle.
+
+Running its think function, or QuakeC or the engine changing its movetype,
+flags or nextthink, wakes it up again with ED_WAKE.
+================
+*/
+void SV_CheckIdle (edict_t *ent, int num)
+{
+	int		movetype;
+
+	if (!sv_skipidle.value || num <= svs.maxclients)
+		return;
+
+	if (!ent->free)
+	{
+		movetype = ent->v.movetype;
+		if (movetype == MOVETYPE_NONE)
+			;
+#ifndef QUAKE2
+		else if ((movetype == MOVETYPE_TOSS
+		|| movetype == MOVETYPE_BOUNCE
+		|| movetype == MOVETYPE_FLY
+		|| movetype == MOVETYPE_FLYMISSILE)
+		&& ((int)ent->v.flags & FL_ONGROUND))
+			;
+#endif
+		else
+			return;
+	}
+
+	sv_edictthink[num] = ent->free ? -1 : ent->v.nextthink;
+	sv_edictidle[num] = 1;
+}
+
 /*
 ================
 SV_Physics
@@ -1508,6 +1561,9 @@ void SV_Physics (void)
 {
 	int		i;
 	edict_t	*ent;
+	profphase_t	phase;		// softquake
+	double	prof;
+	float	thinktime;
 
 // let the progs know that a new frame has started
 	pr_global_struct->self = EDICT_TO_PROG(sv.edicts);
@@ -1523,14 +1579,28 @@ void SV_Physics (void)
 	ent = sv.edicts;
 	for (i=0 ; i<sv.num_edicts ; i++, ent = NEXT_EDICT(ent))
 	{
+		if (sv_edictidle[i] && sv_skipidle.value && !pr_global_struct->force_retouch)
+		{	// softquake -- see SV_CheckIdle
+			thinktime = sv_edictthink[i];
+			if (thinktime <= 0 || thinktime > sv.time + host_frametime)
+				continue;
+		}
+		sv_edictidle[i] = 0;
+
 		if (ent->free)
+		{
+			SV_CheckIdle (ent, i);	// softquake
 			continue;
+		}
 
 		if (pr_global_struct->force_retouch)
 		{
 			SV_LinkEdict (ent, true);	// force retouch even for stationary
 		}
 
+		prof = SV_ProfileTime ();	// softquake
+		phase = sv_profiling ? SV_ProfilePhase (ent, i) : prof_other;
+
 		if (i > 0 && i <= svs.maxclients)
 			SV_Physics_Client (ent, i);
 		else if (ent->v.movetype == MOVETYPE_PUSH)
@@ -1555,6 +1625,9 @@ void SV_Physics (void)
 			SV_Physics_Toss (ent);
 		else
 			Sys_Error ("SV_Physics: bad movetype %i", (int)ent->v.movetype);			
+
+		SV_ProfileAdd (phase, prof);	// softquake
+		SV_CheckIdle (ent, i);			// softquake
 	}
 	
 	if (pr_global_struct->force_retouch)
@@ -0,0 +1,386 @@
+/*
+Copyright (C) 2023-2023 softquake
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+// sv_prof.c -- times each server frame, a phase at a time
+
+// With sv_profile on, Host_ServerFrame times reading the client messages,
+// the physics and sending the updates, and SV_Physics splits its time up by
+// the kind of physics each edict gets. The QuakeC functions that ran the most
+// statements come from the same counters the 'profile' command uses, so the
+// translated functions of pr_nativecode aren't seen.
+//
+// The last PROF_TICKS frames are kept, and 'tickstats' prints percentiles of
+// them or writes them all out to a csv file.
+
+#include "quakedef.h"
+
+cvar_t	sv_profile = {"sv_profile", "0"};
+
+qboolean	sv_profiling;
+
+#define	PROF_TICKS		1024
+#define	PROF_TOPFUNCS	4
+
+typedef struct
+{
+	double	time;							// sv.time when it started
+	float	phases[prof_numphases];			// in seconds
+	short	counts[prof_numphases];			// times each phase was timed
+	int		statements;
+	int		funcs[PROF_TOPFUNCS];			// function numbers, 0 for none
+	int		funcstatements[PROF_TOPFUNCS];
+} proftick_t;
+
+static	char		*sv_profphasenames[prof_numphases] =
+{
+	"runclients", "physics", "client", "pusher", "step", "toss", "other", "send", "total"
+};
+
+static	proftick_t	sv_profticks[PROF_TICKS];
+static	int			sv_profnumticks;		// ever recorded, the ring wraps around
+static	proftick_t	*sv_proftick;			// the one being recorded
+
+static	int			*sv_proflast;			// profile counts at the start of the frame
+static	int			*sv_proftotals;			// for adding up the ring
+static	int			sv_profnumfunctions;
+static	double		sv_profstart;
+
+static void SV_TickStats_f (void);
+
+
+/*
+===============
+SV_InitProfile
+===============
+*/
+void SV_InitProfile (void)
+{
+	Cvar_RegisterVariable (&sv_profile);
+	Cmd_AddCommand ("tickstats", SV_TickStats_f);
+}
+
+
+/*
+===============
+SV_ClearProfile
+
+Called once the progs have been loaded, function numbers aren't the same
+from one map to the next
+===============
+*/
+void SV_ClearProfile (void)
+{
+	sv_profnumfunctions = progs->numfunctions;
+	sv_proflast = Hunk_AllocName (sv_profnumfunctions*sizeof(int), "proflast");
+	sv_proftotals = Hunk_AllocName (sv_profnumfunctions*sizeof(int), "proftotal");
+	sv_profnumticks = 0;
+	sv_profiling = false;
+}
+
+
+/*
+===============
+SV_ProfileStartTick
+===============
+*/
+void SV_ProfileStartTick (void)
+{
+	int		i;
+
+	if (!sv_profile.value || !sv_proflast)
+	{
+		sv_profiling = false;
+		return;
+	}
+
+	if (!sv_profiling)
+	{	// only count the statements run from now on
+		for (i=0 ; i<sv_profnumfunctions ; i++)
+			sv_proflast[i] = pr_functions[i].profile;
+		sv_profiling = true;
+	}
+
+	sv_proftick = &sv_profticks[sv_profnumticks % PROF_TICKS];
+	memset (sv_proftick, 0, sizeof(*sv_proftick));
+	sv_proftick->time = sv.time;
+	sv_profstart = Sys_PreciseTime ();
+}
+
+
+/*
+===============
+SV_ProfileTime
+
+Returns 0 without reading the clock if nothing is being recorded
+===============
+*/
+double SV_ProfileTime (void)
+{
+	if (!sv_profiling)
+		return 0;
+	return Sys_PreciseTime ();
+}
+
+
+/*
+===============
+SV_ProfileAdd
+
+Adds the time since start, from SV_ProfileTime, to a phase
+===============
+*/
+void SV_ProfileAdd (profphase_t phase, double start)
+{
+	if (!sv_profiling)
+		return;
+	sv_proftick->phases[phase] += Sys_PreciseTime () - start;
+	sv_proftick->counts[phase]++;
+}
+
+
+/*
+===============
+SV_ProfilePhase
+
+Which phase SV_Physics will put an edict's time in
+===============
+*/
+profphase_t SV_ProfilePhase (edict_t *ent, int num)
+{
+	if (num > 0 && num <= svs.maxclients)
+		return prof_client;
+
+	switch ((int)ent->v.movetype)
+	{
+	case MOVETYPE_PUSH:
+		return prof_pusher;
+	case MOVETYPE_STEP:
+		return prof_step;
+	case MOVETYPE_TOSS:
+	case MOVETYPE_BOUNCE:
+#ifdef QUAKE2
+	case MOVETYPE_BOUNCEMISSILE:
+#endif
+	case MOVETYPE_FLY:
+	case MOVETYPE_FLYMISSILE:
+		return prof_toss;
+	}
+	return prof_other;
+}
+
+
+/*
+===============
+SV_ProfileEndTick
+===============
+*/
+void SV_ProfileEndTick (void)
+{
+	proftick_t	*tick;
+	int			i, j, count;
+
+	if (!sv_profiling)
+		return;
+
+	tick = sv_proftick;
+	tick->phases[prof_total] = Sys_PreciseTime () - sv_profstart;
+	tick->counts[prof_total] = 1;
+
+// keep the functions that ran the most statements, in order
+	for (i=0 ; i<sv_profnumfunctions ; i++)
+	{
+		count = pr_functions[i].profile - sv_proflast[i];
+		if (count < 0)		// 'profile' cleared it
+			count = pr_functions[i].profile;
+		sv_proflast[i] = pr_functions[i].profile;
+		if (!count)
+			continue;
+
+		tick->statements += count;
+		for (j=PROF_TOPFUNCS ; j>0 && tick->funcstatements[j-1] < count ; j--)
+		{
+			if (j < PROF_TOPFUNCS)
+			{
+				tick->funcs[j] = tick->funcs[j-1];
+				tick->funcstatements[j] = tick->funcstatements[j-1];
+			}
+		}
+		if (j < PROF_TOPFUNCS)
+		{
+			tick->funcs[j] = i;
+			tick->funcstatements[j] = count;
+		}
+	}
+
+	sv_profnumticks++;
+}
+
+
+/*
+===============
+SV_ProfileCompare
+===============
+*/
+static int SV_ProfileCompare (const void *a, const void *b)
+{
+	float	fa, fb;
+
+	fa = *(float *)a;
+	fb = *(float *)b;
+	if (fa < fb)
+		return -1;
+	return fa > fb;
+}
+
+
+/*
+===============
+SV_TickStatsCSV
+===============
+*/
+static void SV_TickStatsCSV (char *filename, int numticks)
+{
+	char		name[MAX_OSPATH];
+	FILE		*f;
+	proftick_t	*tick;
+	int			i, j;
+
+	q_snprintf (name, sizeof(name), "%s/%s", com_gamedir, filename);
+	COM_DefaultExtension (name, ".csv");
+
+	f = fopen (name, "w");
+	if (!f)
+	{
+		Con_Printf ("ERROR: couldn't open %s.\n", name);
+		return;
+	}
+
+	fprintf (f, "time");
+	for (j=0 ; j<prof_numphases ; j++)
+		fprintf (f, ",%s_ms,%s_count", sv_profphasenames[j], sv_profphasenames[j]);
+	fprintf (f, ",statements");
+	for (j=0 ; j<PROF_TOPFUNCS ; j++)
+		fprintf (f, ",func%i,func%i_statements", j+1, j+1);
+	fprintf (f, "\n");
+
+	for (i=sv_profnumticks-numticks ; i<sv_profnumticks ; i++)
+	{
+		tick = &sv_profticks[i % PROF_TICKS];
+		fprintf (f, "%.3f", tick->time);
+		for (j=0 ; j<prof_numphases ; j++)
+			fprintf (f, ",%.4f,%i", tick->phases[j]*1000, tick->counts[j]);
+		fprintf (f, ",%i", tick->statements);
+		for (j=0 ; j<PROF_TOPFUNCS ; j++)
+		{
+			if (tick->funcstatements[j])
+				fprintf (f, ",%s,%i", pr_strings + pr_functions[tick->funcs[j]].s_name, tick->funcstatements[j]);
+			else
+				fprintf (f, ",,");
+		}
+		fprintf (f, "\n");
+	}
+
+	fclose (f);
+	Con_Printf ("Wrote %i frames to %s\n", numticks, name);
+}
+
+
+/*
+===============
+SV_TickStats_f
+
+tickstats [csv file]
+===============
+*/
+static void SV_TickStats_f (void)
+{
+	static float	times[PROF_TICKS];
+	proftick_t	*tick;
+	int			i, j, numticks, best, counts;
+	double		total;
+
+	if (!sv.active || !sv_proflast)
+	{
+		Con_Printf ("No server running\n");
+		return;
+	}
+
+	numticks = sv_profnumticks < PROF_TICKS ? sv_profnumticks : PROF_TICKS;
+	if (!numticks)
+	{
+		Con_Printf ("Set sv_profile 1 to time server frames\n");
+		return;
+	}
+
+	if (Cmd_Argc() > 1)
+	{
+		SV_TickStatsCSV (Cmd_Argv(1), numticks);
+		return;
+	}
+
+	Con_Printf ("%i frames, %.1f seconds\n", numticks,
+		sv_profticks[(sv_profnumticks-1) % PROF_TICKS].time
+		- sv_profticks[(sv_profnumticks-numticks) % PROF_TICKS].time);
+	Con_Printf ("ms          avg   50%%   90%%   99%%    max\n");
+
+	for (j=0 ; j<prof_numphases ; j++)
+	{
+		total = 0;
+		counts = 0;
+		for (i=0 ; i<numticks ; i++)
+		{
+			tick = &sv_profticks[i];
+			times[i] = tick->phases[j]*1000;
+			total += times[i];
+			counts += tick->counts[j];
+		}
+		if (!counts)
+			continue;
+
+		qsort (times, numticks, sizeof(float), SV_ProfileCompare);
+		Con_Printf ("%-10s%6.2f%6.2f%6.2f%6.2f%7.2f\n", sv_profphasenames[j],
+			total / numticks, times[numticks*50/100], times[numticks*90/100],
+			times[numticks*99/100], times[numticks-1]);
+	}
+
+// add up the functions each frame kept
+	memset (sv_proftotals, 0, sv_profnumfunctions*sizeof(int));
+	total = 0;
+	for (i=0 ; i<numticks ; i++)
+	{
+		tick = &sv_profticks[i];
+		total += tick->statements;
+		for (j=0 ; j<PROF_TOPFUNCS ; j++)
+			sv_proftotals[tick->funcs[j]] += tick->funcstatements[j];
+	}
+
+	Con_Printf ("%.0f statements per frame\n", total / numticks);
+	for (j=0 ; j<10 ; j++)
+	{
+		best = 0;
+		for (i=1 ; i<sv_profnumfunctions ; i++)
+			if (sv_proftotals[i] > sv_proftotals[best])
+				best = i;
+		if (!sv_proftotals[best])
+			break;
+		Con_Printf ("%9i %s\n", sv_proftotals[best] / numticks, pr_strings + pr_functions[best].s_name);
+		sv_proftotals[best] = 0;
+	}
+}
@@ -0,0 +1,276 @@
+/*
+Copyright (C) 2023-2023 softquake
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+// sv_vis.c -- finds the entities a client can see without looking at all of them
+
+// SV_WriteEntitiesToClient used to go through every edict for every client,
+// checking each of its leafs against a fat PVS that was built from scratch
+// every frame.
+//
+// Instead, every leaf of the world keeps a list of the entities touching it,
+// kept up to date by SV_LinkEdict whenever it works out an entity's leafnums.
+// An entity is visible if it's in any leaf the fat PVS has, so the entities
+// to send are the ones on the lists of those leafs. Each client also keeps
+// its last fat PVS, along with the leafs that went into it, and uses it again
+// for as long as it would come out the same.
+//
+// The entities still come out in edict order, so the messages are the same
+// as before. sv_visindex 0 goes back to checking every edict.
+//
+// SV_ClientFatPVS has to run on the main thread, but once it has, any number
+// of clients can go through SV_VisibleEdicts at the same time.
+
+#include "quakedef.h"
+
+cvar_t	sv_visindex = {"sv_visindex", "1", CV_ARCHIVE};
+
+#define	MAX_FATLEAFS	64
+
+typedef struct
+{
+	int		next, prev;		// -1 ends the list
+	int		leafnum;
+} visnode_t;
+
+typedef struct
+{
+	int		numleafs;		// -1 when the pvs can't be used again
+	mleaf_t	*leafs[MAX_FATLEAFS];
+	byte	pvs[MAX_MAP_LEAFS/8];
+} fatcache_t;
+
+// an entity's nodes start at edictnum*MAX_ENT_LEAFS
+static	visnode_t	sv_visnodes[MAX_EDICTS*MAX_ENT_LEAFS];
+static	byte		sv_visnumnodes[MAX_EDICTS];
+
+static	int			*sv_visleafs;		// first node of each leaf
+static	int			sv_numvisleafs;
+
+static	fatcache_t	sv_fatcache[MAX_SCOREBOARD];
+
+static	mleaf_t		*fatleafs[MAX_FATLEAFS];
+static	int			numfatleafs;
+
+
+/*
+===============
+SV_InitVis
+===============
+*/
+void SV_InitVis (void)
+{
+	Cvar_RegisterVariable (&sv_visindex);
+}
+
+
+/*
+===============
+SV_ClearVisIndex
+
+Called after the world model has been loaded, before linking any entities
+===============
+*/
+void SV_ClearVisIndex (void)
+{
+	int		i;
+
+	sv_numvisleafs = sv.worldmodel->numleafs;
+	sv_visleafs = Hunk_AllocName (sv_numvisleafs*sizeof(int), "visindex");
+	for (i=0 ; i<sv_numvisleafs ; i++)
+		sv_visleafs[i] = -1;
+
+	memset (sv_visnumnodes, 0, sizeof(sv_visnumnodes));
+
+	for (i=0 ; i<MAX_SCOREBOARD ; i++)
+		sv_fatcache[i].numleafs = -1;
+}
+
+
+/*
+===============
+SV_LinkVisIndex
+
+Called by SV_LinkEdict each time it has found the leafs of an entity
+===============
+*/
+void SV_LinkVisIndex (edict_t *ent)
+{
+	visnode_t	*node, *first;
+	int			i, e, n;
+
+	e = NUM_FOR_EDICT(ent);
+	first = &sv_visnodes[e*MAX_ENT_LEAFS];
+
+// take it out of the leafs it was in
+	for (i=0, node=first ; i<sv_visnumnodes[e] ; i++, node++)
+	{
+		if (node->prev != -1)
+			sv_visnodes[node->prev].next = node->next;
+		else
+			sv_visleafs[node->leafnum] = node->next;
+		if (node->next != -1)
+			sv_visnodes[node->next].prev = node->prev;
+	}
+
+// and put it in the new ones
+	for (i=0, node=first ; i<ent->num_leafs ; i++, node++)
+	{
+		n = node - sv_visnodes;
+		node->leafnum = ent->leafnums[i];
+		node->prev = -1;
+		node->next = sv_visleafs[node->leafnum];
+		if (node->next != -1)
+			sv_visnodes[node->next].prev = n;
+		sv_visleafs[node->leafnum] = n;
+	}
+	sv_visnumnodes[e] = ent->num_leafs;
+}
+
+
+/*
+=============
+SV_FatPVSLeafs
+
+Finds the leafs that SV_AddToFatPVS would put together
+=============
+*/
+static void SV_FatPVSLeafs (vec3_t org, mnode_t *node)
+{
+	mplane_t	*plane;
+	float		d;
+
+	while (1)
+	{
+		if (node->contents < 0)
+		{
+			if (node->contents != CONTENTS_SOLID)
+			{
+				if (numfatleafs < MAX_FATLEAFS)
+					fatleafs[numfatleafs] = (mleaf_t *)node;
+				numfatleafs++;
+			}
+			return;
+		}
+
+		plane = node->plane;
+		d = DotProduct (org, plane->normal) - plane->dist;
+		if (d > 8)
+			node = node->children[0];
+		else if (d < -8)
+			node = node->children[1];
+		else
+		{	// go down both
+			SV_FatPVSLeafs (org, node->children[0]);
+			node = node->children[1];
+		}
+	}
+}
+
+
+/*
+=============
+SV_ClientFatPVS
+
+SV_FatPVS, but each client gets its own copy, which is kept for as long as
+it would come out the same
+=============
+*/
+byte *SV_ClientFatPVS (edict_t *clent, vec3_t org)
+{
+	fatcache_t	*cache;
+	byte		*pvs;
+	int			clientnum;
+
+	clientnum = NUM_FOR_EDICT(clent) - 1;
+	if (clientnum < 0 || clientnum >= MAX_SCOREBOARD)
+		return SV_FatPVS (org);
+	cache = &sv_fatcache[clientnum];
+
+	numfatleafs = 0;
+	SV_FatPVSLeafs (org, sv.worldmodel->nodes);
+
+	if (cache->numleafs == numfatleafs
+	&& !memcmp (cache->leafs, fatleafs, numfatleafs*sizeof(mleaf_t *)))
+		return cache->pvs;
+
+	pvs = SV_FatPVS (org);
+	memcpy (cache->pvs, pvs, (sv_numvisleafs+7)>>3);
+	if (numfatleafs > MAX_FATLEAFS)
+		cache->numleafs = -1;
+	else
+	{
+		memcpy (cache->leafs, fatleafs, numfatleafs*sizeof(mleaf_t *));
+		cache->numleafs = numfatleafs;
+	}
+	return cache->pvs;
+}
+
+
+/*
+=============
+SV_VisibleEdicts
+
+Fills in the numbers of the edicts touching a leaf in pvs, always including
+clent, in order. Doesn't check whether they have models.
+=============
+*/
+int SV_VisibleEdicts (edict_t *clent, byte *pvs, int *list)
+{
+	unsigned	visbits[(MAX_EDICTS+31)/32];
+	unsigned	bits;
+	int			i, l, n, e, words, count;
+
+	words = (sv.num_edicts+31)>>5;
+	memset (visbits, 0, words*sizeof(unsigned));
+
+	for (i=0 ; i<sv_numvisleafs ; i+=8)
+	{
+		if (!pvs[i>>3])
+			continue;
+		for (l=i ; l<i+8 && l<sv_numvisleafs ; l++)
+		{
+			if (!(pvs[l>>3] & (1<<(l&7))))
+				continue;
+			for (n=sv_visleafs[l] ; n != -1 ; n=sv_visnodes[n].next)
+			{
+				e = n / MAX_ENT_LEAFS;
+				visbits[e>>5] |= 1u<<(e&31);
+			}
+		}
+	}
+
+	e = NUM_FOR_EDICT(clent);
+	visbits[e>>5] |= 1u<<(e&31);
+
+	count = 0;
+	for (i=0 ; i<words ; i++)
+	{
+		for (bits=visbits[i] ; bits ; bits &= bits-1)
+		{
+			for (e=0 ; !(bits & (1u<<e)) ; e++)
+				;
+			e += i<<5;
+			if (e >= 1 && e < sv.num_edicts)
+				list[count++] = e;
+		}
+	}
+
+	return count;
+}
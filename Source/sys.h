@@ -35,6 +35,9 @@ void Sys_FileSeek (int handle, int position);
 int Sys_FileRead (int handle, void *dest, int count);
 int Sys_FileWrite (int handle, void *data, int count);
 int	Sys_FileTime (char *path);
+void *Sys_FileMap (int handle, int length);
+// softquake -- maps a whole open file copy-on-write, so it can be written to
+// without changing the file. Returns NULL if it can't.
 void Sys_mkdir (char *path);
 
 //
@@ -57,6 +60,10 @@ void Sys_Quit (void);
 
 double Sys_FloatTime (void);
 
+double Sys_PreciseTime (void);	// softquake
+// seconds from a high resolution clock, only good for measuring how long
+// something took, Sys_FloatTime only counts whole milliseconds
+
 char *Sys_ConsoleInput (void);
 
 void Sys_Sleep (void);
@@ -117,6 +117,11 @@ int Sys_FileWrite (int handle, void *data, int count)
 	return fwrite (data, 1, count, sys_handles[handle]);
 }
 
+void *Sys_FileMap (int handle, int length)
+{
+	return NULL;
+}
+
 int     Sys_FileTime (char *path)
 {
 	FILE    *f;
@@ -185,6 +190,11 @@ double Sys_FloatTime (void)
 	return t;
 }
 
+double Sys_PreciseTime (void)
+{
+	return Sys_FloatTime ();
+}
+
 char *Sys_ConsoleInput (void)
 {
 	return NULL;
@@ -35,6 +35,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <time.h>
 #ifdef DO_USERDIRS
 #include <pwd.h>
@@ -170,6 +171,16 @@ int Sys_FileWrite (int handle, void *data, int count)
 	return fwrite (data, 1, count, sys_handles[handle]);
 }
 
+void *Sys_FileMap (int handle, int length)
+{
+	void	*data;
+
+	data = mmap (NULL, length, PROT_READ|PROT_WRITE, MAP_PRIVATE, fileno (sys_handles[handle]), 0);
+	if (data == MAP_FAILED)
+		return NULL;
+	return data;
+}
+
 int Sys_FileTime (char *path)
 {
 	FILE	*f;
@@ -358,6 +369,16 @@ double Sys_FloatTime (void)
 	return Sys_DoubleTime();
 }
 
+// softquake
+double Sys_PreciseTime (void)
+{
+	static double	scale;
+
+	if (!scale)
+		scale = 1.0 / SDL_GetPerformanceFrequency();
+	return SDL_GetPerformanceCounter() * scale;
+}
+
 void Sys_HighFPPrecision()
 {
 	// Stub
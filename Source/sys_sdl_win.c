@@ -143,6 +143,19 @@ int Sys_FileWrite (int handle, void *data, int count)
 	return fwrite (data, 1, count, sys_handles[handle]);
 }
 
+void *Sys_FileMap (int handle, int length)
+{
+	HANDLE	mapping;
+	void	*data;
+
+	mapping = CreateFileMapping ((HANDLE)_get_osfhandle (_fileno (sys_handles[handle])), NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	if (!mapping)
+		return NULL;
+	data = MapViewOfFile (mapping, FILE_MAP_COPY, 0, 0, length);
+	CloseHandle (mapping);		// the view keeps it open
+	return data;
+}
+
 int Sys_FileTime (char *path)
 {
 	FILE	*f;
@@ -384,6 +397,16 @@ double Sys_FloatTime (void)
 	return Sys_DoubleTime();
 }
 
+// softquake
+double Sys_PreciseTime (void)
+{
+	static double	scale;
+
+	if (!scale)
+		scale = 1.0 / SDL_GetPerformanceFrequency();
+	return SDL_GetPerformanceCounter() * scale;
+}
+
 char *Sys_ConsoleInput (void)
 {
 	static char	con_text[256];
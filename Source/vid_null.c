@@ -65,6 +65,19 @@ void	VID_Update (vrect_t *rects)
 {
 }
 
+// softquake -- called by the host and keys no matter the driver
+void	VID_LockVariables (void)
+{
+}
+
+void	VID_UnlockVariables (void)
+{
+}
+
+void	VID_ToggleFullscreen (void)
+{
+}
+
 /*
 ================
 D_BeginDirectRect
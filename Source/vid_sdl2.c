@@ -38,6 +38,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "sdl_common.h"
 
+#ifdef SIMD_X86
+#include <immintrin.h>
+#endif
+
 
 #define SAFE_FREE(p) free(p); p = NULL
 
@@ -109,6 +113,7 @@ static void VID_SetColorMod(float r, float g, float b);
 void VID_ReallocateTexture(void);
 void VID_ColorMod_f();
 static void D_FlushDirectRect(void);
+static void VID_StopPresentThread(void);
 
 
 /**********************************
@@ -298,6 +303,8 @@ qboolean vid_first_time = true;
 
 static void VID_SetFramebufferMode(int width, int height)
 {
+	VID_StopPresentThread();
+
 	quake_width = width;
 	quake_height = height;
 
@@ -352,6 +359,33 @@ static vid_context ctx;
 int vid_client_width = 0;
 int vid_client_height = 0;
 
+/**********************************
+* Present thread
+**********************************/
+// softquake -- A finished frame, either handed over to the present thread or presented right away
+typedef struct
+{
+	u8 *pixels; // 8 bit, quake_width * quake_height
+	const color_lookup_t *palette;
+	color_lookup_t palette_copy[256];
+	int client_width;
+	int client_height;
+} present_frame_t;
+
+// One being presented, one waiting, and one to copy the next frame into,
+// so the game never has to wait on the present thread
+#define PRESENT_FRAME_COUNT 3
+
+static SDL_Thread *present_thread;
+static SDL_mutex *present_lock;
+static SDL_cond *present_wake;
+static present_frame_t present_frames[PRESENT_FRAME_COUNT];
+static present_frame_t *present_pending; // Newest frame, not picked up yet
+static present_frame_t *present_current; // Frame being presented right now
+static qboolean present_quit;
+static color_lookup_t present_gl_palette[256]; // Last palette sent to the shader from the present thread
+static qboolean present_gl_palette_valid;
+
 /**********************************
 * OpenGL backend
 **********************************/
@@ -680,6 +714,13 @@ cvar_t vid_bpp = {"vid_bpp", "24", true};
 
 cvar_t vid_mode = {"vid_mode", "0", true};
 
+// softquake -- Write the frame straight into the streaming texture with SDL_LockTexture
+// Only used by the sdl backend
+cvar_t sw_locktexture = {"sw_locktexture", "1", CV_ARCHIVE};
+
+// softquake -- Convert, upload and present each frame on a separate thread
+cvar_t sw_presentthread = {"sw_presentthread", "0", CV_ARCHIVE};
+
 
 void VID_Restart(void);
 void VID_Restart_f(void)
@@ -711,6 +752,8 @@ void VID_ReallocateTexture(void)
 {
 	if(!ctx.BackendInitialized) return;
 
+	VID_StopPresentThread();
+
 	switch(render_backend)
 	{
 		case RENDER_BACKEND_SDL:
@@ -760,6 +803,8 @@ void VID_Restart(void)
 	Uint32 FullscreenFlag = 0;
 	Uint32 WindowFlags = 0;
 
+	VID_StopPresentThread();
+
 	VID_UnlockVariables();
 
 	if(vid_fullscreen.value)
@@ -1095,6 +1140,8 @@ void VID_Init(unsigned char *palette)
 	Cvar_RegisterVariable(&vid_height);
 	Cvar_RegisterVariable(&vid_refreshrate);
 	Cvar_RegisterVariable(&vid_bpp);
+	Cvar_RegisterVariable(&sw_locktexture);
+	Cvar_RegisterVariable(&sw_presentthread);
 
 	Cvar_RegisterCallback(&fb_mode, VID_FBMode_cb);
 
@@ -1197,7 +1244,7 @@ void VID_StorePalette(unsigned char *palette)
 	}
 }
 
-void GL_UpdatePalette(void)
+static void GL_UploadPalette(const color_lookup_t *palette)
 {
 	if(gl_glsl_enabled)
 	{
@@ -1212,9 +1259,9 @@ void GL_UpdatePalette(void)
 
 		for(i = 0; i < 256; i++)
 		{
-			float r = vid_palette32_mod[i].r / 255.0f;
-			float g = vid_palette32_mod[i].g / 255.0f;
-			float b = vid_palette32_mod[i].b / 255.0f;
+			float r = palette[i].r / 255.0f;
+			float g = palette[i].g / 255.0f;
+			float b = palette[i].b / 255.0f;
 
 			glsl_vec3[i].r = r;
 			glsl_vec3[i].g = g;
@@ -1229,6 +1276,11 @@ void GL_UpdatePalette(void)
 	}
 }
 
+void GL_UpdatePalette(void)
+{
+	GL_UploadPalette(vid_palette32_mod);
+}
+
 void VID_UpdatePalette(void)
 {
 	switch(render_backend)
@@ -1237,6 +1289,8 @@ void VID_UpdatePalette(void)
 			// Already taken care of by VID_SetPalette
 			break;
 		case RENDER_BACKEND_OPENGL:
+			// The present thread owns the context, and sends the palette along with each frame
+			if(present_thread) break;
 			GL_UpdatePalette();
 			break;
 		default:
@@ -1253,57 +1307,110 @@ void VID_SetPalette(unsigned char *palette)
 }
 
 // No indexed texture modes, just doing it directly in software
-static void CopyTexture8ToTexture32(void)
+static void CopyRow8To32(const u8 *src, color_lookup_t *dest, int width, const color_lookup_t *palette)
 {
-	int x, y;
-	int idx = 0;
-	const u8 *vram8 = vid_memory8;
-	color_lookup_t *vram32 = (color_lookup_t *)vid_memory32;
+	int x;
 
 	// Now unrolled for a bit of speed gain
+	for(x = 0; x < width; x += 4)
+	{
+		dest[x + 0] = palette[src[x + 0]];
+		dest[x + 1] = palette[src[x + 1]];
+		dest[x + 2] = palette[src[x + 2]];
+		dest[x + 3] = palette[src[x + 3]];
+	}
+}
+
+#ifdef SIMD_X86
+// Eight palette lookups per gather
+TARGET_AVX2
+static void CopyRow8To32AVX2(const u8 *src, color_lookup_t *dest, int width, const color_lookup_t *palette)
+{
+	int x;
+	__m256i index, color;
+	const int *lookup = (const int *)palette;
+
+	for(x = 0; x + 8 <= width; x += 8)
+	{
+		index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + x)));
+		color = _mm256_i32gather_epi32(lookup, index, 4);
+		_mm256_storeu_si256((__m256i *)(dest + x), color);
+	}
+
+	if(x < width)
+	{
+		CopyRow8To32(src + x, dest + x, width - x, palette);
+	}
+}
+#endif
+
+// softquake -- Takes the destination and its pitch, so it can write straight into a locked texture
+static void CopyTexture8ToTexture32(const present_frame_t *frame, void *dest, int pitch)
+{
+	int y;
+	const u8 *vram8 = frame->pixels;
+	u8 *vram32 = dest;
+	void (*CopyRow)(const u8 *src, color_lookup_t *dest, int width, const color_lookup_t *palette) = CopyRow8To32;
+
 	q_assert(vid.width % 4 == 0);
 
+#ifdef SIMD_X86
+	if(cpu_avx2 && d_simd.value)
+	{
+		CopyRow = CopyRow8To32AVX2;
+	}
+#endif
+
 	for(y = 0; y < vid.height; y++)
 	{
-		for(x = 0; x < vid.width; x += 4)
-		{
-			vram32[idx + 0] = vid_palette32_mod[vram8[idx + 0]];
-			vram32[idx + 1] = vid_palette32_mod[vram8[idx + 1]];
-			vram32[idx + 2] = vid_palette32_mod[vram8[idx + 2]];
-			vram32[idx + 3] = vid_palette32_mod[vram8[idx + 3]];
+		CopyRow(vram8, (color_lookup_t *)vram32, vid.width, frame->palette);
 
-			idx += 4;
-		}
+		vram8 += vid.width;
+		vram32 += pitch;
 	}
 }
 
-void SW_Render(void)
+void SW_Render(const present_frame_t *frame)
 {
-	CopyTexture8ToTexture32();
+	void *pixels;
+	int pitch;
+
+	// Lock the streaming texture and write into it directly.
+	// Saves a copy through vid_memory32 on most drivers.
+	if(sw_locktexture.value && SDL_LockTexture(ctx.RenderTarget, 0, &pixels, &pitch) == 0)
+	{
+		CopyTexture8ToTexture32(frame, pixels, pitch);
+		SDL_UnlockTexture(ctx.RenderTarget);
+		SDL_RenderClear(ctx.Renderer);
+	}
+	else
+	{
+		CopyTexture8ToTexture32(frame, vid_memory32, vid.width * 4);
+		SDL_RenderClear(ctx.Renderer);
+		SDL_UpdateTexture(ctx.RenderTarget, 0, vid_memory32, vid.width * 4);
+	}
 
-	SDL_RenderClear(ctx.Renderer);
-	SDL_UpdateTexture(ctx.RenderTarget, 0, vid_memory32, vid.width * 4);
 	SDL_RenderCopyEx(ctx.Renderer, ctx.RenderTarget, 0, 0, 0, 0, SDL_FLIP_NONE);
 	SDL_RenderPresent(ctx.Renderer);
 }
 
-void GL_Render(void)
+void GL_Render(const present_frame_t *frame)
 {
 	const float s = 1;
 
 	if(gl_glsl_enabled)
 	{
-		qglTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, quake_width, quake_height, GL_RED, GL_UNSIGNED_BYTE, vid_memory8);
+		qglTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, quake_width, quake_height, GL_RED, GL_UNSIGNED_BYTE, frame->pixels);
 	}
 	else
 	{
-		CopyTexture8ToTexture32();
+		CopyTexture8ToTexture32(frame, vid_memory32, vid.width * 4);
 		qglTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, quake_width, quake_height, GL_RGBA, GL_UNSIGNED_BYTE, vid_memory32);
 	}
 
 
 	qglClear(GL_COLOR_BUFFER_BIT);
-	qglViewport(0, 0, vid_client_width, vid_client_height);
+	qglViewport(0, 0, frame->client_width, frame->client_height);
 
 	qglBegin(GL_QUADS);
 
@@ -1324,21 +1431,215 @@ void SW_InitBackend(void)
 }
 
 
-void VID_Update(vrect_t *rects)
+static void VID_PresentFrame(const present_frame_t *frame)
 {
-	D_FlushDirectRect();
-
 	switch(render_backend)
 	{
 		case RENDER_BACKEND_SDL:
-			SW_Render();
+			SW_Render(frame);
 			break;
 		case RENDER_BACKEND_OPENGL:
-			GL_Render();
+			GL_Render(frame);
 			break;
 		default:
 			Sys_Error("Render backend not handled\n");
 	}
+}
+
+// softquake -- Present thread
+// The game copies each finished 8 bit frame (and the palette it goes with) into a spare buffer and moves on,
+// while this thread does the palette conversion, texture upload and the (possibly vsynced) swap.
+// If the game gets ahead, frames that were never picked up are replaced by newer ones.
+// The renderer is only ever used by one thread at a time. Anything on the main thread that touches it
+// (vid_restart, vsync, framebuffer mode changes, shutdown) stops the thread first,
+// and VID_Update starts it up again.
+static int VID_PresentThread(void *unused)
+{
+	present_frame_t *frame;
+
+	if(render_backend == RENDER_BACKEND_OPENGL)
+	{
+		SDL_GL_MakeCurrent(ctx.Window, ctx.GLContext);
+	}
+
+	SDL_LockMutex(present_lock);
+	while(!present_quit)
+	{
+		if(!present_pending)
+		{
+			SDL_CondWait(present_wake, present_lock);
+			continue;
+		}
+
+		frame = present_pending;
+		present_pending = NULL;
+		present_current = frame;
+		SDL_UnlockMutex(present_lock);
+
+		if(render_backend == RENDER_BACKEND_OPENGL && gl_glsl_enabled)
+		{
+			if(!present_gl_palette_valid || memcmp(present_gl_palette, frame->palette, sizeof(present_gl_palette)))
+			{
+				GL_UploadPalette(frame->palette);
+				memcpy(present_gl_palette, frame->palette, sizeof(present_gl_palette));
+				present_gl_palette_valid = true;
+			}
+		}
+
+		VID_PresentFrame(frame);
+
+		SDL_LockMutex(present_lock);
+		present_current = NULL;
+	}
+	SDL_UnlockMutex(present_lock);
+
+	// Let go of any GL context (ours, or the one SDL_Render uses internally)
+	// so the main thread can make it current again
+	if(SDL_GL_GetCurrentContext())
+	{
+		SDL_GL_MakeCurrent(ctx.Window, NULL);
+	}
+
+	return 0;
+}
+
+static void VID_StopPresentThread(void)
+{
+	int i;
+
+	if(present_thread)
+	{
+		SDL_LockMutex(present_lock);
+		present_quit = true;
+		SDL_CondSignal(present_wake);
+		SDL_UnlockMutex(present_lock);
+
+		SDL_WaitThread(present_thread, NULL);
+		present_thread = NULL;
+
+		// Take the renderer back
+		if(render_backend == RENDER_BACKEND_OPENGL)
+		{
+			SDL_GL_MakeCurrent(ctx.Window, ctx.GLContext);
+			GL_UpdatePalette();
+		}
+	}
+
+	SDL_DestroyCond(present_wake);
+	SDL_DestroyMutex(present_lock);
+	present_wake = 0;
+	present_lock = 0;
+
+	for(i = 0; i < PRESENT_FRAME_COUNT; i++)
+	{
+		SAFE_FREE(present_frames[i].pixels);
+	}
+}
+
+static void VID_StartPresentThread(void)
+{
+	int i;
+
+	present_lock = SDL_CreateMutex();
+	present_wake = SDL_CreateCond();
+	if(!present_lock || !present_wake)
+	{
+		Con_Printf("Could not start the present thread: %s\n", SDL_GetError());
+		VID_StopPresentThread();
+		Cvar_SetValueQuick(&sw_presentthread, 0);
+		return;
+	}
+
+	for(i = 0; i < PRESENT_FRAME_COUNT; i++)
+	{
+		present_frames[i].pixels = malloc(quake_width * quake_height);
+		if(!present_frames[i].pixels)
+		{
+			Sys_Error("Not enough memory for the present thread\n");
+		}
+	}
+
+	present_pending = 0;
+	present_current = 0;
+	present_quit = false;
+	present_gl_palette_valid = false;
+
+	// The present thread makes the context current on its side
+	if(SDL_GL_GetCurrentContext())
+	{
+		SDL_GL_MakeCurrent(ctx.Window, NULL);
+	}
+
+	present_thread = SDL_CreateThread(VID_PresentThread, "quake_present", NULL);
+	if(!present_thread)
+	{
+		Con_Printf("Could not start the present thread: %s\n", SDL_GetError());
+		if(render_backend == RENDER_BACKEND_OPENGL)
+		{
+			SDL_GL_MakeCurrent(ctx.Window, ctx.GLContext);
+		}
+		VID_StopPresentThread();
+		Cvar_SetValueQuick(&sw_presentthread, 0);
+	}
+}
+
+// Copies the current frame into a free buffer and hands it to the present thread
+static void VID_QueueFrame(void)
+{
+	present_frame_t *frame = 0;
+	int i;
+
+	SDL_LockMutex(present_lock);
+	for(i = 0; i < PRESENT_FRAME_COUNT; i++)
+	{
+		if(&present_frames[i] != present_pending && &present_frames[i] != present_current)
+		{
+			frame = &present_frames[i];
+			break;
+		}
+	}
+	SDL_UnlockMutex(present_lock);
+
+	// Neither pending nor current, so the present thread won't touch it
+	q_assert(frame);
+	memcpy(frame->pixels, vid_memory8, quake_width * quake_height);
+	memcpy(frame->palette_copy, vid_palette32_mod, sizeof(frame->palette_copy));
+	frame->palette = frame->palette_copy;
+	frame->client_width = vid_client_width;
+	frame->client_height = vid_client_height;
+
+	SDL_LockMutex(present_lock);
+	present_pending = frame;
+	SDL_CondSignal(present_wake);
+	SDL_UnlockMutex(present_lock);
+}
+
+void VID_Update(vrect_t *rects)
+{
+	D_FlushDirectRect();
+
+	if(sw_presentthread.value && !present_thread)
+	{
+		VID_StartPresentThread();
+	}
+	else if(!sw_presentthread.value && present_thread)
+	{
+		VID_StopPresentThread();
+	}
+
+	if(present_thread)
+	{
+		VID_QueueFrame();
+	}
+	else
+	{
+		present_frame_t frame;
+		frame.pixels = vid_memory8;
+		frame.palette = vid_palette32_mod;
+		frame.client_width = vid_client_width;
+		frame.client_height = vid_client_height;
+		VID_PresentFrame(&frame);
+	}
 
 	// Countdown timer for "Test" option in the video settings
 	if(vid_config_timer_enabled)
@@ -1357,6 +1658,7 @@ void VID_Update(vrect_t *rects)
 
 void VID_Shutdown(void)
 {
+	VID_StopPresentThread();
 	GL_ShutdownBackend();
 
 	SDL_DestroyRenderer(ctx.Renderer);
@@ -1494,6 +1796,8 @@ void VID_SetVsync(qboolean enable)
 {
 	if(enable) enable = 1;
 
+	VID_StopPresentThread();
+
 	switch(render_backend)
 	{
 		case RENDER_BACKEND_SDL:
@@ -238,6 +238,165 @@ areanode_t *SV_CreateAreaNode (int depth, vec3_t mins, vec3_t maxs)
 	return anode;
 }
 
+/*
+===============================================================================
+
+ENTITY AREA GRID
+
+softquake -- the area nodes only go four levels deep, so on big maps, or with
+lots of missiles flying around, every node ends up with a long list to walk.
+
+The area grid is a stack of grids laid over the world bounds, the finest one
+at most AREA_GRID_CELLS across and each level above it with cells twice as big.
+An entity goes into the finest level whose cells are at least as wide as it
+is, in the cell that holds its absmin corner. That keeps it to the one link,
+and means an entity can only stick out into the next cell over on the high
+side. So anything looking for entities in a box checks the cells it covers on
+every level, plus one more on the low side.
+
+The top level is a single cell, which also takes anything too big for the
+rest. Entities outside the world bounds go into the edge cells. Like the area
+nodes, only x and y are used.
+
+sv_areagrid picks between the two, at the next map load. What's found is the
+same either way, only the order differs.
+===============================================================================
+*/
+
+#define	AREA_GRID_CELLS		64		// across the finest level, at most
+#define	AREA_GRID_MINSIZE	64		// smallest cell size
+#define	AREA_GRID_LEVELS	16
+
+typedef struct
+{
+	link_t	trigger_edicts;
+	link_t	solid_edicts;
+} areacell_t;
+
+typedef struct
+{
+	float		cellsize;
+	float		scale;		// 1 / cellsize
+	int			size;		// cells across
+	int			numedicts;
+	areacell_t	*cells;
+} arealevel_t;
+
+cvar_t	sv_areagrid = {"sv_areagrid", "1", CV_ARCHIVE};
+
+static	arealevel_t	sv_arealevels[AREA_GRID_LEVELS];
+static	int			sv_numarealevels;
+static	vec3_t		sv_areaorigin;
+static	qboolean	sv_areagridactive;
+static	byte		sv_edictarealevel[MAX_EDICTS];
+
+/*
+===============
+SV_CreateAreaGrid
+
+softquake
+===============
+*/
+static void SV_CreateAreaGrid (vec3_t mins, vec3_t maxs)
+{
+	arealevel_t	*level;
+	float		extent, cellsize;
+	int			size;
+
+	VectorCopy (mins, sv_areaorigin);
+	extent = maxs[0] - mins[0];
+	if (maxs[1] - mins[1] > extent)
+		extent = maxs[1] - mins[1];
+
+	cellsize = extent / AREA_GRID_CELLS;
+	if (cellsize < AREA_GRID_MINSIZE)
+		cellsize = AREA_GRID_MINSIZE;
+
+	sv_numarealevels = 0;
+	do
+	{
+		size = (int)ceil (extent / cellsize);
+		if (size < 1 || sv_numarealevels == AREA_GRID_LEVELS - 1)
+			size = 1;
+
+		level = &sv_arealevels[sv_numarealevels++];
+		level->cellsize = cellsize;
+		level->scale = 1.0 / cellsize;
+		level->size = size;
+		level->cells = Hunk_AllocName (size*size*sizeof(areacell_t), "areagrid");
+
+		cellsize *= 2;
+	} while (size > 1);
+}
+
+/*
+===============
+SV_ClearAreaGrid
+
+softquake
+===============
+*/
+static void SV_ClearAreaGrid (void)
+{
+	arealevel_t	*level;
+	int			i, j;
+
+	for (i=0, level=sv_arealevels ; i<sv_numarealevels ; i++, level++)
+	{
+		level->numedicts = 0;
+		for (j=0 ; j<level->size*level->size ; j++)
+		{
+			ClearLink (&level->cells[j].trigger_edicts);
+			ClearLink (&level->cells[j].solid_edicts);
+		}
+	}
+}
+
+/*
+===============
+SV_AreaCell
+
+softquake -- column or row of a coordinate on one level, clamped to the grid
+===============
+*/
+static int SV_AreaCell (arealevel_t *level, float v, int axis)
+{
+	v = (v - sv_areaorigin[axis]) * level->scale;
+	if (v < 0)
+		return 0;
+	if (v >= level->size)
+		return level->size - 1;
+	return (int)v;
+}
+
+/*
+===============
+SV_AreaCellForEdict
+
+softquake
+===============
+*/
+static areacell_t *SV_AreaCellForEdict (edict_t *ent, int *levelnum)
+{
+	arealevel_t	*level;
+	float		extent;
+	int			i, x, y;
+
+	extent = ent->v.absmax[0] - ent->v.absmin[0];
+	if (ent->v.absmax[1] - ent->v.absmin[1] > extent)
+		extent = ent->v.absmax[1] - ent->v.absmin[1];
+
+	for (i=0 ; i<sv_numarealevels-1 ; i++)
+		if (sv_arealevels[i].cellsize >= extent)
+			break;
+	level = &sv_arealevels[i];
+	*levelnum = i;
+
+	x = SV_AreaCell (level, ent->v.absmin[0], 0);
+	y = SV_AreaCell (level, ent->v.absmin[1], 1);
+	return &level->cells[y*level->size + x];
+}
+
 /*
 ===============
 SV_ClearWorld
@@ -251,6 +410,12 @@ void SV_ClearWorld (void)
 	memset (sv_areanodes, 0, sizeof(sv_areanodes));
 	sv_numareanodes = 0;
 	SV_CreateAreaNode (0, sv.worldmodel->mins, sv.worldmodel->maxs);
+
+	// softquake
+	SV_ClearTraceCache ();
+	SV_CreateAreaGrid (sv.worldmodel->mins, sv.worldmodel->maxs);
+	SV_ClearAreaGrid ();
+	sv_areagridactive = sv_areagrid.value != 0;
 }
 
 
@@ -264,11 +429,59 @@ void SV_UnlinkEdict (edict_t *ent)
 {
 	if (!ent->area.prev)
 		return;		// not linked in anywhere
+	if (sv_areagridactive)
+		sv_arealevels[sv_edictarealevel[NUM_FOR_EDICT(ent)]].numedicts--;	// softquake
 	RemoveLink (&ent->area);
 	ent->area.prev = ent->area.next = NULL;
 }
 
 
+/*
+====================
+SV_TouchEdict
+
+softquake -- runs the touch function of one trigger, pulled out of SV_TouchLinks
+====================
+*/
+static void SV_TouchEdict (edict_t *ent, edict_t *touch)
+{
+	int			old_self, old_other;
+
+	old_self = pr_global_struct->self;
+	old_other = pr_global_struct->other;
+
+	pr_global_struct->self = EDICT_TO_PROG(touch);
+	pr_global_struct->other = EDICT_TO_PROG(ent);
+	pr_global_struct->time = sv.time;
+	PR_ExecuteProgram (touch->v.touch);
+
+	pr_global_struct->self = old_self;
+	pr_global_struct->other = old_other;
+}
+
+/*
+====================
+SV_TouchesTrigger
+
+softquake
+====================
+*/
+static qboolean SV_TouchesTrigger (edict_t *ent, edict_t *touch)
+{
+	if (touch == ent)
+		return false;
+	if (!touch->v.touch || touch->v.solid != SOLID_TRIGGER)
+		return false;
+	if (ent->v.absmin[0] > touch->v.absmax[0]
+	|| ent->v.absmin[1] > touch->v.absmax[1]
+	|| ent->v.absmin[2] > touch->v.absmax[2]
+	|| ent->v.absmax[0] < touch->v.absmin[0]
+	|| ent->v.absmax[1] < touch->v.absmin[1]
+	|| ent->v.absmax[2] < touch->v.absmin[2] )
+		return false;
+	return true;
+}
+
 /*
 ====================
 SV_TouchLinks
@@ -278,34 +491,15 @@ void SV_TouchLinks ( edict_t *ent, areanode_t *node )
 {
 	link_t		*l, *next;
 	edict_t		*touch;
-	int			old_self, old_other;
 
 // touch linked edicts
 	for (l = node->trigger_edicts.next ; l != &node->trigger_edicts ; l = next)
 	{
 		next = l->next;
 		touch = EDICT_FROM_AREA(l);
-		if (touch == ent)
-			continue;
-		if (!touch->v.touch || touch->v.solid != SOLID_TRIGGER)
+		if (!SV_TouchesTrigger (ent, touch))
 			continue;
-		if (ent->v.absmin[0] > touch->v.absmax[0]
-		|| ent->v.absmin[1] > touch->v.absmax[1]
-		|| ent->v.absmin[2] > touch->v.absmax[2]
-		|| ent->v.absmax[0] < touch->v.absmin[0]
-		|| ent->v.absmax[1] < touch->v.absmin[1]
-		|| ent->v.absmax[2] < touch->v.absmin[2] )
-			continue;
-		old_self = pr_global_struct->self;
-		old_other = pr_global_struct->other;
-
-		pr_global_struct->self = EDICT_TO_PROG(touch);
-		pr_global_struct->other = EDICT_TO_PROG(ent);
-		pr_global_struct->time = sv.time;
-		PR_ExecuteProgram (touch->v.touch);
-
-		pr_global_struct->self = old_self;
-		pr_global_struct->other = old_other;
+		SV_TouchEdict (ent, touch);
 	}
 	
 // recurse down both sides
@@ -319,6 +513,63 @@ void SV_TouchLinks ( edict_t *ent, areanode_t *node )
 }
 
 
+/*
+====================
+SV_TouchGrid
+
+softquake -- the triggers are gathered up before any of them are run, as a
+touch function can move things from one cell to another
+====================
+*/
+static void SV_TouchGrid (edict_t *ent)
+{
+	static edict_t	*touches[MAX_EDICTS];
+	arealevel_t	*level;
+	areacell_t	*cell;
+	link_t		*l;
+	edict_t		*touch;
+	int			i, x, y, x0, x1, y0, y1;
+	int			numtouches;
+
+	numtouches = 0;
+	for (i=0, level=sv_arealevels ; i<sv_numarealevels ; i++, level++)
+	{
+		if (!level->numedicts)
+			continue;
+		x0 = SV_AreaCell (level, ent->v.absmin[0] - level->cellsize, 0);
+		x1 = SV_AreaCell (level, ent->v.absmax[0], 0);
+		y0 = SV_AreaCell (level, ent->v.absmin[1] - level->cellsize, 1);
+		y1 = SV_AreaCell (level, ent->v.absmax[1], 1);
+
+		for (y=y0 ; y<=y1 ; y++)
+		{
+			cell = &level->cells[y*level->size + x0];
+			for (x=x0 ; x<=x1 ; x++, cell++)
+			{
+				for (l = cell->trigger_edicts.next ; l != &cell->trigger_edicts ; l = l->next)
+				{
+					touch = EDICT_FROM_AREA(l);
+					if (!SV_TouchesTrigger (ent, touch))
+						continue;
+					if (numtouches == MAX_EDICTS)
+						break;
+					touches[numtouches++] = touch;
+				}
+			}
+		}
+	}
+
+// an earlier touch may have removed or moved the later ones
+	for (i=0 ; i<numtouches ; i++)
+	{
+		touch = touches[i];
+		if (touch->free || !SV_TouchesTrigger (ent, touch))
+			continue;
+		SV_TouchEdict (ent, touch);
+	}
+}
+
+
 /*
 ===============
 SV_FindTouchedLeafs
@@ -372,6 +623,8 @@ SV_LinkEdict
 void SV_LinkEdict (edict_t *ent, qboolean touch_triggers)
 {
 	areanode_t	*node;
+	areacell_t	*cell;
+	int			levelnum;
 
 	if (ent->area.prev)
 		SV_UnlinkEdict (ent);	// unlink from old position
@@ -440,10 +693,27 @@ void SV_LinkEdict (edict_t *ent, qboolean touch_triggers)
 	ent->num_leafs = 0;
 	if (ent->v.modelindex)
 		SV_FindTouchedLeafs (ent, sv.worldmodel->nodes);
+	SV_LinkVisIndex (ent); // softquake
 
 	if (ent->v.solid == SOLID_NOT)
 		return;
 
+// softquake -- or the one cell of the area grid
+	if (sv_areagridactive)
+	{
+		cell = SV_AreaCellForEdict (ent, &levelnum);
+		sv_edictarealevel[NUM_FOR_EDICT(ent)] = levelnum;
+		sv_arealevels[levelnum].numedicts++;
+		if (ent->v.solid == SOLID_TRIGGER)
+			InsertLinkBefore (&ent->area, &cell->trigger_edicts);
+		else
+			InsertLinkBefore (&ent->area, &cell->solid_edicts);
+
+		if (touch_triggers)
+			SV_TouchGrid (ent);
+		return;
+	}
+
 // find the first node that the ent's box crosses
 	node = sv_areanodes;
 	while (1)
@@ -712,124 +982,431 @@ qboolean SV_RecursiveHullCheck (hull_t *hull, int num, float p1f, float p2f, vec
 
 
 /*
-==================
-SV_ClipMoveToEntity
+===============================================================================
 
-Handles selection or creation of a clipping hull, and offseting (and
-eventually rotation) of the end points
-==================
-*/
-trace_t SV_ClipMoveToEntity (edict_t *ent, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end)
-{
-	trace_t		trace;
-	vec3_t		offset;
-	vec3_t		start_l, end_l;
-	hull_t		*hull;
+softquake -- ITERATIVE HULL CHECK
 
-// fill in a default trace
-	memset (&trace, 0, sizeof(trace_t));
-	trace.fraction = 1;
-	trace.allsolid = true;
-	VectorCopy (end, trace.endpos);
+SV_RecursiveHullCheck without the recursion. Going down a node where both
+points are on the same side needs nothing saved, and the split nodes are
+pushed on a stack, to be finished (by going down the far side, or finding
+the impact point) once the near side comes back empty. The arithmetic is the
+same, so the results are too.
 
-// get the clipping hull
-	hull = SV_HullForEntity (ent, mins, maxs, offset);
+===============================================================================
+*/
 
-	VectorSubtract (start, offset, start_l);
-	VectorSubtract (end, offset, end_l);
+#define	MAX_HULL_STACK	128
+#define	MAX_HULL_BATCH	16
 
-#ifdef QUAKE2
-	// rotate start and end into the models frame of reference
-	if (ent->v.solid == SOLID_BSP && 
-	(ent->v.angles[0] || ent->v.angles[1] || ent->v.angles[2]) )
-	{
-		vec3_t	a;
-		vec3_t	forward, right, up;
-		vec3_t	temp;
+typedef struct
+{
+	dclipnode_t	*node;
+	mplane_t	*plane;
+	int			side;
+	float		frac;
+	float		p1f, p2f, midf;
+	vec3_t		p1, p2, mid;
+} hullsplit_t;
 
-		AngleVectors (ent->v.angles, forward, right, up);
+/*
+==================
+SV_HullSplit
 
-		VectorCopy (start_l, temp);
-		start_l[0] = DotProduct (temp, forward);
-		start_l[1] = -DotProduct (temp, right);
-		start_l[2] = DotProduct (temp, up);
+The near side of a split node came back empty. Returns true if the trace
+goes on into the far side, or false once the impact point has been found.
+==================
+*/
+static qboolean SV_HullSplit (hull_t *hull, hullsplit_t *split, trace_t *trace)
+{
+	mplane_t	*plane;
+	int			i;
 
-		VectorCopy (end_l, temp);
-		end_l[0] = DotProduct (temp, forward);
-		end_l[1] = -DotProduct (temp, right);
-		end_l[2] = DotProduct (temp, up);
-	}
-#endif
+	if (SV_HullPointContents (hull, split->node->children[split->side^1], split->mid)
+	!= CONTENTS_SOLID)
+		return true;
 
-// trace a line through the apropriate clipping hull
-	SV_RecursiveHullCheck (hull, hull->firstclipnode, 0, 1, start_l, end_l, &trace);
+	if (trace->allsolid)
+		return false;		// never got out of the solid area
 
-#ifdef QUAKE2
-	// rotate endpos back to world frame of reference
-	if (ent->v.solid == SOLID_BSP && 
-	(ent->v.angles[0] || ent->v.angles[1] || ent->v.angles[2]) )
+// the other side of the node is solid, this is the impact point
+	plane = split->plane;
+	if (!split->side)
 	{
-		vec3_t	a;
-		vec3_t	forward, right, up;
-		vec3_t	temp;
+		VectorCopy (plane->normal, trace->plane.normal);
+		trace->plane.dist = plane->dist;
+	}
+	else
+	{
+		VectorSubtract (vec3_origin, plane->normal, trace->plane.normal);
+		trace->plane.dist = -plane->dist;
+	}
 
-		if (trace.fraction != 1)
+	while (SV_HullPointContents (hull, hull->firstclipnode, split->mid)
+	== CONTENTS_SOLID)
+	{ // shouldn't really happen, but does occasionally
+		split->frac -= 0.1;
+		if (split->frac < 0)
 		{
-			VectorSubtract (vec3_origin, ent->v.angles, a);
-			AngleVectors (a, forward, right, up);
-
-			VectorCopy (trace.endpos, temp);
-			trace.endpos[0] = DotProduct (temp, forward);
-			trace.endpos[1] = -DotProduct (temp, right);
-			trace.endpos[2] = DotProduct (temp, up);
-
-			VectorCopy (trace.plane.normal, temp);
-			trace.plane.normal[0] = DotProduct (temp, forward);
-			trace.plane.normal[1] = -DotProduct (temp, right);
-			trace.plane.normal[2] = DotProduct (temp, up);
+			trace->fraction = split->midf;
+			VectorCopy (split->mid, trace->endpos);
+			Con_DPrintf ("backup past 0\n");
+			return false;
 		}
+		split->midf = split->p1f + (split->p2f - split->p1f)*split->frac;
+		for (i=0 ; i<3 ; i++)
+			split->mid[i] = split->p1[i] + split->frac*(split->p2[i] - split->p1[i]);
 	}
-#endif
-
-// fix trace up by the offset
-	if (trace.fraction != 1)
-		VectorAdd (trace.endpos, offset, trace.endpos);
 
-// did we clip the move?
-	if (trace.fraction < 1 || trace.startsolid  )
-		trace.ent = ent;
+	trace->fraction = split->midf;
+	VectorCopy (split->mid, trace->endpos);
 
-	return trace;
+	return false;
 }
 
-//===========================================================================
-
 /*
-====================
-SV_ClipToLinks
+==================
+SV_HullCheck
 
-Mins and maxs enclose the entire area swept by the move
-====================
+Same as SV_RecursiveHullCheck
+==================
 */
-void SV_ClipToLinks ( areanode_t *node, moveclip_t *clip )
+qboolean SV_HullCheck (hull_t *hull, int num, float p1f, float p2f, vec3_t p1in, vec3_t p2in, trace_t *trace)
 {
-	link_t		*l, *next;
-	edict_t		*touch;
-	trace_t		trace;
+	hullsplit_t	stack[MAX_HULL_STACK];
+	hullsplit_t	deep, *split;
+	int			sp;
+	dclipnode_t	*node;
+	mplane_t	*plane;
+	float		t1, t2;
+	float		frac;
+	vec3_t		p1, p2;
+	int			i;
 
-// touch linked edicts
-	for (l = node->solid_edicts.next ; l != &node->solid_edicts ; l = next)
-	{
-		next = l->next;
-		touch = EDICT_FROM_AREA(l);
-		if (touch->v.solid == SOLID_NOT)
-			continue;
-		if (touch == clip->passedict)
-			continue;
-		if (touch->v.solid == SOLID_TRIGGER)
-			Sys_Error ("Trigger in clipping list");
+	VectorCopy (p1in, p1);
+	VectorCopy (p2in, p2);
+	sp = 0;
 
-		if (clip->type == MOVE_NOMONSTERS && touch->v.solid != SOLID_BSP)
+	while (1)
+	{
+	// go down to a leaf
+		while (num >= 0)
+		{
+			if (num < hull->firstclipnode || num > hull->lastclipnode)
+				Sys_Error ("SV_HullCheck: bad node number");
+
+			node = hull->clipnodes + num;
+			plane = hull->planes + node->planenum;
+
+			if (plane->type < 3)
+			{
+				t1 = p1[plane->type] - plane->dist;
+				t2 = p2[plane->type] - plane->dist;
+			}
+			else
+			{
+				t1 = DotProduct (plane->normal, p1) - plane->dist;
+				t2 = DotProduct (plane->normal, p2) - plane->dist;
+			}
+
+			if (t1 >= 0 && t2 >= 0)
+			{
+				num = node->children[0];
+				continue;
+			}
+			if (t1 < 0 && t2 < 0)
+			{
+				num = node->children[1];
+				continue;
+			}
+
+		// put the crosspoint DIST_EPSILON pixels on the near side
+			if (t1 < 0)
+				frac = (t1 + DIST_EPSILON)/(t1-t2);
+			else
+				frac = (t1 - DIST_EPSILON)/(t1-t2);
+			if (frac < 0)
+				frac = 0;
+			if (frac > 1)
+				frac = 1;
+
+			split = sp < MAX_HULL_STACK ? &stack[sp] : &deep;
+			split->node = node;
+			split->plane = plane;
+			split->side = (t1 < 0);
+			split->frac = frac;
+			split->p1f = p1f;
+			split->p2f = p2f;
+			split->midf = p1f + (p2f - p1f)*frac;
+			for (i=0 ; i<3 ; i++)
+				split->mid[i] = p1[i] + frac*(p2[i] - p1[i]);
+			VectorCopy (p1, split->p1);
+			VectorCopy (p2, split->p2);
+
+			if (split == &deep)
+			{	// out of stack, so let the recursive version do the near side
+				if (!SV_RecursiveHullCheck (hull, node->children[split->side], p1f, split->midf, p1, split->mid, trace))
+					return false;
+				goto farside;
+			}
+
+		// move up to the node
+			sp++;
+			num = node->children[split->side];
+			p2f = split->midf;
+			VectorCopy (split->mid, p2);
+		}
+
+	// check for empty
+		if (num != CONTENTS_SOLID)
+		{
+			trace->allsolid = false;
+			if (num == CONTENTS_EMPTY)
+				trace->inopen = true;
+			else
+				trace->inwater = true;
+		}
+		else
+			trace->startsolid = true;
+
+		if (!sp)
+			return true;		// empty
+		split = &stack[--sp];
+
+farside:
+		if (!SV_HullSplit (hull, split, trace))
+			return false;
+
+	// go past the node
+		num = split->node->children[split->side^1];
+		p1f = split->midf;
+		p2f = split->p2f;
+		VectorCopy (split->mid, p1);
+		VectorCopy (split->p2, p2);
+	}
+}
+
+/*
+==================
+SV_HullCheckBatch
+
+Traces each of count lines through the whole hull. The traces must be filled
+in with defaults first, like for SV_RecursiveHullCheck.
+
+Lines that are on the same side of a node go down to its child together, so
+the nodes they share are only looked at once. Where they end up on different
+sides the batch is split, and the back part is finished later. A line that
+crosses a plane is finished on its own with SV_HullCheck from that node, which
+is where the whole-hull trace would have got to with the same end points.
+==================
+*/
+void SV_HullCheckBatch (hull_t *hull, int count, vec3_t *starts, vec3_t *ends, trace_t *traces)
+{
+	int			lines[MAX_HULL_BATCH], back[MAX_HULL_BATCH];
+	int			stacknum[MAX_HULL_BATCH], stackfirst[MAX_HULL_BATCH], stackcount[MAX_HULL_BATCH];
+	int			sp, num, first, n, numfront, numback, i, j;
+	dclipnode_t	*node;
+	mplane_t	*plane;
+	float		t1, t2;
+
+	if (count > MAX_HULL_BATCH)
+		Sys_Error ("SV_HullCheckBatch: %i lines", count);
+
+	for (i=0 ; i<count ; i++)
+		lines[i] = i;
+	num = hull->firstclipnode;
+	first = 0;
+	n = count;
+	sp = 0;
+
+	while (1)
+	{
+	// go down together as far as they agree
+		while (num >= 0 && n)
+		{
+			if (num < hull->firstclipnode || num > hull->lastclipnode)
+				Sys_Error ("SV_HullCheckBatch: bad node number");
+
+			node = hull->clipnodes + num;
+			plane = hull->planes + node->planenum;
+
+			numfront = numback = 0;
+			for (i=first ; i<first+n ; i++)
+			{
+				j = lines[i];
+				if (plane->type < 3)
+				{
+					t1 = starts[j][plane->type] - plane->dist;
+					t2 = ends[j][plane->type] - plane->dist;
+				}
+				else
+				{
+					t1 = DotProduct (plane->normal, starts[j]) - plane->dist;
+					t2 = DotProduct (plane->normal, ends[j]) - plane->dist;
+				}
+
+				if (t1 >= 0 && t2 >= 0)
+					lines[first + numfront++] = j;
+				else if (t1 < 0 && t2 < 0)
+					back[numback++] = j;
+				else
+					SV_HullCheck (hull, num, 0, 1, starts[j], ends[j], &traces[j]);
+			}
+
+			if (numback)
+			{
+				memcpy (&lines[first+numfront], back, numback*sizeof(int));
+				if (!numfront)
+				{
+					num = node->children[1];
+					n = numback;
+					continue;
+				}
+			// come back for them
+				stacknum[sp] = node->children[1];
+				stackfirst[sp] = first + numfront;
+				stackcount[sp] = numback;
+				sp++;
+			}
+			num = node->children[0];
+			n = numfront;
+		}
+
+	// at a leaf, SV_HullCheck fills in the contents
+		for (i=first ; i<first+n ; i++)
+		{
+			j = lines[i];
+			SV_HullCheck (hull, num, 0, 1, starts[j], ends[j], &traces[j]);
+		}
+
+		if (!sp)
+			return;
+		sp--;
+		num = stacknum[sp];
+		first = stackfirst[sp];
+		n = stackcount[sp];
+	}
+}
+
+
+/*
+==================
+SV_ClipMoveToEntity
+
+Handles selection or creation of a clipping hull, and offseting (and
+eventually rotation) of the end points
+==================
+*/
+trace_t SV_ClipMoveToEntity (edict_t *ent, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end)
+{
+	trace_t		trace;
+	vec3_t		offset;
+	vec3_t		start_l, end_l;
+	hull_t		*hull;
+
+// fill in a default trace
+	memset (&trace, 0, sizeof(trace_t));
+	trace.fraction = 1;
+	trace.allsolid = true;
+	VectorCopy (end, trace.endpos);
+
+// get the clipping hull
+	hull = SV_HullForEntity (ent, mins, maxs, offset);
+
+	VectorSubtract (start, offset, start_l);
+	VectorSubtract (end, offset, end_l);
+
+#ifdef QUAKE2
+	// rotate start and end into the models frame of reference
+	if (ent->v.solid == SOLID_BSP && 
+	(ent->v.angles[0] || ent->v.angles[1] || ent->v.angles[2]) )
+	{
+		vec3_t	a;
+		vec3_t	forward, right, up;
+		vec3_t	temp;
+
+		AngleVectors (ent->v.angles, forward, right, up);
+
+		VectorCopy (start_l, temp);
+		start_l[0] = DotProduct (temp, forward);
+		start_l[1] = -DotProduct (temp, right);
+		start_l[2] = DotProduct (temp, up);
+
+		VectorCopy (end_l, temp);
+		end_l[0] = DotProduct (temp, forward);
+		end_l[1] = -DotProduct (temp, right);
+		end_l[2] = DotProduct (temp, up);
+	}
+#endif
+
+// trace a line through the apropriate clipping hull
+	SV_HullCheck (hull, hull->firstclipnode, 0, 1, start_l, end_l, &trace);	// softquake
+
+#ifdef QUAKE2
+	// rotate endpos back to world frame of reference
+	if (ent->v.solid == SOLID_BSP && 
+	(ent->v.angles[0] || ent->v.angles[1] || ent->v.angles[2]) )
+	{
+		vec3_t	a;
+		vec3_t	forward, right, up;
+		vec3_t	temp;
+
+		if (trace.fraction != 1)
+		{
+			VectorSubtract (vec3_origin, ent->v.angles, a);
+			AngleVectors (a, forward, right, up);
+
+			VectorCopy (trace.endpos, temp);
+			trace.endpos[0] = DotProduct (temp, forward);
+			trace.endpos[1] = -DotProduct (temp, right);
+			trace.endpos[2] = DotProduct (temp, up);
+
+			VectorCopy (trace.plane.normal, temp);
+			trace.plane.normal[0] = DotProduct (temp, forward);
+			trace.plane.normal[1] = -DotProduct (temp, right);
+			trace.plane.normal[2] = DotProduct (temp, up);
+		}
+	}
+#endif
+
+// fix trace up by the offset
+	if (trace.fraction != 1)
+		VectorAdd (trace.endpos, offset, trace.endpos);
+
+// did we clip the move?
+	if (trace.fraction < 1 || trace.startsolid  )
+		trace.ent = ent;
+
+	return trace;
+}
+
+//===========================================================================
+
+/*
+====================
+SV_ClipToList
+
+softquake -- the entity loop of SV_ClipToLinks, so the area grid can use it
+====================
+*/
+static void SV_ClipToList ( link_t *list, moveclip_t *clip )
+{
+	link_t		*l, *next;
+	edict_t		*touch;
+	trace_t		trace;
+
+// touch linked edicts
+	for (l = list->next ; l != list ; l = next)
+	{
+		next = l->next;
+		touch = EDICT_FROM_AREA(l);
+		if (touch->v.solid == SOLID_NOT)
+			continue;
+		if (touch == clip->passedict)
+			continue;
+		if (touch->v.solid == SOLID_TRIGGER)
+			Sys_Error ("Trigger in clipping list");
+
+		if (clip->type == MOVE_NOMONSTERS && touch->v.solid != SOLID_BSP)
 			continue;
 
 		if (clip->boxmins[0] > touch->v.absmax[0]
@@ -873,6 +1450,20 @@ void SV_ClipToLinks ( areanode_t *node, moveclip_t *clip )
 		else if (trace.startsolid)
 			clip->trace.startsolid = true;
 	}
+}
+
+/*
+====================
+SV_ClipToLinks
+
+Mins and maxs enclose the entire area swept by the move
+====================
+*/
+void SV_ClipToLinks ( areanode_t *node, moveclip_t *clip )
+{
+	SV_ClipToList (&node->solid_edicts, clip);
+	if (clip->trace.allsolid)
+		return;
 	
 // recurse down both sides
 	if (node->axis == -1)
@@ -885,6 +1476,44 @@ void SV_ClipToLinks ( areanode_t *node, moveclip_t *clip )
 }
 
 
+/*
+====================
+SV_ClipToGrid
+
+softquake
+====================
+*/
+static void SV_ClipToGrid ( moveclip_t *clip )
+{
+	arealevel_t	*level;
+	areacell_t	*cell;
+	int			i, x, y, x0, x1, y0, y1;
+
+	for (i=0, level=sv_arealevels ; i<sv_numarealevels ; i++, level++)
+	{
+		if (!level->numedicts)
+			continue;
+		x0 = SV_AreaCell (level, clip->boxmins[0] - level->cellsize, 0);
+		x1 = SV_AreaCell (level, clip->boxmaxs[0], 0);
+		y0 = SV_AreaCell (level, clip->boxmins[1] - level->cellsize, 1);
+		y1 = SV_AreaCell (level, clip->boxmaxs[1], 1);
+
+		for (y=y0 ; y<=y1 ; y++)
+		{
+			cell = &level->cells[y*level->size + x0];
+			for (x=x0 ; x<=x1 ; x++, cell++)
+			{
+				if (cell->solid_edicts.next == &cell->solid_edicts)
+					continue;
+				SV_ClipToList (&cell->solid_edicts, clip);
+				if (clip->trace.allsolid)
+					return;
+			}
+		}
+	}
+}
+
+
 /*
 ==================
 SV_MoveBounds
@@ -915,48 +1544,552 @@ boxmaxs[0] = boxmaxs[1] = boxmaxs[2] = 9999;
 #endif
 }
 
+/*
+===============================================================================
+
+softquake -- WORLD TRACE CACHE
+
+The world never moves, so clipping a move against it always comes out the
+same for the same hull, end points and offset. The last results are kept in
+a table and used again while the map is loaded. Only exact matches count.
+
+With sv_tracestats on, traces and cache hits are counted by the classname of
+the entity doing the tracing, for 'tracestats' to print.
+
+===============================================================================
+*/
+
+#define	TRACE_CACHE		1024		// must be a power of two
+#define	MAX_MOVEBATCH	16
+#define	MAX_TRACECLASSES	64
+
+typedef struct
+{
+	int		hullnum;
+	vec3_t	start, end, offset;
+} tracekey_t;
+
+typedef struct
+{
+	tracekey_t	key;
+	qboolean	valid;
+	trace_t		trace;
+} cachedtrace_t;
+
+typedef struct
+{
+	char		classname[32];	// every spawned entity has its own copy of the string
+	int			traces;
+	int			hits;
+} traceclass_t;
+
+cvar_t	sv_tracecache = {"sv_tracecache", "1", CV_ARCHIVE};
+cvar_t	sv_tracestats = {"sv_tracestats", "0"};
+
+static	cachedtrace_t	sv_cachedtraces[TRACE_CACHE];
+
+static	traceclass_t	sv_traceclasses[MAX_TRACECLASSES];
+static	int				sv_numtraceclasses;
+static	double			sv_tracestatstime;
+
+/*
+==================
+SV_ClearTraceCache
+==================
+*/
+void SV_ClearTraceCache (void)
+{
+	int		i;
+
+	for (i=0 ; i<TRACE_CACHE ; i++)
+		sv_cachedtraces[i].valid = false;
+}
+
 /*
 ==================
-SV_Move
+SV_HashTraceKey
 ==================
 */
-trace_t SV_Move (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, edict_t *passedict)
+static unsigned SV_HashTraceKey (tracekey_t *key)
 {
-	moveclip_t	clip;
+	unsigned	*p, hash;
 	int			i;
 
-	memset ( &clip, 0, sizeof ( moveclip_t ) );
+	p = (unsigned *)key;
+	hash = 2166136261u;
+	for (i=0 ; i<sizeof(tracekey_t)/sizeof(unsigned) ; i++)
+		hash = (hash ^ p[i]) * 16777619u;
+	return (hash ^ (hash >> 15)) & (TRACE_CACHE-1);
+}
 
-// clip to world
-	clip.trace = SV_ClipMoveToEntity ( sv.edicts, start, mins, maxs, end );
+/*
+==================
+SV_CountTraces
+==================
+*/
+static void SV_CountTraces (edict_t *passedict, int traces, int hits)
+{
+	traceclass_t	*tc;
+	char			*classname;
+	int				i;
+
+	if (passedict && passedict->v.classname)
+		classname = pr_strings + passedict->v.classname;
+	else
+		classname = "(none)";
+
+	for (i=0, tc=sv_traceclasses ; i<sv_numtraceclasses ; i++, tc++)
+		if (!strncmp (tc->classname, classname, sizeof(tc->classname)-1))
+			break;
+	if (i == sv_numtraceclasses)
+	{
+		if (sv_numtraceclasses == MAX_TRACECLASSES)
+		{	// lumped in with the last one
+			tc = &sv_traceclasses[MAX_TRACECLASSES-1];
+			strcpy (tc->classname, "other");
+		}
+		else
+		{
+			sv_numtraceclasses++;
+			q_snprintf (tc->classname, sizeof(tc->classname), "%s", classname);
+			tc->traces = tc->hits = 0;
+		}
+	}
+
+	tc->traces += traces;
+	tc->hits += hits;
+}
+
+/*
+==================
+SV_ClipMovesToWorld
+
+SV_ClipMoveToEntity against the world for a batch of moves of the same size,
+going to the cache first
+==================
+*/
+static void SV_ClipMovesToWorld (int count, vec3_t *starts, vec3_t mins, vec3_t maxs, vec3_t *ends, edict_t *passedict, trace_t *traces)
+{
+	hull_t			*hull;
+	vec3_t			offset;
+	tracekey_t		key;
+	cachedtrace_t	*slots[MAX_MOVEBATCH];
+	tracekey_t		keys[MAX_MOVEBATCH];
+	vec3_t			starts_l[MAX_MOVEBATCH], ends_l[MAX_MOVEBATCH];
+	trace_t			misses[MAX_MOVEBATCH];
+	int				missnums[MAX_MOVEBATCH];
+	int				i, nummisses;
+	trace_t			*trace;
+
+	hull = SV_HullForEntity (sv.edicts, mins, maxs, offset);
+
+	nummisses = 0;
+	for (i=0 ; i<count ; i++)
+	{
+		slots[i] = NULL;
+		if (sv_tracecache.value)
+		{
+			memset (&key, 0, sizeof(key));
+			key.hullnum = hull - sv.worldmodel->hulls;
+			VectorCopy (starts[i], key.start);
+			VectorCopy (ends[i], key.end);
+			VectorCopy (offset, key.offset);
+
+			slots[i] = &sv_cachedtraces[SV_HashTraceKey (&key)];
+			if (slots[i]->valid && !memcmp (&slots[i]->key, &key, sizeof(key)))
+			{
+				traces[i] = slots[i]->trace;
+				continue;
+			}
+			keys[i] = key;
+		}
 
-	clip.start = start;
-	clip.end = end;
-	clip.mins = mins;
-	clip.maxs = maxs;
-	clip.type = type;
-	clip.passedict = passedict;
+	// fill in a default trace
+		trace = &misses[nummisses];
+		memset (trace, 0, sizeof(trace_t));
+		trace->fraction = 1;
+		trace->allsolid = true;
+		VectorCopy (ends[i], trace->endpos);
+
+		VectorSubtract (starts[i], offset, starts_l[nummisses]);
+		VectorSubtract (ends[i], offset, ends_l[nummisses]);
+		missnums[nummisses++] = i;
+	}
+
+	if (sv_tracestats.value)
+		SV_CountTraces (passedict, count, count - nummisses);
+
+	if (!nummisses)
+		return;
+
+// trace the lines through the world hull
+	SV_HullCheckBatch (hull, nummisses, starts_l, ends_l, misses);
+
+	for (i=0 ; i<nummisses ; i++)
+	{
+		trace = &misses[i];
+
+	// fix trace up by the offset
+		if (trace->fraction != 1)
+			VectorAdd (trace->endpos, offset, trace->endpos);
+
+	// did we clip the move?
+		if (trace->fraction < 1 || trace->startsolid  )
+			trace->ent = sv.edicts;
+
+		traces[missnums[i]] = *trace;
+		if (slots[missnums[i]])
+		{
+			slots[missnums[i]]->key = keys[missnums[i]];
+			slots[missnums[i]]->trace = *trace;
+			slots[missnums[i]]->valid = true;
+		}
+	}
+}
+
+/*
+==================
+SV_TraceStats_f
+
+softquake -- tracestats
+
+Prints what sv_tracestats has counted since the last time, and starts over
+==================
+*/
+void SV_TraceStats_f (void)
+{
+	traceclass_t	*tc, temp;
+	int				i, j, traces, hits;
+	double			time;
+
+	if (!sv_tracestats.value)
+	{
+		Con_Printf ("Set sv_tracestats 1 to count traces\n");
+		sv_numtraceclasses = 0;
+		sv_tracestatstime = realtime;
+		return;
+	}
+
+// sort by number of traces
+	for (i=0 ; i<sv_numtraceclasses ; i++)
+		for (j=i+1 ; j<sv_numtraceclasses ; j++)
+			if (sv_traceclasses[j].traces > sv_traceclasses[i].traces)
+			{
+				temp = sv_traceclasses[i];
+				sv_traceclasses[i] = sv_traceclasses[j];
+				sv_traceclasses[j] = temp;
+			}
+
+	time = realtime - sv_tracestatstime;
+	if (time <= 0)
+		time = 1;
+
+	traces = hits = 0;
+	Con_Printf ("  traces  per sec  cached  class\n");
+	for (i=0, tc=sv_traceclasses ; i<sv_numtraceclasses ; i++, tc++)
+	{
+		Con_Printf ("%8i %8.0f %6.1f%%  %s\n", tc->traces, tc->traces / time,
+			tc->traces ? 100.0 * tc->hits / tc->traces : 0, tc->classname);
+		traces += tc->traces;
+		hits += tc->hits;
+	}
+	Con_Printf ("%8i %8.0f %6.1f%%  total over %.1f seconds\n", traces, traces / time,
+		traces ? 100.0 * hits / traces : 0, time);
+
+	sv_numtraceclasses = 0;
+	sv_tracestatstime = realtime;
+}
+
+/*
+==================
+SV_ClipMoveToEdicts
+
+softquake -- the part of SV_Move after the world
+==================
+*/
+static void SV_ClipMoveToEdicts (moveclip_t *clip, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, edict_t *passedict)
+{
+	int			i;
+
+	clip->start = start;
+	clip->end = end;
+	clip->mins = mins;
+	clip->maxs = maxs;
+	clip->type = type;
+	clip->passedict = passedict;
 
 	if (type == MOVE_MISSILE)
 	{
 		for (i=0 ; i<3 ; i++)
 		{
-			clip.mins2[i] = -15;
-			clip.maxs2[i] = 15;
+			clip->mins2[i] = -15;
+			clip->maxs2[i] = 15;
 		}
 	}
 	else
 	{
-		VectorCopy (mins, clip.mins2);
-		VectorCopy (maxs, clip.maxs2);
+		VectorCopy (mins, clip->mins2);
+		VectorCopy (maxs, clip->maxs2);
 	}
 	
 // create the bounding box of the entire move
-	SV_MoveBounds ( start, clip.mins2, clip.maxs2, end, clip.boxmins, clip.boxmaxs );
+	SV_MoveBounds ( start, clip->mins2, clip->maxs2, end, clip->boxmins, clip->boxmaxs );
 
 // clip to entities
-	SV_ClipToLinks ( sv_areanodes, &clip );
+	if (sv_areagridactive)
+		SV_ClipToGrid ( clip );
+	else
+		SV_ClipToLinks ( sv_areanodes, clip );
+}
+
+/*
+==================
+SV_Move
+==================
+*/
+trace_t SV_Move (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, edict_t *passedict)
+{
+	moveclip_t	clip;
+	vec3_t		starts[1], ends[1];
+
+	memset ( &clip, 0, sizeof ( moveclip_t ) );
+
+// clip to world
+	VectorCopy (start, starts[0]);	// softquake -- through the cache
+	VectorCopy (end, ends[0]);
+	SV_ClipMovesToWorld (1, starts, mins, maxs, ends, passedict, &clip.trace);
+
+	SV_ClipMoveToEdicts (&clip, start, mins, maxs, end, type, passedict);
 
 	return clip.trace;
 }
 
+/*
+==================
+SV_MoveBatch
+
+softquake -- SV_Move for several moves of the same size at once
+==================
+*/
+void SV_MoveBatch (int count, vec3_t *starts, vec3_t mins, vec3_t maxs, vec3_t *ends, int type, edict_t *passedict, trace_t *traces)
+{
+	moveclip_t	clip;
+	int			i;
+
+	if (count > MAX_MOVEBATCH)
+		Sys_Error ("SV_MoveBatch: %i moves", count);
+
+// clip to world
+	SV_ClipMovesToWorld (count, starts, mins, maxs, ends, passedict, traces);
+
+// clip to entities
+	for (i=0 ; i<count ; i++)
+	{
+		memset ( &clip, 0, sizeof ( moveclip_t ) );
+		clip.trace = traces[i];
+		SV_ClipMoveToEdicts (&clip, starts[i], mins, maxs, ends[i], type, passedict);
+		traces[i] = clip.trace;
+	}
+}
+
+/*
+===============================================================================
+
+TRACE BENCHMARK
+
+===============================================================================
+*/
+
+#define	BENCH_POINTS	1024
+
+static	unsigned	bench_seed;
+static	vec3_t		bench_points[BENCH_POINTS];
+static	int			bench_numpoints;
+static	vec3_t		bench_mins = {-16, -16, -24};
+static	vec3_t		bench_maxs = {16, 16, 32};
+
+/*
+==================
+SV_BenchRandom
+
+softquake -- not rand(), so the game's own random numbers aren't disturbed
+==================
+*/
+static float SV_BenchRandom (void)
+{
+	bench_seed = bench_seed * 1103515245 + 12345;
+	return ((bench_seed >> 8) & 0xffff) / 65536.0;
+}
+
+/*
+==================
+SV_BenchFindPoints
+
+softquake -- somewhere to put the boxes and start the traces, out of the walls
+==================
+*/
+static void SV_BenchFindPoints (void)
+{
+	vec3_t	p;
+	int		i, j;
+
+	bench_numpoints = 0;
+	for (i=0 ; i<BENCH_POINTS*64 && bench_numpoints<BENCH_POINTS ; i++)
+	{
+		for (j=0 ; j<3 ; j++)
+			p[j] = sv.worldmodel->mins[j] + SV_BenchRandom() * (sv.worldmodel->maxs[j] - sv.worldmodel->mins[j]);
+		if (SV_PointContents (p) == CONTENTS_SOLID)
+			continue;
+		VectorCopy (p, bench_points[bench_numpoints]);
+		bench_numpoints++;
+	}
+}
+
+/*
+==================
+SV_BenchRelink
+
+softquake -- moves everything that was linked over to the area nodes or grid
+==================
+*/
+static void SV_BenchRelink (qboolean grid)
+{
+	static byte	linked[MAX_EDICTS];
+	edict_t		*ent;
+	int			i;
+
+	for (i=1 ; i<sv.num_edicts ; i++)
+	{
+		ent = EDICT_NUM(i);
+		linked[i] = ent->area.prev != NULL;
+		SV_UnlinkEdict (ent);
+	}
+
+	memset (sv_areanodes, 0, sizeof(sv_areanodes));
+	sv_numareanodes = 0;
+	SV_CreateAreaNode (0, sv.worldmodel->mins, sv.worldmodel->maxs);
+	SV_ClearAreaGrid ();
+	sv_areagridactive = grid;
+
+	for (i=1 ; i<sv.num_edicts ; i++)
+	{
+		if (linked[i])
+			SV_LinkEdict (EDICT_NUM(i), false);
+	}
+}
+
+/*
+==================
+SV_BenchTraces
+
+softquake -- short moves from random spots, half of them with a player sized box
+==================
+*/
+static void SV_BenchTraces (int count, qboolean grid, double *rate, float *checksum)
+{
+	vec3_t		start, end;
+	trace_t		trace;
+	double		time;
+	int			i, j;
+
+	SV_BenchRelink (grid);
+
+	bench_seed = 1;
+	*checksum = 0;
+	time = Sys_PreciseTime ();
+	for (i=0 ; i<count ; i++)
+	{
+		VectorCopy (bench_points[i % bench_numpoints], start);
+		for (j=0 ; j<3 ; j++)
+			end[j] = start[j] + (SV_BenchRandom() - 0.5) * 512;
+
+		if (i & 1)
+			trace = SV_Move (start, bench_mins, bench_maxs, end, MOVE_NORMAL, NULL);
+		else
+			trace = SV_Move (start, vec3_origin, vec3_origin, end, MOVE_NORMAL, NULL);
+		if (!trace.startsolid)	// otherwise the link order decides
+			*checksum += trace.fraction;
+	}
+	time = Sys_PreciseTime () - time;
+	if (time < 0.000001)
+		time = 0.000001;
+
+	*rate = count / time;
+}
+
+/*
+==================
+SV_TraceBench_f
+
+softquake -- tracebench [traces]
+
+SV_Move traces per second with the area nodes and the area grid, with more and
+more boxes dropped into the current map. They're removed again afterwards.
+==================
+*/
+void SV_TraceBench_f (void)
+{
+	static int	counts[] = {0, 50, 100, 200, 400};
+	static edict_t	*added[MAX_EDICTS];
+	qboolean	wasgrid;
+	edict_t		*ent;
+	double		noderate, gridrate;
+	float		nodesum, gridsum;
+	int			i, j, traces, numadded, room;
+
+	if (!sv.active)
+	{
+		Con_Printf ("Not running a server\n");
+		return;
+	}
+
+	traces = 20000;
+	if (Cmd_Argc() > 1)
+		traces = Q_atoi (Cmd_Argv(1));
+	if (traces < 1)
+		traces = 1;
+
+	bench_seed = 1;
+	SV_BenchFindPoints ();
+	if (!bench_numpoints)
+	{
+		Con_Printf ("Couldn't find any open space\n");
+		return;
+	}
+
+	wasgrid = sv_areagridactive;
+	room = sv.max_edicts - sv.num_edicts - 64;
+	numadded = 0;
+
+	Con_Printf ("%i traces on %s\n", traces, sv.name);
+	Con_Printf ("boxes  nodes/sec   grid/sec\n");
+	for (i=0 ; i<sizeof(counts)/sizeof(counts[0]) ; i++)
+	{
+		if (counts[i] > room)
+			break;
+
+		while (numadded < counts[i])
+		{
+			ent = ED_Alloc ();
+			ent->v.solid = SOLID_BBOX;
+			ent->v.movetype = MOVETYPE_NONE;
+			VectorCopy (bench_mins, ent->v.mins);
+			VectorCopy (bench_maxs, ent->v.maxs);
+			VectorSubtract (ent->v.maxs, ent->v.mins, ent->v.size);
+			j = (int)(SV_BenchRandom() * bench_numpoints);
+			VectorCopy (bench_points[j], ent->v.origin);
+			SV_LinkEdict (ent, false);
+			added[numadded++] = ent;
+		}
+
+		SV_BenchTraces (traces, false, &noderate, &nodesum);
+		SV_BenchTraces (traces, true, &gridrate, &gridsum);
+
+		Con_Printf ("%5i %10.0f %10.0f%s\n", numadded, noderate, gridrate,
+			nodesum != gridsum ? "  (results differ!)" : "");
+	}
+
+	for (i=0 ; i<numadded ; i++)
+		ED_Free (added[i]);
+	SV_BenchRelink (wasgrid);
+}
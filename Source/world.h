@@ -45,6 +45,11 @@ typedef struct
 void SV_ClearWorld (void);
 // called after the world model has been loaded, before linking any entities
 
+extern	cvar_t	sv_areagrid;
+
+void SV_TraceBench_f (void);
+// softquake -- tracebench console command
+
 void SV_UnlinkEdict (edict_t *ent);
 // call before removing an entity, and before trying to move one,
 // so it doesn't clip against itself
@@ -78,3 +83,19 @@ trace_t SV_Move (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, e
 // passedict is explicitly excluded from clipping checks (normally NULL)
 
 qboolean SV_RecursiveHullCheck (hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, trace_t *trace);
+
+// softquake
+extern	cvar_t	sv_tracecache;
+extern	cvar_t	sv_tracestats;
+
+qboolean SV_HullCheck (hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, trace_t *trace);
+// same as SV_RecursiveHullCheck, without the recursion
+
+void SV_HullCheckBatch (hull_t *hull, int count, vec3_t *starts, vec3_t *ends, trace_t *traces);
+// SV_HullCheck for up to 16 lines at once, walking the nodes they share only once
+
+void SV_MoveBatch (int count, vec3_t *starts, vec3_t mins, vec3_t maxs, vec3_t *ends, int type, edict_t *passedict, trace_t *traces);
+// SV_Move for up to 16 moves of the same size
+
+void SV_ClearTraceCache (void);
+void SV_TraceStats_f (void);
@@ -20,26 +20,50 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // Z_zone.c
 
 #include "quakedef.h"
+#include "memtrace.h"
 
 #define	DYNAMIC_SIZE	0xc000
 
 #define	ZONEID	0x1d4a11
 #define MINFRAGMENT	64
 
+// softquake -- free blocks are kept in lists by size. Below ZONE_SMALLSIZE
+// every multiple of 8 has its own list, above it every power of two is split
+// into 4 lists.
+#define	ZONE_SMALLSIZE		512
+#define	ZONE_SMALLCLASSES	(ZONE_SMALLSIZE/8)
+#define	ZONE_CLASSES		(ZONE_SMALLCLASSES + 22*4)
+#define	ZONE_MASKWORDS		((ZONE_CLASSES+31)/32)
+
 typedef struct memblock_s
 {
 	int		size;           // including the header and possibly tiny fragments
 	int     tag;            // a tag of 0 is a free block
 	int     id;        		// should be ZONEID
-	struct memblock_s       *next, *prev;
-	int		pad;			// pad to 64 bit boundary
+	int		prevsize;		// of the block right before this one, 0 for the first in a chunk
+	struct memblock_s       *next, *prev;	// in the free list of its size, only while it's free
 } memblock_t;
 
+typedef struct memchunk_s
+{
+	int		size;			// including this header and the end cap
+	qboolean	malloced;	// the first chunk is on the hunk, the rest are malloced
+	struct memchunk_s	*next;
+} memchunk_t;
+
+#define	ZONE_CHUNKHEADER	((sizeof(memchunk_t)+7)&~7)
+
 typedef struct
 {
-	int		size;		// total bytes malloced, including header
-	memblock_t	blocklist;		// start / end cap for linked list
-	memblock_t	*rover;
+	int		size;		// total bytes in all the chunks, including headers
+	int		growsize;	// the smallest chunk to add when it runs out
+	memchunk_t	*chunks;
+	memblock_t	*freelists[ZONE_CLASSES];
+	unsigned	freemask[ZONE_MASKWORDS];	// which freelists have something in them
+
+	int		numchunks;
+	int		used, peak;			// bytes in allocated blocks, including headers
+	int		numused;
 } memzone_t;
 
 void Cache_FreeLow (int new_low_hunk);
@@ -54,7 +78,11 @@ void Cache_FreeHigh (int new_high_hunk);
 There is never any space between memblocks, and there will never be two
 contiguous free memblocks.
 
-The rover can be left pointing at a non-empty block
+softquake -- Instead of a rover going around one big list, every free block
+is in the list for its size, so both Z_Malloc and Z_Free take the same time
+however many blocks there are. Each chunk ends with an in use block of no
+size, so merging never runs off the end. When nothing is big enough, another
+chunk is malloced instead of failing.
 
 The zone calls are pretty much only used for small strings and structures,
 all big things are allocated on the hunk.
@@ -68,26 +96,133 @@ void Z_ClearZone (memzone_t *zone, int size);
 
 /*
 ========================
-Z_ClearZone
+Z_SizeClass
+
+Which free list a block of this size goes in
 ========================
 */
-void Z_ClearZone (memzone_t *zone, int size)
+static int Z_SizeClass (int size)
 {
-	memblock_t	*block;
-	
-// set the entire zone to one free block
-
-	zone->blocklist.next = zone->blocklist.prev = block =
-		(memblock_t *)( (byte *)zone + sizeof(memzone_t) );
-	zone->blocklist.tag = 1;	// in use block
-	zone->blocklist.id = 0;
-	zone->blocklist.size = 0;
-	zone->rover = block;
-	
-	block->prev = block->next = &zone->blocklist;
+	int		bits;
+
+	if (size < ZONE_SMALLSIZE)
+		return size >> 3;
+
+	for (bits = 9 ; size >> (bits+1) ; bits++)
+		;
+	return ZONE_SMALLCLASSES + (bits-9)*4 + ((size >> (bits-2)) & 3);
+}
+
+/*
+========================
+Z_FitClass
+
+The first free list where every block is at least size bytes
+========================
+*/
+static int Z_FitClass (int size)
+{
+	int		class, bits;
+
+	class = Z_SizeClass (size);
+	if (size < ZONE_SMALLSIZE)
+		return class;
+
+	for (bits = 9 ; size >> (bits+1) ; bits++)
+		;
+	if (size & ((1 << (bits-2)) - 1))
+		class++;	// the smallest blocks in its own list are too small
+	return class;
+}
+
+/*
+========================
+Z_LinkFree
+========================
+*/
+static void Z_LinkFree (memzone_t *zone, memblock_t *block)
+{
+	int		class;
+
+	class = Z_SizeClass (block->size);
+	block->prev = NULL;
+	block->next = zone->freelists[class];
+	if (block->next)
+		block->next->prev = block;
+	zone->freelists[class] = block;
+	zone->freemask[class >> 5] |= 1u << (class & 31);
+}
+
+/*
+========================
+Z_UnlinkFree
+========================
+*/
+static void Z_UnlinkFree (memzone_t *zone, memblock_t *block)
+{
+	int		class;
+
+	class = Z_SizeClass (block->size);
+	if (block->prev)
+		block->prev->next = block->next;
+	else
+		zone->freelists[class] = block->next;
+	if (block->next)
+		block->next->prev = block->prev;
+	if (!zone->freelists[class])
+		zone->freemask[class >> 5] &= ~(1u << (class & 31));
+}
+
+/*
+========================
+Z_AddChunk
+
+Makes buf, size bytes long, into one big free block and returns it
+========================
+*/
+static memblock_t *Z_AddChunk (memzone_t *zone, void *buf, int size, qboolean malloced)
+{
+	memchunk_t	*chunk;
+	memblock_t	*block, *cap;
+
+	chunk = buf;
+	chunk->size = size;
+	chunk->malloced = malloced;
+	chunk->next = zone->chunks;
+	zone->chunks = chunk;
+	zone->size += size;
+	zone->numchunks++;
+
+	block = (memblock_t *)((byte *)chunk + ZONE_CHUNKHEADER);
+	block->size = (size - ZONE_CHUNKHEADER - sizeof(memblock_t)) & ~7;
 	block->tag = 0;			// free block
 	block->id = ZONEID;
-	block->size = size - sizeof(memzone_t);
+	block->prevsize = 0;
+
+	cap = (memblock_t *)((byte *)block + block->size);
+	cap->size = 0;
+	cap->tag = 1;			// in use block
+	cap->id = ZONEID;
+	cap->prevsize = block->size;
+
+	Z_LinkFree (zone, block);
+	return block;
+}
+
+#define	ZONE_HEADER		((sizeof(memzone_t)+7)&~7)
+
+/*
+========================
+Z_ClearZone
+========================
+*/
+void Z_ClearZone (memzone_t *zone, int size)
+{
+	memset (zone, 0, sizeof(*zone));
+
+// set the rest of it to one free block
+	Z_AddChunk (zone, (byte *)zone + ZONE_HEADER, size - ZONE_HEADER, false);
+	zone->growsize = size;
 }
 
 
@@ -99,7 +234,7 @@ Z_Free
 void Z_Free (void *ptr)
 {
 	memblock_t	*block, *other;
-	
+
 	if (!ptr)
 		Sys_Error ("Z_Free: NULL pointer");
 
@@ -110,27 +245,31 @@ void Z_Free (void *ptr)
 		Sys_Error ("Z_Free: freed a freed pointer");
 
 	block->tag = 0;		// mark as free
-	
-	other = block->prev;
-	if (!other->tag)
-	{	// merge with previous free block
-		other->size += block->size;
-		other->next = block->next;
-		other->next->prev = other;
-		if (block == mainzone->rover)
-			mainzone->rover = other;
-		block = other;
+	mainzone->used -= block->size;
+	mainzone->numused--;
+
+	if (block->prevsize)
+	{
+		other = (memblock_t *)((byte *)block - block->prevsize);
+		if (!other->tag)
+		{	// merge with previous free block
+			Z_UnlinkFree (mainzone, other);
+			other->size += block->size;
+			block = other;
+		}
 	}
-	
-	other = block->next;
+
+	other = (memblock_t *)((byte *)block + block->size);
 	if (!other->tag)
 	{	// merge the next free block onto the end
+		Z_UnlinkFree (mainzone, other);
 		block->size += other->size;
-		block->next = other->next;
-		block->next->prev = block;
-		if (other == mainzone->rover)
-			mainzone->rover = block;
 	}
+
+	other = (memblock_t *)((byte *)block + block->size);
+	other->prevsize = block->size;
+
+	Z_LinkFree (mainzone, block);
 }
 
 
@@ -142,8 +281,10 @@ Z_Malloc
 void *Z_Malloc (int size)
 {
 	void	*buf;
-	
-Z_CheckHeap ();	// DEBUG
+
+#ifdef PARANOID
+	Z_CheckHeap ();	// softquake -- walks every block, so only when asked for
+#endif
 	buf = Z_TagMalloc (size, 1);
 	if (!buf)
 		Sys_Error ("Z_Malloc: failed on allocation of %i bytes",size);
@@ -152,35 +293,71 @@ Z_CheckHeap ();	// DEBUG
 	return buf;
 }
 
+/*
+========================
+Z_FindFree
+
+Takes the first block out of the first free list with blocks big enough,
+or returns NULL
+========================
+*/
+static memblock_t *Z_FindFree (memzone_t *zone, int size)
+{
+	memblock_t	*block;
+	unsigned	mask;
+	int			word, class;
+
+	class = Z_FitClass (size);
+	if (class >= ZONE_CLASSES)
+		return NULL;
+
+	word = class >> 5;
+	mask = zone->freemask[word] & (~0u << (class & 31));
+	while (!mask)
+	{
+		if (++word == ZONE_MASKWORDS)
+			return NULL;
+		mask = zone->freemask[word];
+	}
+
+	for (class = word << 5 ; !(mask & 1) ; class++)
+		mask >>= 1;
+
+	block = zone->freelists[class];
+	Z_UnlinkFree (zone, block);
+	return block;
+}
+
 void *Z_TagMalloc (int size, int tag)
 {
-	int		extra;
-	memblock_t	*start, *rover, *new, *base;
+	int		extra, chunksize;
+	memblock_t	*base, *new, *next;
+	void	*buf;
 
 	if (!tag)
 		Sys_Error ("Z_TagMalloc: tried to use a 0 tag");
+	if (size < 0 || size > 0x40000000)
+		Sys_Error ("Z_TagMalloc: bad size: %i", size);
 
-//
-// scan through the block list looking for the first free block
-// of sufficient size
-//
 	size += sizeof(memblock_t);	// account for size of block header
 	size += 4;					// space for memory trash tester
 	size = (size + 7) & ~7;		// align to 8-byte boundary
-	
-	base = rover = mainzone->rover;
-	start = base->prev;
-	
-	do
-	{
-		if (rover == start)	// scaned all the way around the list
+
+	base = Z_FindFree (mainzone, size);
+	if (!base)
+	{	// softquake -- out of room, add another chunk
+		chunksize = ZONE_CHUNKHEADER + size + sizeof(memblock_t);
+		if (chunksize < mainzone->growsize)
+			chunksize = mainzone->growsize;
+		buf = malloc (chunksize);
+		if (!buf)
 			return NULL;
-		if (rover->tag)
-			base = rover = rover->next;
-		else
-			rover = rover->next;
-	} while (base->tag || base->size < size);
-	
+		Con_DPrintf ("Z_TagMalloc: added a %i byte chunk\n", chunksize);
+
+		base = Z_AddChunk (mainzone, buf, chunksize, true);
+		Z_UnlinkFree (mainzone, base);
+	}
+
 //
 // found a block big enough
 //
@@ -190,20 +367,23 @@ void *Z_TagMalloc (int size, int tag)
 		new = (memblock_t *) ((byte *)base + size );
 		new->size = extra;
 		new->tag = 0;			// free block
-		new->prev = base;
 		new->id = ZONEID;
-		new->next = base->next;
-		new->next->prev = new;
-		base->next = new;
+		new->prevsize = size;
 		base->size = size;
+
+		next = (memblock_t *)((byte *)new + extra);
+		next->prevsize = extra;
+		Z_LinkFree (mainzone, new);
 	}
-	
+
 	base->tag = tag;				// no longer a free block
-	
-	mainzone->rover = base->next;	// next allocation will start looking here
-	
 	base->id = ZONEID;
 
+	mainzone->used += base->size;
+	mainzone->numused++;
+	if (mainzone->used > mainzone->peak)
+		mainzone->peak = mainzone->used;
+
 // marker for memory trash testing
 	*(int *)((byte *)base + base->size - 4) = ZONEID;
 
@@ -214,30 +394,72 @@ void *Z_TagMalloc (int size, int tag)
 /*
 ========================
 Z_Print
+
+softquake -- How full and how broken up it is, every block with all
 ========================
 */
-void Z_Print (memzone_t *zone)
+void Z_Print (memzone_t *zone, qboolean all)
 {
+	memchunk_t	*chunk;
 	memblock_t	*block;
-	
-	Con_Printf ("zone size: %i  location: %p\n",mainzone->size,mainzone);
-	
-	for (block = zone->blocklist.next ; ; block = block->next)
+	int			i, count, freebytes, numfree, largest, chunklargest, unsplit;
+
+	Con_Printf ("zone size: %i in %i chunks  location: %p\n", zone->size, zone->numchunks, zone);
+
+	freebytes = numfree = largest = unsplit = 0;
+	for (chunk = zone->chunks ; chunk ; chunk = chunk->next)
 	{
-		Con_Printf ("block:%p    size:%7i    tag:%3i\n",
-			block, block->size, block->tag);
-		
-		if (block->next == &zone->blocklist)
-			break;			// all blocks have been hit	
-		if ( (byte *)block + block->size != (byte *)block->next)
-			Con_Printf ("ERROR: block size does not touch the next block\n");
-		if ( block->next->prev != block)
-			Con_Printf ("ERROR: next block doesn't have proper back link\n");
-		if (!block->tag && !block->next->tag)
-			Con_Printf ("ERROR: two consecutive free blocks\n");
+		if (all)
+			Con_Printf ("chunk:%p    size:%7i%s\n", chunk, chunk->size, chunk->malloced ? "    malloced" : "");
+		chunklargest = 0;
+
+		for (block = (memblock_t *)((byte *)chunk + ZONE_CHUNKHEADER) ; block->size ; block = (memblock_t *)((byte *)block + block->size))
+		{
+			if (all)
+				Con_Printf ("block:%p    size:%7i    tag:%3i\n", block, block->size, block->tag);
+			if (block->tag)
+				continue;
+			freebytes += block->size;
+			numfree++;
+			if (block->size > chunklargest)
+				chunklargest = block->size;
+		}
+		if (chunklargest > largest)
+			largest = chunklargest;
+		unsplit += chunklargest;
+	}
+
+	Con_Printf ("in use: %i bytes in %i blocks, peak %i\n", zone->used, zone->numused, zone->peak);
+	Con_Printf ("free: %i bytes in %i blocks, largest %i\n", freebytes, numfree, largest);
+	if (freebytes)	// how much of it isn't in the biggest free block of its chunk
+		Con_Printf ("fragmentation: %i%%\n", 100 - (int)((double)unsplit * 100 / freebytes));
+
+	for (i=0 ; i<ZONE_CLASSES ; i++)
+	{
+		count = 0;
+		for (block = zone->freelists[i] ; block ; block = block->next)
+			count++;
+		if (!count)
+			continue;
+		if (i < ZONE_SMALLCLASSES)
+			Con_Printf ("%9i bytes:%5i free\n", i*8, count);
+		else
+			Con_Printf ("%8i+ bytes:%5i free\n", (4 + (i-ZONE_SMALLCLASSES)%4) << ((i-ZONE_SMALLCLASSES)/4 + 7), count);
 	}
 }
 
+/*
+========================
+Z_Print_f
+
+zoneprint [all]
+========================
+*/
+static void Z_Print_f (void)
+{
+	Z_Print (mainzone, Cmd_Argc() > 1 && !Q_strcmp (Cmd_Argv(1), "all"));
+}
+
 
 /*
 ========================
@@ -246,18 +468,25 @@ Z_CheckHeap
 */
 void Z_CheckHeap (void)
 {
-	memblock_t	*block;
-	
-	for (block = mainzone->blocklist.next ; ; block = block->next)
+	memchunk_t	*chunk;
+	memblock_t	*block, *next;
+	int			class;
+
+	for (chunk = mainzone->chunks ; chunk ; chunk = chunk->next)
 	{
-		if (block->next == &mainzone->blocklist)
-			break;			// all blocks have been hit	
-		if ( (byte *)block + block->size != (byte *)block->next)
-			Sys_Error ("Z_CheckHeap: block size does not touch the next block\n");
-		if ( block->next->prev != block)
-			Sys_Error ("Z_CheckHeap: next block doesn't have proper back link\n");
-		if (!block->tag && !block->next->tag)
-			Sys_Error ("Z_CheckHeap: two consecutive free blocks\n");
+		for (block = (memblock_t *)((byte *)chunk + ZONE_CHUNKHEADER) ; block->size ; block = next)
+		{
+			next = (memblock_t *)((byte *)block + block->size);
+			if (block->id != ZONEID || block->size < 0 || (byte *)next > (byte *)chunk + chunk->size)
+				Sys_Error ("Z_CheckHeap: block size does not touch the next block\n");
+			if (next->prevsize != block->size)
+				Sys_Error ("Z_CheckHeap: next block doesn't have proper back link\n");
+			if (!block->tag && !next->tag)
+				Sys_Error ("Z_CheckHeap: two consecutive free blocks\n");
+			class = Z_SizeClass (block->size);
+			if (!block->tag && !(mainzone->freemask[class >> 5] & (1u << (class & 31))))
+				Sys_Error ("Z_CheckHeap: free block isn't in a free list\n");
+		}
 	}
 }
 
@@ -283,6 +512,83 @@ int		hunk_tempmark;
 
 void R_FreeTextures (void);
 
+/*
+==============================================================================
+
+						ALLOCATION TRACING
+
+softquake -- With -memtrace [file], every hunk and cache allocation, and every
+time memory is given back, is written to file (memtrace.log by default) with
+when it happened, who asked for it and how much of the hunk was in use after.
+memtool.c turns the log into peaks, totals by name and caller, and a timeline.
+==============================================================================
+*/
+
+static	FILE	*memtrace_file;
+static	double	memtrace_start;
+
+/*
+==============
+Memtrace_Init
+==============
+*/
+static void Memtrace_Init (void)
+{
+	memtraceheader_t	header;
+	char	*name;
+	int		p;
+
+	p = COM_CheckParm ("-memtrace");
+	if (!p)
+		return;
+
+	name = "memtrace.log";
+	if (p < com_argc-1 && com_argv[p+1][0] != '-' && com_argv[p+1][0] != '+')
+		name = com_argv[p+1];
+
+	memtrace_file = fopen (name, "wb");
+	if (!memtrace_file)
+		Sys_Error ("Memtrace_Init: couldn't open %s", name);
+
+	memset (&header, 0, sizeof(header));
+	header.ident = MEMTRACE_IDENT;
+	header.version = MEMTRACE_VERSION;
+	header.hunksize = hunk_size;
+	Q_strncpy (header.engine, SOFTQUAKE_VERSION, sizeof(header.engine)-1);
+	fwrite (&header, sizeof(header), 1, memtrace_file);
+
+	memtrace_start = Sys_PreciseTime ();
+	Con_Printf ("Tracing hunk and cache allocations to %s\n", name);
+}
+
+/*
+==============
+Memtrace_Record
+
+site is where the call came from, NULL if zone.c did it on its own
+==============
+*/
+static void Memtrace_Record (memtraceevent_t event, int size, char *name, void *site)
+{
+	memtrace_t	rec;
+
+	if (!memtrace_file)
+		return;
+
+	memset (&rec, 0, sizeof(rec));
+	rec.event = event;
+	rec.time = Sys_PreciseTime () - memtrace_start;
+	rec.size = size;
+	rec.site = site ? (int)((byte *)site - (byte *)Memory_Init) : 0;
+	rec.lowused = hunk_low_used;
+	rec.highused = hunk_high_used;
+	if (name)
+		Q_strncpy (rec.name, name, sizeof(rec.name)-1);
+	fwrite (&rec, sizeof(rec), 1, memtrace_file);
+}
+
+//============================================================================
+
 /*
 ==============
 Hunk_Check
@@ -393,10 +699,12 @@ void Hunk_Print (qboolean all)
 
 /*
 ===================
-Hunk_AllocName
+Hunk_AllocSite
+
+softquake -- Hunk_AllocName, with where it was called from for -memtrace
 ===================
 */
-void *Hunk_AllocName (int size, char *name)
+static void *Hunk_AllocSite (int size, char *name, void *site)
 {
 	hunk_t	*h;
 	
@@ -422,10 +730,22 @@ void *Hunk_AllocName (int size, char *name)
 	h->size = size;
 	h->sentinal = HUNK_SENTINAL;
 	Q_strncpy (h->name, name, 8);
+
+	Memtrace_Record (mt_hunkalloc, size, name, site);
 	
 	return (void *)(h+1);
 }
 
+/*
+===================
+Hunk_AllocName
+===================
+*/
+void *Hunk_AllocName (int size, char *name)
+{
+	return Hunk_AllocSite (size, name, RETURN_ADDRESS());
+}
+
 /*
 ===================
 Hunk_Alloc
@@ -433,7 +753,7 @@ Hunk_Alloc
 */
 void *Hunk_Alloc (int size)
 {
-	return Hunk_AllocName (size, "unknown");
+	return Hunk_AllocSite (size, "unknown", RETURN_ADDRESS());
 }
 
 int	Hunk_LowMark (void)
@@ -443,10 +763,15 @@ int	Hunk_LowMark (void)
 
 void Hunk_FreeToLowMark (int mark)
 {
+	int		size;
+
 	if (mark < 0 || mark > hunk_low_used)
 		Sys_Error ("Hunk_FreeToLowMark: bad mark %i", mark);
+	size = hunk_low_used - mark;
 	memset (hunk_base + mark, 0, hunk_low_used - mark);
 	hunk_low_used = mark;
+	if (size)
+		Memtrace_Record (mt_lowmark, size, NULL, RETURN_ADDRESS());	// softquake
 }
 
 int	Hunk_HighMark (void)
@@ -462,6 +787,8 @@ int	Hunk_HighMark (void)
 
 void Hunk_FreeToHighMark (int mark)
 {
+	int		size;
+
 	if (hunk_tempactive)
 	{
 		hunk_tempactive = false;
@@ -469,17 +796,22 @@ void Hunk_FreeToHighMark (int mark)
 	}
 	if (mark < 0 || mark > hunk_high_used)
 		Sys_Error ("Hunk_FreeToHighMark: bad mark %i", mark);
+	size = hunk_high_used - mark;
 	memset (hunk_base + hunk_size - hunk_high_used, 0, hunk_high_used - mark);
 	hunk_high_used = mark;
+	if (size)
+		Memtrace_Record (mt_highmark, size, NULL, RETURN_ADDRESS());	// softquake
 }
 
 
 /*
 ===================
-Hunk_HighAllocName
+Hunk_HighAllocSite
+
+softquake -- Hunk_HighAllocName, with where it was called from for -memtrace
 ===================
 */
-void *Hunk_HighAllocName (int size, char *name)
+static void *Hunk_HighAllocSite (int size, char *name, memtraceevent_t event, void *site)
 {
 	hunk_t	*h;
 
@@ -514,9 +846,21 @@ void *Hunk_HighAllocName (int size, char *name)
 	h->sentinal = HUNK_SENTINAL;
 	Q_strncpy (h->name, name, 8);
 
+	Memtrace_Record (event, size, name, site);
+
 	return (void *)(h+1);
 }
 
+/*
+===================
+Hunk_HighAllocName
+===================
+*/
+void *Hunk_HighAllocName (int size, char *name)
+{
+	return Hunk_HighAllocSite (size, name, mt_highalloc, RETURN_ADDRESS());
+}
+
 
 /*
 =================
@@ -539,7 +883,7 @@ void *Hunk_TempAlloc (int size)
 	
 	hunk_tempmark = Hunk_HighMark ();
 
-	buf = Hunk_HighAllocName (size, "temp");
+	buf = Hunk_HighAllocSite (size, "temp", mt_tempalloc, RETURN_ADDRESS());	// softquake
 
 	hunk_tempactive = true;
 
@@ -564,6 +908,8 @@ typedef struct cache_system_s
 } cache_system_t;
 
 cache_system_t *Cache_TryAlloc (int size, qboolean nobottom);
+static void Cache_Unlink (cache_user_t *c);
+static void Cache_FreeSite (cache_user_t *c, memtraceevent_t event, void *site);
 
 cache_system_t	cache_head;
 
@@ -585,14 +931,14 @@ void Cache_Move ( cache_system_t *c)
 		Q_memcpy ( new+1, c+1, c->size - sizeof(cache_system_t) );
 		new->user = c->user;
 		Q_memcpy (new->name, c->name, sizeof(new->name));
-		Cache_Free (c->user);
+		Cache_Unlink (c->user);	// softquake -- still there, so not traced
 		new->user->data = (void *)(new+1);
 	}
 	else
 	{
 //		Con_Printf ("cache_move failed\n");
 
-		Cache_Free (c->user);		// tough luck...
+		Cache_FreeSite (c->user, mt_cacheevict, NULL);		// tough luck...
 	}
 }
 
@@ -638,7 +984,7 @@ void Cache_FreeHigh (int new_high_hunk)
 		if ( (byte *)c + c->size <= hunk_base + hunk_size - new_high_hunk)
 			return;		// there is space to grow the hunk
 		if (c == prev)
-			Cache_Free (c->user);	// didn't move out of the way
+			Cache_FreeSite (c->user, mt_cacheevict, NULL);	// didn't move out of the way
 		else
 		{
 			Cache_Move (c);	// try to move it
@@ -759,7 +1105,7 @@ Throw everything out, so new data will be demand cached
 void Cache_Flush (void)
 {
 	while (cache_head.next != &cache_head)
-		Cache_Free ( cache_head.next->user );	// reclaim the space
+		Cache_FreeSite ( cache_head.next->user, mt_cachefree, NULL );	// reclaim the space
 }
 
 
@@ -816,12 +1162,12 @@ void Cache_Init (void)
 
 /*
 ==============
-Cache_Free
+Cache_Unlink
 
 Frees the memory and removes it from the LRU list
 ==============
 */
-void Cache_Free (cache_user_t *c)
+static void Cache_Unlink (cache_user_t *c)
 {
 	cache_system_t	*cs;
 
@@ -839,6 +1185,35 @@ void Cache_Free (cache_user_t *c)
 	Cache_UnlinkLRU (cs);
 }
 
+/*
+==============
+Cache_FreeSite
+
+softquake -- Cache_Unlink, saying why and who for -memtrace
+==============
+*/
+static void Cache_FreeSite (cache_user_t *c, memtraceevent_t event, void *site)
+{
+	cache_system_t	*cs;
+
+	if (!c->data)
+		Sys_Error ("Cache_Free: not allocated");
+
+	cs = ((cache_system_t *)c->data) - 1;
+	Memtrace_Record (event, cs->size, cs->name, site);
+	Cache_Unlink (c);
+}
+
+/*
+==============
+Cache_Free
+==============
+*/
+void Cache_Free (cache_user_t *c)
+{
+	Cache_FreeSite (c, mt_cachefree, RETURN_ADDRESS());
+}
+
 
 
 /*
@@ -871,6 +1246,7 @@ Cache_Alloc
 void *Cache_Alloc (cache_user_t *c, int size, char *name)
 {
 	cache_system_t	*cs;
+	void			*site;
 
 	if (c->data)
 		Sys_Error ("Cache_Alloc: allready allocated");
@@ -879,6 +1255,7 @@ void *Cache_Alloc (cache_user_t *c, int size, char *name)
 		Sys_Error ("Cache_Alloc: size %i", size);
 
 	size = (size + sizeof(cache_system_t) + 15) & ~15;
+	site = RETURN_ADDRESS();
 
 // find memory for it	
 	while (1)
@@ -889,6 +1266,7 @@ void *Cache_Alloc (cache_user_t *c, int size, char *name)
 			strncpy (cs->name, name, sizeof(cs->name)-1);
 			c->data = (void *)(cs+1);
 			cs->user = c;
+			Memtrace_Record (mt_cachealloc, size, name, site);	// softquake
 			break;
 		}
 	
@@ -896,7 +1274,7 @@ void *Cache_Alloc (cache_user_t *c, int size, char *name)
 		if (cache_head.lru_prev == &cache_head)
 			Sys_Error ("Cache_Alloc: out of memory");
 													// not enough memory at all
-		Cache_Free ( cache_head.lru_prev->user );
+		Cache_FreeSite ( cache_head.lru_prev->user, mt_cacheevict, site );	// softquake
 	} 
 	
 	return Cache_Check (c);
@@ -921,6 +1299,7 @@ void Memory_Init (void *buf, int size)
 	hunk_high_used = 0;
 	
 	Cache_Init ();
+	Memtrace_Init ();	// softquake
 	p = COM_CheckParm ("-zone");
 	if (p)
 	{
@@ -931,5 +1310,7 @@ void Memory_Init (void *buf, int size)
 	}
 	mainzone = Hunk_AllocName (zonesize, "zone" );
 	Z_ClearZone (mainzone, zonesize);
+
+	Cmd_AddCommand ("zoneprint", Z_Print_f);	// softquake
 }
 
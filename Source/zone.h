@@ -37,7 +37,8 @@ server allocations when changing to a higher video mode.
 
 Z_??? Zone memory functions used for small, dynamic allocations like text
 strings from command input.  There is only about 48K for it, allocated at
-the very bottom of the hunk.
+the very bottom of the hunk.  softquake -- when that fills up, more chunks
+are malloced for it.
 
 Cache_??? Cache memory is for objects that can be dynamically loaded and
 can usefully stay persistant between levels.  The size of the cache